@@ -0,0 +1,463 @@
+#ifndef ARITH_HPP
+#define ARITH_HPP
+
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "objects.hpp"
+#include "simd.hpp"
+
+namespace little_r {
+  // Arithmetic, comparison and logic on logical, integer and real vectors.
+  //
+  // Operands are recycled to the longer length and coerced to a common type first:
+  // integer arithmetic stays integer (overflow gives NA) except for / and ^,
+  // and anything with a real is real. Comparisons and logic give logical vectors.
+  //
+  // The elementwise rules are R's (arithmetic.c). NaNs are never tested for in real
+  // arithmetic: the hardware passes the payload of the first NaN operand through, as
+  // it does for R, so NA_real_ + NaN is NA and NaN + NA_real_ is NaN.
+  namespace arith {
+    enum class op {
+      add, sub, mul, div, pow, mod, idiv,
+      eq, ne, lt, le, gt, ge,
+      and_, or_,
+    };
+
+    inline bool is_numeric(objref x) {
+      return x->type() == ot::logical || x->type() == ot::integer || x->type() == ot::real;
+    }
+
+    // logical and integer share a representation so only real needs converting.
+    inline objref coerce(objref x, ot type) {
+      if (x->type() == type || (type != ot::real && x->type() != ot::real)) return x;
+      size_t n = x->length();
+      objref res = obj::make_vector(type, n);
+      if (type == ot::real) {
+        const int *src = x->data<int>();
+        double *dest = res->data<double>();
+        for (size_t i = 0; i != n; ++i) {
+          dest[i] = src[i] == na_integer ? na_real() : src[i];
+        }
+      } else {
+        const double *src = x->data<double>();
+        int *dest = res->data<int>();
+        for (size_t i = 0; i != n; ++i) {
+          double v = src[i];
+          dest[i] = v != v || v >= 2147483648.0 || v <= -2147483649.0 ? na_integer : (int)v;
+        }
+      }
+      return res;
+    }
+
+    inline int int_result(long long value) {
+      return value > INT_MAX || value <= INT_MIN ? na_integer : (int)value;
+    }
+
+    inline int int_op(op o, int a, int b) {
+      if (a == na_integer || b == na_integer) return na_integer;
+      switch (o) {
+        case op::add: return int_result((long long)a + b);
+        case op::sub: return int_result((long long)a - b);
+        case op::mul: return int_result((long long)a * b);
+        case op::mod: {
+          if (b == 0) return na_integer;
+          int r = a % b;
+          return r != 0 && (r < 0) != (b < 0) ? r + b : r;
+        }
+        case op::idiv: {
+          if (b == 0) return na_integer;
+          return (int)std::floor((double)a / b);
+        }
+        default: return na_integer;
+      }
+    }
+
+    // R_pow: integer powers and the infinities are defined even where C's pow is not.
+    inline double r_pow(double x, double y) {
+      if (x == 1 || y == 0) return 1;
+      if (x == 0) return y > 0 ? 0 : y < 0 ? std::numeric_limits<double>::infinity() : y;
+      if (std::isfinite(x) && std::isfinite(y)) return y == 2 ? x * x : std::pow(x, y);
+      if (x != x || y != y) return x + y;
+      if (!std::isfinite(x)) {
+        if (x > 0) return y < 0 ? 0 : std::numeric_limits<double>::infinity();
+        if (std::isfinite(y) && y == std::floor(y)) {
+          return y < 0 ? 0 : std::fmod(y, 2) != 0 ? x : -x;
+        }
+      }
+      if (!std::isfinite(y) && x >= 0) {
+        if (y > 0) return x >= 1 ? std::numeric_limits<double>::infinity() : 0;
+        return x < 1 ? std::numeric_limits<double>::infinity() : 0;
+      }
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // R's myfmod: the same sign as the divisor. a divisor too big for the quotient to
+    // be exact gives the dividend back, or its sum with the divisor if their signs differ.
+    inline double r_mod(double x1, double x2) {
+      if (x2 == 0) return std::numeric_limits<double>::quiet_NaN();
+      const double eps = std::numeric_limits<double>::epsilon();
+      if (std::fabs(x2) * eps > 1 && std::isfinite(x1) && std::fabs(x1) <= std::fabs(x2)) {
+        return std::fabs(x1) == std::fabs(x2) ? 0 : (x1 < 0 && x2 > 0) || (x2 < 0 && x1 > 0) ? x1 + x2 : x1;
+      }
+      double q = x1 / x2;
+      long double tmp = (long double)x1 - std::floor(q) * (long double)x2;
+      return (double)(tmp - std::floor(tmp / x2) * x2);
+    }
+
+    // R's myfloor: the quotient rounded down, with the remainder's rounding corrected.
+    inline double r_idiv(double x1, double x2) {
+      double q = x1 / x2;
+      if (x2 == 0 || std::fabs(q) * std::numeric_limits<double>::epsilon() > 1 || !std::isfinite(q)) return q;
+      if (std::fabs(q) < 1) return q < 0 || (x1 < 0 && x2 > 0) || (x1 > 0 && x2 < 0) ? -1 : 0;
+      long double tmp = (long double)x1 - std::floor(q) * (long double)x2;
+      return (double)(std::floor(q) + std::floor(tmp / x2));
+    }
+
+    inline double real_op(op o, double a, double b) {
+      switch (o) {
+        case op::add: return a + b;
+        case op::sub: return a - b;
+        case op::mul: return a * b;
+        case op::div: return a / b;
+        case op::pow: return r_pow(a, b);
+        case op::mod: return r_mod(a, b);
+        case op::idiv: return r_idiv(a, b);
+        default: return 0;
+      }
+    }
+
+    template <class T> int compare(op o, T a, T b) {
+      switch (o) {
+        case op::eq: return a == b;
+        case op::ne: return a != b;
+        case op::lt: return a < b;
+        case op::le: return a <= b;
+        case op::gt: return a > b;
+        case op::ge: return a >= b;
+        default: return 0;
+      }
+    }
+
+    inline int logical_at(objref x, size_t i) {
+      if (x->type() == ot::real) {
+        double v = x->data<double>()[i];
+        return v != v ? na_logical : v != 0;
+      }
+      int v = x->data<int>()[i];
+      return v == na_integer ? na_logical : v != 0;
+    }
+
+    // R's three valued logic: FALSE & NA is FALSE and TRUE | NA is TRUE.
+    inline int logic(op o, int a, int b) {
+      if (o == op::and_) {
+        if (a == 0 || b == 0) return 0;
+        return a == na_logical || b == na_logical ? na_logical : 1;
+      } else {
+        if ((a != 0 && a != na_logical) || (b != 0 && b != na_logical)) return 1;
+        return a == na_logical || b == na_logical ? na_logical : 0;
+      }
+    }
+
+    // Elementwise kernels.
+    //
+    // A kernel has scalar(a, b) and block(r, a, b), which does "width" elements at once
+    // with AVX2 or SSE2. Kernels with no vector form have a width of 1.
+    namespace kernels {
+      #if defined(LITTLE_R_AVX2)
+        const size_t real_width = 4;
+        const size_t int_width = 8;
+      #elif defined(LITTLE_R_SSE2)
+        const size_t real_width = 2;
+        const size_t int_width = 4;
+      #else
+        const size_t real_width = 1;
+        const size_t int_width = 1;
+      #endif
+
+      // r[i] = K::scalar(a[i % na], b[i % nb]). equal lengths and scalars on either side
+      // go a block at a time, a scalar being copied into a block of its own.
+      template <class K>
+      void run(typename K::result *r, size_t n, const typename K::arg *a, size_t na, const typename K::arg *b, size_t nb) {
+        typedef typename K::arg T;
+        if (n == 0) return;
+        size_t i = 0;
+        if (K::width > 1 && (na == n || na == 1) && (nb == n || nb == 1)) {
+          T block_a[K::width], block_b[K::width];
+          for (size_t j = 0; j != K::width; ++j) {
+            block_a[j] = a[0];
+            block_b[j] = b[0];
+          }
+          const T *pa = na == 1 ? block_a : a, *pb = nb == 1 ? block_b : b;
+          size_t step_a = na == 1 ? 0 : K::width, step_b = nb == 1 ? 0 : K::width;
+          for (; i + K::width <= n; i += K::width, pa += step_a, pb += step_b) {
+            K::block(r + i, pa, pb);
+          }
+        }
+        size_t ia = i % na, ib = i % nb;
+        for (; i != n; ++i) {
+          r[i] = K::scalar(a[ia], b[ib]);
+          if (++ia == na) ia = 0;
+          if (++ib == nb) ib = 0;
+        }
+      }
+
+      // + - * / have vector forms. ^ %% and %/% call libm.
+      template <op O> struct real_arith {
+        typedef double arg;
+        typedef double result;
+        static const size_t width = O <= op::div ? real_width : 1;
+
+        static double scalar(double a, double b) { return real_op(O, a, b); }
+
+        static void block(double *r, const double *a, const double *b) {
+          #if defined(LITTLE_R_AVX2)
+            __m256d x = _mm256_loadu_pd(a), y = _mm256_loadu_pd(b);
+            _mm256_storeu_pd(r,
+              O == op::add ? _mm256_add_pd(x, y) : O == op::sub ? _mm256_sub_pd(x, y) :
+              O == op::mul ? _mm256_mul_pd(x, y) : _mm256_div_pd(x, y)
+            );
+          #elif defined(LITTLE_R_SSE2)
+            __m128d x = _mm_loadu_pd(a), y = _mm_loadu_pd(b);
+            _mm_storeu_pd(r,
+              O == op::add ? _mm_add_pd(x, y) : O == op::sub ? _mm_sub_pd(x, y) :
+              O == op::mul ? _mm_mul_pd(x, y) : _mm_div_pd(x, y)
+            );
+          #else
+            r[0] = scalar(a[0], b[0]);
+          #endif
+        }
+      };
+
+      // NaN on either side gives NA. the vector form builds 0.0, 1.0 or -2^31 and
+      // converts to integers, which makes NA_LOGICAL of the last.
+      template <op O> struct real_compare {
+        typedef double arg;
+        typedef int result;
+        static const size_t width = real_width;
+
+        static int scalar(double a, double b) { return a != a || b != b ? na_logical : compare(O, a, b); }
+
+        static void block(int *r, const double *a, const double *b) {
+          #if defined(LITTLE_R_AVX2)
+            __m256d x = _mm256_loadu_pd(a), y = _mm256_loadu_pd(b);
+            __m256d c =
+              O == op::eq ? _mm256_cmp_pd(x, y, _CMP_EQ_OQ) : O == op::ne ? _mm256_cmp_pd(x, y, _CMP_NEQ_OQ) :
+              O == op::lt ? _mm256_cmp_pd(x, y, _CMP_LT_OQ) : O == op::le ? _mm256_cmp_pd(x, y, _CMP_LE_OQ) :
+              O == op::gt ? _mm256_cmp_pd(x, y, _CMP_GT_OQ) : _mm256_cmp_pd(x, y, _CMP_GE_OQ);
+            __m256d na = _mm256_cmp_pd(x, y, _CMP_UNORD_Q);
+            __m256d v = _mm256_blendv_pd(_mm256_and_pd(c, _mm256_set1_pd(1)), _mm256_set1_pd(-2147483648.0), na);
+            _mm_storeu_si128((__m128i*)r, _mm256_cvtpd_epi32(v));
+          #elif defined(LITTLE_R_SSE2)
+            __m128d x = _mm_loadu_pd(a), y = _mm_loadu_pd(b);
+            __m128d c =
+              O == op::eq ? _mm_cmpeq_pd(x, y) : O == op::ne ? _mm_cmpneq_pd(x, y) :
+              O == op::lt ? _mm_cmplt_pd(x, y) : O == op::le ? _mm_cmple_pd(x, y) :
+              O == op::gt ? _mm_cmpgt_pd(x, y) : _mm_cmpge_pd(x, y);
+            __m128d na = _mm_cmpunord_pd(x, y);
+            __m128d v = _mm_or_pd(_mm_andnot_pd(na, _mm_and_pd(c, _mm_set1_pd(1))), _mm_and_pd(na, _mm_set1_pd(-2147483648.0)));
+            _mm_storel_epi64((__m128i*)r, _mm_cvtpd_epi32(v));
+          #else
+            r[0] = scalar(a[0], b[0]);
+          #endif
+        }
+      };
+
+      // + and - have vector forms that turn NA operands and overflow into NA.
+      // a result of INT_MIN is an overflow too as it is NA_integer_.
+      template <op O> struct int_arith {
+        typedef int arg;
+        typedef int result;
+        static const size_t width = O == op::add || O == op::sub ? int_width : 1;
+
+        static int scalar(int a, int b) { return int_op(O, a, b); }
+
+        static void block(int *r, const int *a, const int *b) {
+          #if defined(LITTLE_R_AVX2)
+            __m256i x = _mm256_loadu_si256((const __m256i*)a), y = _mm256_loadu_si256((const __m256i*)b);
+            __m256i na = _mm256_set1_epi32(na_integer);
+            __m256i s = O == op::add ? _mm256_add_epi32(x, y) : _mm256_sub_epi32(x, y);
+            __m256i overflow = O == op::add ?
+              _mm256_and_si256(_mm256_xor_si256(x, s), _mm256_xor_si256(y, s)) :
+              _mm256_and_si256(_mm256_xor_si256(x, y), _mm256_xor_si256(x, s));
+            __m256i bad = _mm256_or_si256(
+              _mm256_or_si256(_mm256_cmpeq_epi32(x, na), _mm256_cmpeq_epi32(y, na)),
+              _mm256_or_si256(_mm256_srai_epi32(overflow, 31), _mm256_cmpeq_epi32(s, na))
+            );
+            _mm256_storeu_si256((__m256i*)r, _mm256_or_si256(_mm256_andnot_si256(bad, s), _mm256_and_si256(bad, na)));
+          #elif defined(LITTLE_R_SSE2)
+            __m128i x = _mm_loadu_si128((const __m128i*)a), y = _mm_loadu_si128((const __m128i*)b);
+            __m128i na = _mm_set1_epi32(na_integer);
+            __m128i s = O == op::add ? _mm_add_epi32(x, y) : _mm_sub_epi32(x, y);
+            __m128i overflow = O == op::add ?
+              _mm_and_si128(_mm_xor_si128(x, s), _mm_xor_si128(y, s)) :
+              _mm_and_si128(_mm_xor_si128(x, y), _mm_xor_si128(x, s));
+            __m128i bad = _mm_or_si128(
+              _mm_or_si128(_mm_cmpeq_epi32(x, na), _mm_cmpeq_epi32(y, na)),
+              _mm_or_si128(_mm_srai_epi32(overflow, 31), _mm_cmpeq_epi32(s, na))
+            );
+            _mm_storeu_si128((__m128i*)r, _mm_or_si128(_mm_andnot_si128(bad, s), _mm_and_si128(bad, na)));
+          #else
+            r[0] = scalar(a[0], b[0]);
+          #endif
+        }
+      };
+
+      template <op O> struct int_compare {
+        typedef int arg;
+        typedef int result;
+        static const size_t width = int_width;
+
+        static int scalar(int a, int b) { return a == na_integer || b == na_integer ? na_logical : compare(O, a, b); }
+
+        static void block(int *r, const int *a, const int *b) {
+          #if defined(LITTLE_R_AVX2)
+            __m256i x = _mm256_loadu_si256((const __m256i*)a), y = _mm256_loadu_si256((const __m256i*)b);
+            __m256i na = _mm256_set1_epi32(na_integer);
+            __m256i c =
+              O == op::eq || O == op::ne ? _mm256_cmpeq_epi32(x, y) :
+              O == op::gt || O == op::le ? _mm256_cmpgt_epi32(x, y) : _mm256_cmpgt_epi32(y, x);
+            // ne, le and ge are the complements of eq, gt and lt.
+            __m256i v = O == op::ne || O == op::le || O == op::ge ?
+              _mm256_andnot_si256(c, _mm256_set1_epi32(1)) : _mm256_and_si256(c, _mm256_set1_epi32(1));
+            __m256i bad = _mm256_or_si256(_mm256_cmpeq_epi32(x, na), _mm256_cmpeq_epi32(y, na));
+            _mm256_storeu_si256((__m256i*)r, _mm256_or_si256(_mm256_andnot_si256(bad, v), _mm256_and_si256(bad, na)));
+          #elif defined(LITTLE_R_SSE2)
+            __m128i x = _mm_loadu_si128((const __m128i*)a), y = _mm_loadu_si128((const __m128i*)b);
+            __m128i na = _mm_set1_epi32(na_integer);
+            __m128i c =
+              O == op::eq || O == op::ne ? _mm_cmpeq_epi32(x, y) :
+              O == op::gt || O == op::le ? _mm_cmpgt_epi32(x, y) : _mm_cmplt_epi32(x, y);
+            __m128i v = O == op::ne || O == op::le || O == op::ge ?
+              _mm_andnot_si128(c, _mm_set1_epi32(1)) : _mm_and_si128(c, _mm_set1_epi32(1));
+            __m128i bad = _mm_or_si128(_mm_cmpeq_epi32(x, na), _mm_cmpeq_epi32(y, na));
+            _mm_storeu_si128((__m128i*)r, _mm_or_si128(_mm_andnot_si128(bad, v), _mm_and_si128(bad, na)));
+          #else
+            r[0] = scalar(a[0], b[0]);
+          #endif
+        }
+      };
+
+      template <template <op> class K, class R, class T>
+      void arith(op o, R *r, size_t n, const T *a, size_t na, const T *b, size_t nb) {
+        switch (o) {
+          case op::add: return run<K<op::add> >(r, n, a, na, b, nb);
+          case op::sub: return run<K<op::sub> >(r, n, a, na, b, nb);
+          case op::mul: return run<K<op::mul> >(r, n, a, na, b, nb);
+          case op::div: return run<K<op::div> >(r, n, a, na, b, nb);
+          case op::pow: return run<K<op::pow> >(r, n, a, na, b, nb);
+          case op::mod: return run<K<op::mod> >(r, n, a, na, b, nb);
+          case op::idiv: return run<K<op::idiv> >(r, n, a, na, b, nb);
+          default: break;
+        }
+      }
+
+      template <template <op> class K, class T>
+      void compare(op o, int *r, size_t n, const T *a, size_t na, const T *b, size_t nb) {
+        switch (o) {
+          case op::eq: return run<K<op::eq> >(r, n, a, na, b, nb);
+          case op::ne: return run<K<op::ne> >(r, n, a, na, b, nb);
+          case op::lt: return run<K<op::lt> >(r, n, a, na, b, nb);
+          case op::le: return run<K<op::le> >(r, n, a, na, b, nb);
+          case op::gt: return run<K<op::gt> >(r, n, a, na, b, nb);
+          case op::ge: return run<K<op::ge> >(r, n, a, na, b, nb);
+          default: break;
+        }
+      }
+    }
+
+    inline objref binary(op o, objref x, objref y) {
+      if (!is_numeric(x) || !is_numeric(y)) {
+        throw std::runtime_error("non-numeric argument to binary operator");
+      }
+      size_t nx = x->length(), ny = y->length();
+      size_t n = nx == 0 || ny == 0 ? 0 : nx > ny ? nx : ny;
+      bool is_compare = o >= op::eq && o <= op::ge;
+      bool is_logic = o == op::and_ || o == op::or_;
+      bool real = !is_logic && (x->type() == ot::real || y->type() == ot::real || o == op::div || o == op::pow);
+
+      objref res;
+      if (is_logic) {
+        res = obj::make_vector(ot::logical, n);
+        int *r = res->data<int>();
+        for (size_t i = 0; i != n; ++i) {
+          r[i] = logic(o, logical_at(x, i % nx), logical_at(y, i % ny));
+        }
+      } else if (real) {
+        objref rx = coerce(x, ot::real), ry = coerce(y, ot::real);
+        const double *a = rx->data<double>(), *b = ry->data<double>();
+        if (is_compare) {
+          res = obj::make_vector(ot::logical, n);
+          kernels::compare<kernels::real_compare>(o, res->data<int>(), n, a, nx, b, ny);
+        } else {
+          res = obj::make_vector(ot::real, n);
+          kernels::arith<kernels::real_arith>(o, res->data<double>(), n, a, nx, b, ny);
+        }
+      } else {
+        const int *a = x->data<int>(), *b = y->data<int>();
+        if (is_compare) {
+          res = obj::make_vector(ot::logical, n);
+          kernels::compare<kernels::int_compare>(o, res->data<int>(), n, a, nx, b, ny);
+        } else {
+          res = obj::make_vector(ot::integer, n);
+          kernels::arith<kernels::int_arith>(o, res->data<int>(), n, a, nx, b, ny);
+        }
+      }
+      return res;
+    }
+
+    // length 1 operands without attributes skip the recycling loops and the copies made by coerce.
+    inline objref scalar_binary(op o, objref x, objref y) {
+      ot tx = x->type(), ty = y->type();
+      bool is_logic = o == op::and_ || o == op::or_;
+      if (
+        is_logic || !is_numeric(x) || !is_numeric(y) || x->length() != 1 || y->length() != 1 ||
+        x->attrib() != obj::null_const() || y->attrib() != obj::null_const()
+      ) {
+        return binary(o, x, y);
+      }
+      bool is_compare = o >= op::eq && o <= op::ge;
+      if (tx == ot::real || ty == ot::real || o == op::div || o == op::pow) {
+        int ix = tx == ot::real ? 0 : x->data<int>()[0], iy = ty == ot::real ? 0 : y->data<int>()[0];
+        double a = tx == ot::real ? x->data<double>()[0] : ix == na_integer ? na_real() : ix;
+        double b = ty == ot::real ? y->data<double>()[0] : iy == na_integer ? na_real() : iy;
+        if (is_compare) return obj::make_logical(a != a || b != b ? na_logical : compare(o, a, b));
+        return obj::make_real(real_op(o, a, b));
+      }
+      int a = x->data<int>()[0], b = y->data<int>()[0];
+      if (is_compare) return obj::make_logical(a == na_integer || b == na_integer ? na_logical : compare(o, a, b));
+      return obj::make_integer(int_op(o, a, b));
+    }
+
+    // unary minus. logical becomes integer.
+    inline objref negate(objref x) {
+      if (!is_numeric(x)) throw std::runtime_error("invalid argument to unary operator");
+      size_t n = x->length();
+      if (x->type() == ot::real) {
+        objref res = obj::make_vector(ot::real, n);
+        for (size_t i = 0; i != n; ++i) res->data<double>()[i] = -x->data<double>()[i];
+        return res;
+      }
+      objref res = obj::make_vector(ot::integer, n);
+      for (size_t i = 0; i != n; ++i) {
+        int v = x->data<int>()[i];
+        res->data<int>()[i] = v == na_integer ? na_integer : -v;
+      }
+      return res;
+    }
+
+    inline objref logical_not(objref x) {
+      if (!is_numeric(x)) throw std::runtime_error("invalid argument type");
+      size_t n = x->length();
+      objref res = obj::make_vector(ot::logical, n);
+      for (size_t i = 0; i != n; ++i) {
+        int v = logical_at(x, i);
+        res->data<int>()[i] = v == na_logical ? na_logical : !v;
+      }
+      return res;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,357 @@
+#ifndef AST_CACHE_HPP
+#define AST_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "objects.hpp"
+#include "parser.hpp"
+
+namespace little_r {
+  // Parsed programs saved as a flat binary image, so that a source file seen before
+  // does not need to be lexed and parsed again.
+  //
+  //   header | symbols | nodes | strings
+  //
+  // Symbols and nodes are 16 byte records. Longer vectors follow their record in whole records.
+  // References are offsets from the field that holds them to the record they refer to, so
+  // a mapped image is read in place with no pointers to fix up. Zero is NULL.
+  // The symbols come first, one per name, and are interned once per load.
+  // The header has a hash of the source: an image made from other text is not used.
+  namespace ast_cache {
+    const char magic[8] = { 'l', 'i', 't', 't', 'l', 'e', '_', 'r' };
+    const uint32_t version = 1;
+
+    struct header {
+      char magic[8];
+      uint32_t version;
+      uint32_t num_errors;
+      uint64_t source_hash;
+      uint64_t source_size;
+      uint32_t num_symbols;
+      uint32_t num_records;
+      uint32_t strings_size;
+      int32_t root;
+    };
+
+    // a symbol's a is its name and b its length.
+    // a list or call cell has the head in a, the tail in b and the tag in c.
+    // a vector has its length in a. up to 8 bytes of elements are in b and c, more follow the record.
+    // a string has its text in a and its length in b.
+    struct record {
+      uint32_t type;
+      int32_t a;
+      int32_t b;
+      int32_t c;
+    };
+
+    static_assert(sizeof(header) == 48 && sizeof(record) == 16, "the image layout is fixed");
+
+    const size_t inline_bytes = sizeof(record) - offsetof(record, b);
+
+    // 64 bits of a multiply and shift hash, eight bytes at a time.
+    inline uint64_t hash(const char *data, size_t size) {
+      const uint64_t k = 0xff51afd7ed558ccdull;
+      uint64_t h = 0x9e3779b97f4a7c15ull ^ size;
+      size_t i = 0;
+      for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        memcpy(&w, data + i, 8);
+        h = (h ^ w) * k;
+        h ^= h >> 32;
+      }
+      uint64_t w = 0;
+      if (i != size) memcpy(&w, data + i, size - i);
+      h = (h ^ w) * k;
+      h ^= h >> 33;
+      h *= 0xc4ceb9fe1a85ec53ull;
+      return h ^ h >> 33;
+    }
+
+    // builds an image from the top level expressions of a parse.
+    class writer {
+    public:
+      writer(objref exprs, const char *src, size_t size, size_t num_errors) {
+        memset(&header_, 0, sizeof(header_));
+        memcpy(header_.magic, magic, sizeof(magic));
+        header_.version = version;
+        header_.num_errors = (uint32_t)num_errors;
+        header_.source_hash = hash(src, size);
+        header_.source_size = size;
+        find_symbols(exprs);
+        header_.num_symbols = (uint32_t)records_.size();
+        size_t root = node(exprs);
+        header_.root = root ? (int32_t)(offset_of(root) - offsetof(header, root)) : 0;
+      }
+
+      std::string image() {
+        header_.num_records = (uint32_t)records_.size();
+        header_.strings_size = (uint32_t)strings_.size();
+        size_t strings_begin = offset_of(records_.size() + 1);
+        for (const fixup &f : fixups_) {
+          records_[f.record - 1].a = (int32_t)(strings_begin + f.pos - offset_of(f.record) - offsetof(record, a));
+        }
+        std::string res((const char*)&header_, sizeof(header_));
+        res.append((const char*)records_.data(), records_.size() * sizeof(record));
+        res.append(strings_);
+        return res;
+      }
+
+    private:
+      struct fixup {
+        size_t record;
+        size_t pos;
+      };
+
+      // records are numbered from 1 as 0 is NULL.
+      static size_t offset_of(size_t number) {
+        return sizeof(header) + (number - 1) * sizeof(record);
+      }
+
+      // the offset from a field of one record to another record.
+      static int32_t ref(size_t from, size_t field, size_t to) {
+        return to ? (int32_t)(offset_of(to) - offset_of(from) - field) : 0;
+      }
+
+      // the symbols go first, so the symbol table is the start of the records.
+      void find_symbols(objref e) {
+        std::vector<objref> stack(1, e);
+        while (!stack.empty()) {
+          objref x = stack.back();
+          stack.pop_back();
+          for (; x->type() == ot::list || x->type() == ot::lang; x = x->tail()) {
+            stack.push_back(x->head());
+            stack.push_back(x->tag());
+          }
+          if (x->type() == ot::symbol && symbols_.find(x) == symbols_.end()) {
+            symbols_[x] = records_.size() + 1;
+            records_.push_back(string_record(ot::symbol, x->chr_data()));
+          }
+        }
+      }
+
+      // the text goes in the strings at the end, which are placed once the records are done.
+      record string_record(ot type, const char *str) {
+        size_t len = strlen(str);
+        fixup f = { records_.size() + 1, strings_.size() };
+        fixups_.push_back(f);
+        strings_.append(str, len + 1);
+        record res = { (uint32_t)type, 0, (int32_t)len, 0 };
+        return res;
+      }
+
+      // the record number of a node, or 0 for NULL.
+      size_t node(objref x) {
+        switch (x->type()) {
+          case ot::nil: return 0;
+          case ot::symbol: return symbols_.at(x);
+          case ot::list: case ot::lang: {
+            size_t first = 0, prev = 0;
+            for (; x->type() == ot::list || x->type() == ot::lang; x = x->tail()) {
+              size_t r = add(x->type());
+              size_t head = node(x->head());
+              size_t tag = node(x->tag());
+              records_[r - 1].a = ref(r, offsetof(record, a), head);
+              records_[r - 1].c = ref(r, offsetof(record, c), tag);
+              if (prev) records_[prev - 1].b = ref(prev, offsetof(record, b), r);
+              if (!first) first = r;
+              prev = r;
+            }
+            records_[prev - 1].b = ref(prev, offsetof(record, b), node(x));
+            return first;
+          }
+          case ot::chr: {
+            size_t r = records_.size() + 1;
+            records_.push_back(string_record(ot::chr, x->chr_data()));
+            // c marks NA_character_, which is spelt "NA".
+            records_.back().c = x == obj::na_string();
+            return r;
+          }
+          case ot::logical: case ot::integer: case ot::real: case ot::complex: case ot::raw: {
+            size_t r = add(x->type());
+            size_t bytes = x->length() * obj::elem_size(x->type());
+            records_[r - 1].a = (int32_t)x->length();
+            const char *data =
+              x->type() == ot::real ? (const char*)x->data<double>() :
+              x->type() == ot::complex ? (const char*)x->data<rcomplex>() :
+              x->type() == ot::raw ? (const char*)x->data<rbyte>() :
+              (const char*)x->data<int>()
+            ;
+            if (bytes <= inline_bytes) {
+              memcpy(&records_[r - 1].b, data, bytes);
+            } else {
+              records_.resize(records_.size() + (bytes + sizeof(record) - 1) / sizeof(record));
+              memcpy(&records_[r], data, bytes);
+            }
+            return r;
+          }
+          default: {
+            throw std::runtime_error(std::string("can't save a ") + object_names[(int)x->type()] + " in an ast cache");
+          }
+        }
+      }
+
+      size_t add(ot type) {
+        record rec = { (uint32_t)type, 0, 0, 0 };
+        records_.push_back(rec);
+        return records_.size();
+      }
+
+      header header_;
+      std::vector<record> records_;
+      std::string strings_;
+      std::vector<fixup> fixups_;
+      std::unordered_map<objref, size_t> symbols_;
+    };
+
+    // reads an image in place. a mapped file or a string will do.
+    class reader {
+    public:
+      reader(const char *image, size_t size) : image_(image), size_(size) {
+        if (size < sizeof(header)) throw std::runtime_error("ast cache too short");
+        memcpy(&header_, image, sizeof(header_));
+        if (memcmp(header_.magic, magic, sizeof(magic)) != 0 || header_.version != version) {
+          throw std::runtime_error("not an ast cache");
+        }
+        end_ = sizeof(header) + (size_t)header_.num_records * sizeof(record);
+        if (header_.num_symbols > header_.num_records || end_ + header_.strings_size != size) {
+          throw std::runtime_error("ast cache is the wrong size");
+        }
+        symbols_.assign(header_.num_symbols, nullptr);
+      }
+
+      // true if the image was made from this text.
+      bool matches(const char *src, size_t size) const {
+        return header_.source_size == size && header_.source_hash == hash(src, size);
+      }
+
+      size_t num_errors() const { return header_.num_errors; }
+
+      // the top level expressions as a pairlist.
+      objref exprs() {
+        return load(target(offsetof(header, root), header_.root));
+      }
+
+    private:
+      // the byte offset of the record a field refers to, or 0 for NULL.
+      size_t target(size_t field, int32_t rel) const {
+        if (rel == 0) return 0;
+        size_t res = field + rel;
+        if (res < sizeof(header) || res >= end_ || (res - sizeof(header)) % sizeof(record) != 0) {
+          throw std::runtime_error("bad reference in ast cache");
+        }
+        return res;
+      }
+
+      record at(size_t pos) const {
+        record res;
+        memcpy(&res, image_ + pos, sizeof(res));
+        return res;
+      }
+
+      const char *string(size_t pos, const record &rec) const {
+        size_t begin = pos + offsetof(record, a) + rec.a;
+        if (begin < end_ || begin + (uint32_t)rec.b >= size_ || image_[begin + (uint32_t)rec.b] != 0) {
+          throw std::runtime_error("bad string in ast cache");
+        }
+        return image_ + begin;
+      }
+
+      objref load(size_t pos) {
+        if (pos == 0) return obj::null_const();
+        record rec = at(pos);
+        switch ((ot)rec.type) {
+          case ot::symbol: {
+            size_t i = (pos - sizeof(header)) / sizeof(record);
+            if (i >= symbols_.size()) throw std::runtime_error("bad symbol in ast cache");
+            if (!symbols_[i]) symbols_[i] = obj::make_symbol(string(pos, rec), (uint32_t)rec.b);
+            return symbols_[i];
+          }
+          case ot::list: case ot::lang: {
+            objref first = nullptr, prev = nullptr;
+            for (;;) {
+              objref cell = new obj((ot)rec.type, load(target(pos + offsetof(record, a), rec.a)));
+              cell->set_tag(load(target(pos + offsetof(record, c), rec.c)));
+              if (prev) prev->set_tail(cell); else first = cell;
+              prev = cell;
+              pos = target(pos + offsetof(record, b), rec.b);
+              if (pos == 0) break;
+              rec = at(pos);
+              if ((ot)rec.type != ot::list && (ot)rec.type != ot::lang) {
+                prev->set_tail(load(pos));
+                break;
+              }
+            }
+            return first;
+          }
+          case ot::chr: {
+            if (rec.c) return obj::na_string();
+            return obj::make_string(std::string(string(pos, rec), (uint32_t)rec.b));
+          }
+          case ot::logical: case ot::integer: case ot::real: case ot::complex: case ot::raw: {
+            ot type = (ot)rec.type;
+            size_t length = (uint32_t)rec.a;
+            size_t bytes = length * obj::elem_size(type);
+            size_t begin = bytes <= inline_bytes ? pos + offsetof(record, b) : pos + sizeof(record);
+            if (bytes > end_ - begin) throw std::runtime_error("bad vector in ast cache");
+            objref res = obj::make_vector(type, length);
+            char *data =
+              type == ot::real ? (char*)res->data<double>() :
+              type == ot::complex ? (char*)res->data<rcomplex>() :
+              type == ot::raw ? (char*)res->data<rbyte>() :
+              (char*)res->data<int>()
+            ;
+            if (bytes) memcpy(data, image_ + begin, bytes);
+            return res;
+          }
+          default: {
+            throw std::runtime_error("bad node in ast cache");
+          }
+        }
+      }
+
+      const char *image_;
+      size_t size_;
+      size_t end_;
+      header header_;
+      std::vector<objref> symbols_;
+    };
+
+    // the image of a parse of src.
+    inline std::string save(const parser &p, const char *src, size_t size) {
+      return writer(p.exprs(), src, size, p.num_errors()).image();
+    }
+
+    // the top level expressions of a source file, loaded from cache_path if that was made
+    // from the same text. otherwise the file is parsed and the cache written.
+    // nothing holds on to the result, so protect it before the next safepoint.
+    inline objref parse_file(const std::string &path, const std::string &cache_path, size_t *num_errors = nullptr, bool *cached = nullptr) {
+      mapped_file src(path);
+      try {
+        mapped_file image(cache_path);
+        reader r(image.data(), image.size());
+        if (r.matches(src.data(), src.size())) {
+          if (num_errors) *num_errors = r.num_errors();
+          if (cached) *cached = true;
+          return r.exprs();
+        }
+      } catch (std::runtime_error &) {
+      }
+      parser p(src);
+      std::string image = save(p, src.data(), src.size());
+      std::ofstream(cache_path, std::ios::binary).write(image.data(), image.size());
+      if (num_errors) *num_errors = p.num_errors();
+      if (cached) *cached = false;
+      return p.exprs();
+    }
+  }
+}
+
+#endif
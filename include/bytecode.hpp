@@ -0,0 +1,547 @@
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "env.hpp"
+#include "fuse.hpp"
+#include "objects.hpp"
+
+// GCC and clang dispatch with computed gotos, everything else with a switch.
+#if !defined(LITTLE_R_NO_THREADED_CODE) && defined(__GNUC__)
+  #define LITTLE_R_THREADED_CODE 1
+#else
+  #define LITTLE_R_THREADED_CODE 0
+#endif
+
+namespace little_r {
+  // Bytecode for a stack machine, much like R's own.
+  //
+  // A bytecode object is a list cell of an integer vector of instructions, a generic
+  // vector of constants and a raw vector of lookup caches. The first integer is the
+  // deepest the stack gets, then each opcode is followed by its operands: constant
+  // indices, cache indices or jump targets. Constant 0 is the expression compiled.
+  namespace bc {
+    // name, number of operands, stack effect.
+    #define LITTLE_R_BC_OPS(X) \
+      X(ldconst, 1, 1) \
+      X(ldnull, 0, 1) \
+      X(getvar, 2, 1) \
+      X(setvar, 1, 0) \
+      X(setvar2, 1, 0) \
+      X(pop, 0, -1) \
+      X(popn, 1, 0) \
+      X(add, 0, -1) \
+      X(sub, 0, -1) \
+      X(mul, 0, -1) \
+      X(div, 0, -1) \
+      X(pow, 0, -1) \
+      X(mod, 0, -1) \
+      X(idiv, 0, -1) \
+      X(eq, 0, -1) \
+      X(ne, 0, -1) \
+      X(lt, 0, -1) \
+      X(le, 0, -1) \
+      X(gt, 0, -1) \
+      X(ge, 0, -1) \
+      X(and_, 0, -1) \
+      X(or_, 0, -1) \
+      X(uminus, 0, 0) \
+      X(uplus, 0, 0) \
+      X(not_, 0, 0) \
+      X(fused, 2, 1) \
+      X(goto_, 1, 0) \
+      X(brifnot, 1, -1) \
+      X(and1st, 1, 0) \
+      X(and2nd, 0, 0) \
+      X(or1st, 1, 0) \
+      X(or2nd, 0, 0) \
+      X(startfor, 2, 1) \
+      X(stepfor, 2, 0) \
+      X(endfor, 0, -1) \
+      X(loopback, 1, 0) \
+      X(getfun, 3, 3) \
+      X(getarg, 2, 1) \
+      X(makeprom, 2, 0) \
+      X(pusharg, 1, -1) \
+      X(dodots, 0, 0) \
+      X(call, 1, -2) \
+      X(makeclosure, 1, 1) \
+      X(eval, 1, 1) \
+      X(return_, 0, -1)
+
+    enum class op : int {
+      #define LITTLE_R_BC_ENUM(name, operands, effect) name,
+      LITTLE_R_BC_OPS(LITTLE_R_BC_ENUM)
+      #undef LITTLE_R_BC_ENUM
+      num_ops
+    };
+
+    inline const char *op_name(op o) {
+      static const char *names[] = {
+        #define LITTLE_R_BC_NAME(name, operands, effect) #name,
+        LITTLE_R_BC_OPS(LITTLE_R_BC_NAME)
+        #undef LITTLE_R_BC_NAME
+      };
+      return names[(int)o];
+    }
+
+    inline int num_operands(op o) {
+      static const int operands[] = {
+        #define LITTLE_R_BC_OPERANDS(name, operands, effect) operands,
+        LITTLE_R_BC_OPS(LITTLE_R_BC_OPERANDS)
+        #undef LITTLE_R_BC_OPERANDS
+      };
+      return operands[(int)o];
+    }
+
+    inline int stack_effect(op o) {
+      static const int effects[] = {
+        #define LITTLE_R_BC_EFFECT(name, operands, effect) effect,
+        LITTLE_R_BC_OPS(LITTLE_R_BC_EFFECT)
+        #undef LITTLE_R_BC_EFFECT
+      };
+      return effects[(int)o];
+    }
+
+    // one instruction per line: offset, name and operands.
+    inline std::ostream &disassemble(std::ostream &os, objref code) {
+      const int *pc = code->bc_code()->data<int>();
+      const int *end = pc + code->bc_code()->length();
+      os << "stack " << *pc++ << "\n";
+      while (pc != end) {
+        op o = (op)*pc;
+        os << (pc - code->bc_code()->data<int>()) << " " << op_name(o);
+        ++pc;
+        for (int i = 0; i != num_operands(o); ++i) os << " " << *pc++;
+        os << "\n";
+      }
+      return os;
+    }
+
+    // Compiles an expression seen from "rho".
+    //
+    // Control flow, assignment to symbols, and arithmetic, comparison and logic are
+    // compiled inline when their names are still bound to the base functions in "base"
+    // at compile time and the code itself doesn't bind them; like R's compiler, later
+    // redefinitions from elsewhere are not seen. Calls of
+    // other functions cache their lookups and build their argument lists on the stack,
+    // and anything else is handed back to the tree-walking evaluator.
+    class compiler {
+    public:
+      compiler(objref rho, objref base) : rho_(rho), base_(base), num_caches_(0), depth_(0), max_depth_(0) {
+        missing_arg_ = obj::make_symbol("", 0);
+        dots_ = obj::make_symbol("...");
+      }
+
+      // a closure body with its formals, or a top level expression if "function_body" is
+      // false. either way the code ends by returning the value of "e".
+      objref compile(objref e, bool function_body, objref formals = obj::null_const()) {
+        function_body_ = function_body;
+        for (; formals != obj::null_const(); formals = formals->tail()) add_local(formals->tag());
+        find_locals(e);
+        code_.push_back(0);
+        constant(e);
+        expr(e);
+        emit(op::return_);
+        code_[0] = max_depth_;
+
+        objref code = obj::make_vector(ot::integer, code_.size());
+        std::copy(code_.begin(), code_.end(), code->data<int>());
+        objref consts = obj::make_vector(ot::vec, consts_.size());
+        for (size_t i = 0; i != consts_.size(); ++i) consts->data<objref>()[i] = consts_[i];
+        objref caches = obj::make_vector(ot::raw, num_caches_ * sizeof(lookup_cache));
+        std::fill(caches->data<rbyte>(), caches->data<rbyte>() + caches->length(), 0);
+        objref res = new obj(ot::bytecode, code, consts);
+        res->set_tag(caches);
+        return res;
+      }
+
+    private:
+      // an expression that leaves one value on the stack.
+      void expr(objref e) {
+        switch (e->type()) {
+          case ot::symbol: {
+            if (e == dots_ || e == missing_arg_) return fallback(e);
+            emit(op::getvar, constant(e), cache());
+            return;
+          }
+          case ot::lang: return call(e);
+          case ot::nil: emit(op::ldnull); return;
+          default: emit(op::ldconst, constant(e)); return;
+        }
+      }
+
+      void call(objref e) {
+        objref fn = e->head();
+        objref args = e->tail();
+        if (fn->type() != ot::symbol) return fallback(e);
+        if (!is_base(fn) || has_tags(args)) return generic_call(e);
+        std::string name = fn->chr_data();
+        size_t n = length(args);
+
+        if (name == "{") {
+          if (n == 0) return emit(op::ldnull);
+          for (objref a = args; a != obj::null_const(); a = a->tail()) {
+            expr(a->head());
+            if (a->tail() != obj::null_const()) emit(op::pop);
+          }
+          return;
+        }
+        if (name == "(" && n == 1) return expr(args->head());
+        if (name == "quote" && n == 1) return emit(op::ldconst, constant(args->head()));
+        if (name == "if" && (n == 2 || n == 3)) return compile_if(args);
+        if (name == "for" && n == 3) return compile_loop(e, &compiler::compile_for);
+        if (name == "while" && n == 2) return compile_loop(e, &compiler::compile_while);
+        if (name == "repeat" && n == 1) return compile_loop(e, &compiler::compile_repeat);
+        if ((name == "break" || name == "next") && n == 0 && !loops_.empty()) return jump_out(name == "break");
+        if (name == "function") return emit(op::makeclosure, constant(e));
+        if (name == "return" && n <= 1 && function_body_) {
+          if (n == 0) emit(op::ldnull); else expr(args->head());
+          emit(op::return_);
+          // unreachable, but the stack depth after a call is one more than before.
+          return emit(op::ldnull);
+        }
+        if ((name == "<-" || name == "=" || name == "<<-") && n == 2) {
+          objref lhs = args->head();
+          if (lhs->type() == ot::chr) lhs = obj::make_symbol(lhs->chr_data());
+          if (lhs->type() != ot::symbol) return fallback(e);
+          expr(args->tail()->head());
+          return emit(name == "<<-" ? op::setvar2 : op::setvar, constant(lhs));
+        }
+        if ((name == "&&" || name == "||") && n == 2) {
+          bool and_ = name == "&&";
+          expr(args->head());
+          size_t skip = emit_jump(and_ ? op::and1st : op::or1st);
+          emit(op::pop);
+          expr(args->tail()->head());
+          emit(and_ ? op::and2nd : op::or2nd);
+          return patch(skip);
+        }
+        if (n <= 2 && !is_dots(args) && compile_fused(e)) return;
+        if (n == 1 && !is_dots(args)) {
+          op o = name == "-" ? op::uminus : name == "+" ? op::uplus : name == "!" ? op::not_ : op::num_ops;
+          if (o != op::num_ops) {
+            expr(args->head());
+            return emit(o);
+          }
+        }
+        if (n == 2 && !is_dots(args)) {
+          op o = binary_op(name);
+          if (o != op::num_ops) {
+            expr(args->head());
+            expr(args->tail()->head());
+            return emit(o);
+          }
+        }
+        generic_call(e);
+      }
+
+      static op binary_op(const std::string &name) {
+        static const char *names[] = { "+", "-", "*", "/", "^", "%%", "%/%", "==", "!=", "<", "<=", ">", ">=", "&", "|" };
+        static const op ops[] = { op::add, op::sub, op::mul, op::div, op::pow, op::mod, op::idiv, op::eq, op::ne, op::lt, op::le, op::gt, op::ge, op::and_, op::or_ };
+        for (size_t i = 0; i != sizeof(ops) / sizeof(ops[0]); ++i) {
+          if (name == names[i]) return ops[i];
+        }
+        return op::num_ops;
+      }
+
+      // a tree of two or more element-wise operators: its leaves, then one fused op.
+      bool compile_fused(objref e) {
+        fuse::program p;
+        auto check = [this](objref call) { return is_base(call->head()); };
+        if (fuse::analyse(e, check, p) < 2) return false;
+        for (size_t i = 0; i != p.leaves.size(); ++i) expr(p.leaves[i]);
+        objref code = obj::make_vector(ot::integer, p.code.size());
+        std::copy(p.code.begin(), p.code.end(), code->data<int>());
+        emit(op::fused, constant(code), (int)p.leaves.size());
+        return true;
+      }
+
+      // getfun either runs a special on the unevaluated call and jumps to "done",
+      // or pushes the function and an empty argument list for pusharg to append to.
+      //
+      // a closure gets promises for its arguments. getarg pushes the value of a bound
+      // symbol, or a promise if it has none yet, and makeprom pushes a promise for a
+      // call and jumps over the code that evaluates it inline for a builtin.
+      void generic_call(objref e) {
+        int k = constant(e);
+        emit(op::getfun, k, cache(), 0);
+        size_t done = code_.size() - 1;
+        for (objref a = e->tail(); a != obj::null_const(); a = a->tail()) {
+          objref value = a->head();
+          if (value == dots_) {
+            emit(op::dodots);
+            continue;
+          }
+          if (value == missing_arg_) {
+            emit(op::ldconst, constant(value));
+          } else if (value->type() == ot::symbol) {
+            emit(op::getarg, constant(value), cache());
+          } else if (value->type() == ot::lang) {
+            if (!loops_.empty() && contains_escape(value)) throw fallback_loop();
+            emit(op::makeprom, constant(value), 0);
+            size_t inline_done = code_.size() - 1;
+            expr(value);
+            patch(inline_done);
+          } else {
+            expr(value);
+          }
+          emit(op::pusharg, a->tag() == obj::null_const() ? -1 : constant(a->tag()));
+        }
+        emit(op::call, k);
+        code_[done] = (int)code_.size();
+      }
+
+      void compile_if(objref args) {
+        expr(args->head());
+        size_t otherwise = emit_jump(op::brifnot);
+        expr(args->tail()->head());
+        size_t done = emit_jump(op::goto_);
+        --depth_;
+        patch(otherwise);
+        objref rest = args->tail()->tail();
+        if (rest != obj::null_const()) expr(rest->head()); else emit(op::ldnull);
+        patch(done);
+      }
+
+      // a loop, or all of it handed to the evaluator if a break or next in it can't be compiled.
+      void compile_loop(objref e, void (compiler::*fn)(objref)) {
+        size_t size = code_.size(), loops = loops_.size();
+        int depth = depth_;
+        try {
+          (this->*fn)(e);
+        } catch (fallback_loop &) {
+          code_.resize(size);
+          loops_.erase(loops_.begin() + loops, loops_.end());
+          depth_ = depth;
+          fallback(e);
+        }
+      }
+
+      // seq; startfor var step; body: body; pop; step: stepfor var body; end: endfor
+      void compile_for(objref e) {
+        objref args = e->tail();
+        if (args->head()->type() != ot::symbol) return fallback(e);
+        expr(args->tail()->head());
+        int var = constant(args->head());
+        emit(op::startfor, var, 0);
+        size_t start = code_.size() - 1;
+        loops_.push_back(loop_info(depth_));
+        size_t body = code_.size();
+        expr(args->tail()->tail()->head());
+        emit(op::pop);
+        patch(start);
+        patch_all(loops_.back().nexts);
+        emit(op::stepfor, var, (int)body);
+        patch_all(loops_.back().breaks);
+        loops_.pop_back();
+        emit(op::endfor);
+      }
+
+      // top: cond; brifnot end; body; pop; next: loopback top; end: ldnull
+      void compile_while(objref e) {
+        objref args = e->tail();
+        size_t top = code_.size();
+        expr(args->head());
+        size_t end = emit_jump(op::brifnot);
+        loops_.push_back(loop_info(depth_));
+        expr(args->tail()->head());
+        emit(op::pop);
+        patch_all(loops_.back().nexts);
+        emit(op::loopback, (int)top);
+        patch(end);
+        patch_all(loops_.back().breaks);
+        loops_.pop_back();
+        emit(op::ldnull);
+      }
+
+      // top: body; pop; next: loopback top; end: ldnull
+      void compile_repeat(objref e) {
+        size_t top = code_.size();
+        loops_.push_back(loop_info(depth_));
+        expr(e->tail()->head());
+        emit(op::pop);
+        patch_all(loops_.back().nexts);
+        emit(op::loopback, (int)top);
+        patch_all(loops_.back().breaks);
+        loops_.pop_back();
+        emit(op::ldnull);
+      }
+
+      // drop what the loop body has pushed and jump to the end or the next iteration.
+      void jump_out(bool is_break) {
+        loop_info &loop = loops_.back();
+        int depth = depth_;
+        if (depth_ != loop.depth) emit(op::popn, depth_ - loop.depth);
+        emit(op::goto_, 0);
+        (is_break ? loop.breaks : loop.nexts).push_back(code_.size() - 1);
+        // as "return", the value is never used.
+        depth_ = depth;
+        emit(op::ldnull);
+      }
+
+      // the tree-walking evaluator does the rest. break and next must not escape
+      // from it into a compiled loop, so a loop containing those falls back as a whole.
+      void fallback(objref e) {
+        if (!loops_.empty() && contains_escape(e)) throw fallback_loop();
+        emit(op::eval, constant(e));
+      }
+
+      struct fallback_loop {};
+
+      // break or next outside a nested function or loop body.
+      static bool contains_escape(objref e) {
+        if (e->type() != ot::lang) return false;
+        objref fn = e->head();
+        if (fn->type() == ot::symbol) {
+          std::string name = fn->chr_data();
+          if (name == "break" || name == "next") return true;
+          if (name == "function" || name == "quote" || name == "repeat") return false;
+          if (name == "for" && e->tail() != obj::null_const()) return contains_escape(e->tail()->tail()->head());
+          if (name == "while") return contains_escape(e->tail()->head());
+        }
+        for (; e != obj::null_const(); e = e->tail()) {
+          if (contains_escape(e->head())) return true;
+        }
+        return false;
+      }
+
+      bool is_base(objref sym) const {
+        if (std::find(locals_.begin(), locals_.end(), sym) != locals_.end()) return false;
+        size_t depth;
+        objref where = nullptr;
+        return env::find(rho_, sym, true, depth, where) && where == base_;
+      }
+
+      // names the code may bind, even if only on some paths, such as `+` <- function(a, b) 0.
+      // like R's findLocals, but <<- counts too as it can rebind the name where it is found.
+      // nested functions and quoted code are not looked into.
+      void find_locals(objref e) {
+        if (e->type() != ot::lang) return;
+        objref fn = e->head();
+        objref args = e->tail();
+        if (fn->type() == ot::symbol) {
+          std::string name = fn->chr_data();
+          if (name == "function" || name == "quote") return;
+          if ((name == "<-" || name == "=" || name == "<<-") && args != obj::null_const()) {
+            // the variable of a replacement like names(x) <- v is innermost.
+            objref lhs = args->head();
+            while (lhs->type() == ot::lang && lhs->tail() != obj::null_const()) lhs = lhs->tail()->head();
+            if (lhs->type() == ot::chr) lhs = obj::make_symbol(lhs->chr_data());
+            if (lhs->type() == ot::symbol) add_local(lhs);
+          }
+          if (name == "for" && args != obj::null_const() && args->head()->type() == ot::symbol) add_local(args->head());
+        }
+        for (; e != obj::null_const(); e = e->tail()) find_locals(e->head());
+      }
+
+      void add_local(objref sym) {
+        if (std::find(locals_.begin(), locals_.end(), sym) == locals_.end()) locals_.push_back(sym);
+      }
+
+      bool is_dots(objref args) const {
+        for (; args != obj::null_const(); args = args->tail()) {
+          if (args->head() == dots_) return true;
+        }
+        return false;
+      }
+
+      static bool has_tags(objref args) {
+        for (; args != obj::null_const(); args = args->tail()) {
+          if (args->tag() != obj::null_const()) return true;
+        }
+        return false;
+      }
+
+      static size_t length(objref args) {
+        size_t n = 0;
+        for (; args != obj::null_const(); args = args->tail()) ++n;
+        return n;
+      }
+
+      int constant(objref value) {
+        for (size_t i = 0; i != consts_.size(); ++i) {
+          if (consts_[i] == value) return (int)i;
+        }
+        consts_.push_back(value);
+        return (int)consts_.size() - 1;
+      }
+
+      int cache() {
+        return (int)num_caches_++;
+      }
+
+      void emit(op o) {
+        code_.push_back((int)o);
+        adjust(o);
+      }
+
+      void emit(op o, int a) {
+        code_.push_back((int)o);
+        code_.push_back(a);
+        adjust(o);
+      }
+
+      void emit(op o, int a, int b) {
+        code_.push_back((int)o);
+        code_.push_back(a);
+        code_.push_back(b);
+        adjust(o);
+      }
+
+      void emit(op o, int a, int b, int c) {
+        code_.push_back((int)o);
+        code_.push_back(a);
+        code_.push_back(b);
+        code_.push_back(c);
+        adjust(o);
+      }
+
+      void adjust(op o) {
+        depth_ += stack_effect(o);
+        if (o == op::popn || o == op::fused) depth_ -= code_.back();
+        if (depth_ > max_depth_) max_depth_ = depth_;
+      }
+
+      // a jump whose target is patched later. returns the index of the operand.
+      size_t emit_jump(op o) {
+        emit(o, 0);
+        return code_.size() - 1;
+      }
+
+      void patch(size_t operand) {
+        code_[operand] = (int)code_.size();
+      }
+
+      void patch_all(const std::vector<size_t> &operands) {
+        for (size_t i = 0; i != operands.size(); ++i) patch(operands[i]);
+      }
+
+      struct loop_info {
+        loop_info(int depth) : depth(depth) {}
+        int depth;
+        std::vector<size_t> breaks;
+        std::vector<size_t> nexts;
+      };
+
+      objref rho_;
+      objref base_;
+      objref missing_arg_;
+      objref dots_;
+      bool function_body_;
+      std::vector<int> code_;
+      std::vector<objref> consts_;
+      std::vector<objref> locals_;
+      std::vector<loop_info> loops_;
+      size_t num_caches_;
+      int depth_;
+      int max_depth_;
+    };
+  }
+}
+
+#endif
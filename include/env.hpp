@@ -0,0 +1,247 @@
+#ifndef ENV_HPP
+#define ENV_HPP
+
+#include <unordered_set>
+
+#include "objects.hpp"
+
+namespace little_r {
+  // where a symbol was found, for the evaluator's inline caches.
+  struct lookup_cache {
+    size_t epoch;
+    size_t heap_epoch;
+    objref rho;
+    objref enclos;
+    objref binding;
+    size_t depth;
+  };
+
+  // Environments.
+  //
+  // A small frame is a pairlist of bindings: each cell has the symbol as its tag and
+  // the value as its head. The chain of enclosing environments ends in null_const().
+  //
+  // A frame that grows past hash_threshold bindings moves them into an open addressing
+  // table in hashtab, a generic vector of the same binding cells indexed by the symbol's
+  // address, and the pairlist is emptied. The last element of the table is an integer
+  // holding the number of bindings. Symbols are interned so the address is the key.
+  //
+  // The evaluator caches where symbols were found. A symbol that has been cached is
+  // marked, and creating a binding for a marked symbol (or removing any binding) moves
+  // the epoch on, which invalidates every cache at once.
+  //
+  // An evaluator and its environments stay on one thread, while symbols are shared by
+  // every thread, so the epoch and the marks are kept per thread.
+  namespace env {
+    const size_t hash_threshold = 32;
+
+    inline size_t &epoch() {
+      static thread_local size_t value = 1;
+      return value;
+    }
+
+    inline void invalidate() {
+      ++epoch();
+    }
+
+    inline std::unordered_set<objref> &cached_symbols() {
+      static thread_local std::unordered_set<objref> value;
+      return value;
+    }
+
+    inline bool is_cached(objref sym) {
+      const std::unordered_set<objref> &cached = cached_symbols();
+      return !cached.empty() && cached.count(sym) != 0;
+    }
+
+    inline void mark_cached(objref sym) {
+      cached_symbols().insert(sym);
+    }
+
+    // what a function lookup stops at. the value of an unforced promise isn't known
+    // until the evaluator forces it.
+    inline bool maybe_function(objref value) {
+      if (value->type() == ot::promise) return !value->prom_value() || value->prom_value()->is_function();
+      return value->is_function();
+    }
+
+    inline bool is_hashed(objref rho) {
+      return rho->hashtab() != obj::null_const();
+    }
+
+    // the table is kept at most half full, so linear probing finds a slot in a step or two.
+    namespace table {
+      inline size_t capacity(objref tab) {
+        return tab->length() - 1;
+      }
+
+      inline int &size(objref tab) {
+        return tab->elt(capacity(tab))->data<int>()[0];
+      }
+
+      inline size_t home(objref tab, objref sym) {
+        uint64_t key = (uint64_t)(uintptr_t)sym * 0x9e3779b97f4a7c15ull;
+        return (size_t)(key >> 32) & (capacity(tab) - 1);
+      }
+
+      // the slot holding sym's binding or the empty slot where it would go.
+      inline size_t probe(objref tab, objref sym) {
+        size_t mask = capacity(tab) - 1;
+        size_t i = home(tab, sym);
+        for (objref b; (b = tab->elt(i)) != obj::null_const() && b->tag() != sym; i = (i + 1) & mask) {
+        }
+        return i;
+      }
+
+      inline objref make(size_t capacity) {
+        objref tab = obj::make_vector(ot::vec, capacity + 1);
+        tab->set_elt(capacity, obj::make_integer(0));
+        return tab;
+      }
+
+      inline void insert(objref tab, objref binding) {
+        tab->set_elt(probe(tab, binding->tag()), binding);
+        ++size(tab);
+      }
+
+      // move the following cells of the cluster back over the hole so no tombstones are needed.
+      inline void erase(objref tab, size_t hole) {
+        size_t mask = capacity(tab) - 1;
+        for (size_t i = (hole + 1) & mask; tab->elt(i) != obj::null_const(); i = (i + 1) & mask) {
+          size_t h = home(tab, tab->elt(i)->tag());
+          if (((i - h) & mask) >= ((i - hole) & mask)) {
+            tab->set_elt(hole, tab->elt(i));
+            hole = i;
+          }
+        }
+        tab->set_elt(hole, obj::null_const());
+        --size(tab);
+      }
+    }
+
+    // bindings are cells reachable from the old table, so growing allocates only the new table.
+    inline void grow(objref rho) {
+      objref old = rho->hashtab();
+      objref tab = table::make(table::capacity(old) * 2);
+      for (size_t i = 0; i != table::capacity(old); ++i) {
+        if (old->elt(i) != obj::null_const()) table::insert(tab, old->elt(i));
+      }
+      rho->set_hashtab(tab);
+    }
+
+    inline void convert_to_hashed(objref rho, size_t count) {
+      size_t capacity = 64;
+      while (capacity < count * 4) capacity *= 2;
+      objref tab = table::make(capacity);
+      for (objref b = rho->frame(); b != obj::null_const(); b = b->tail()) {
+        table::insert(tab, b);
+      }
+      rho->set_hashtab(tab);
+      rho->set_frame(obj::null_const());
+    }
+
+    inline objref make(objref enclos) {
+      return obj::make_env(obj::null_const(), enclos);
+    }
+
+    // the binding in this frame only, or nullptr.
+    inline objref find_local(objref rho, objref sym) {
+      if (is_hashed(rho)) {
+        objref b = rho->hashtab()->elt(table::probe(rho->hashtab(), sym));
+        return b != obj::null_const() ? b : nullptr;
+      }
+      for (objref b = rho->frame(); b != obj::null_const(); b = b->tail()) {
+        if (b->tag() == sym) return b;
+      }
+      return nullptr;
+    }
+
+    inline size_t num_bindings(objref rho) {
+      if (is_hashed(rho)) return (size_t)table::size(rho->hashtab());
+      size_t n = 0;
+      for (objref b = rho->frame(); b != obj::null_const(); b = b->tail()) ++n;
+      return n;
+    }
+
+    // the binding visible from rho, the environment it is in and how many
+    // enclosing environments were passed to get there.
+    // function lookups skip bindings to other values, like R's findFun.
+    inline objref find(objref rho, objref sym, bool function, size_t &depth, objref &where) {
+      for (depth = 0; rho != obj::null_const(); rho = rho->enclos(), ++depth) {
+        objref b = find_local(rho, sym);
+        if (b && (!function || maybe_function(b->head()))) {
+          where = rho;
+          return b;
+        }
+      }
+      return nullptr;
+    }
+
+    // add a binding to an environment that no cache can have seen, such as a new call frame.
+    inline void bind_fresh(objref rho, objref sym, objref value) {
+      if (is_hashed(rho)) {
+        objref b = new obj(ot::list, value);
+        b->set_tag(sym);
+        objref tab = rho->hashtab();
+        if ((size_t)table::size(tab) * 2 >= table::capacity(tab)) grow(rho);
+        table::insert(rho->hashtab(), b);
+        return;
+      }
+      objref b = new obj(ot::list, value, rho->frame());
+      b->set_tag(sym);
+      rho->set_frame(b);
+    }
+
+    // assign in this frame, creating the binding if need be.
+    // a function lookup may have skipped a binding, so a change between function
+    // and non-function values also counts as a new binding.
+    inline void define(objref rho, objref sym, objref value) {
+      objref b = find_local(rho, sym);
+      bool cached = is_cached(sym);
+      if (b) {
+        if (cached && maybe_function(b->head()) != maybe_function(value)) invalidate();
+        b->set_head(value);
+      } else {
+        if (cached) invalidate();
+        if (!is_hashed(rho)) {
+          size_t count = num_bindings(rho);
+          if (count >= hash_threshold) convert_to_hashed(rho, count);
+        }
+        bind_fresh(rho, sym, value);
+      }
+    }
+
+    // <<- assigns where the symbol is bound above rho, or in "global".
+    inline void define_super(objref rho, objref sym, objref value, objref global) {
+      for (objref e = rho->enclos(); e != obj::null_const(); e = e->enclos()) {
+        if (find_local(e, sym)) {
+          define(e, sym, value);
+          return;
+        }
+      }
+      define(global, sym, value);
+    }
+
+    inline bool remove(objref rho, objref sym) {
+      if (is_hashed(rho)) {
+        objref tab = rho->hashtab();
+        size_t i = table::probe(tab, sym);
+        if (tab->elt(i) == obj::null_const()) return false;
+        table::erase(tab, i);
+        invalidate();
+        return true;
+      }
+      objref prev = nullptr;
+      for (objref b = rho->frame(); b != obj::null_const(); prev = b, b = b->tail()) {
+        if (b->tag() == sym) {
+          if (prev) prev->set_tail(b->tail()); else rho->set_frame(b->tail());
+          invalidate();
+          return true;
+        }
+      }
+      return false;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,1269 @@
+#ifndef EVAL_HPP
+#define EVAL_HPP
+
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "arith.hpp"
+#include "bytecode.hpp"
+#include "env.hpp"
+#include "fuse.hpp"
+#include "objects.hpp"
+
+namespace little_r {
+  class evaluator;
+
+  // builtins get their arguments evaluated, specials get them as they were written.
+  typedef objref (*builtin_fn)(evaluator &ev, objref call, objref args, objref rho);
+
+  struct builtin {
+    const char *name;
+    ot type;  // ot::builtin or ot::special
+    builtin_fn fn;
+  };
+
+  // control flow that unwinds the C++ stack.
+  struct loop_break {};
+  struct loop_next {};
+
+  struct function_return {
+    objref value;
+    objref env;
+  };
+
+  // Tree-walking evaluator for the lang trees made by the parser.
+  //
+  // Each call remembers where its function was found, and each argument that is a
+  // symbol where its value was found, in a lookup_cache. An entry is good while
+  // env::epoch() and the heap's epoch are unchanged and the lookup starts either from the same environment
+  // (a loop) or from a new one with the same enclosing environment (another call of
+  // the same closure), where locals are still found in the new frame and anything
+  // else is where it was if the new frame doesn't hide it. The collector can reuse
+  // the addresses of dead environments, which the heap's epoch catches wherever the
+  // collection came from.
+  //
+  // Builtins get their arguments evaluated before the call. A closure gets a promise
+  // for each argument, evaluated in the caller's environment the first time it is used,
+  // except for constants and symbols that already have a value, which are passed as
+  // they are. Default arguments are promises evaluated in the new frame.
+  //
+  // A closure's body is compiled to bytecode (bytecode.hpp) when it is called for the
+  // jit_threshold()th time, and top level loops are compiled before they run. The
+  // bytecode runs on a stack that the collector scans.
+  class evaluator {
+  public:
+    // set on a promise while it is being forced.
+    static const unsigned prom_seen = 1;
+
+    evaluator() : heap_(heap::current()), sp_(0), jit_threshold_(2), cache_hits_(0), cache_misses_(0) {
+      missing_arg_ = obj::make_symbol("", 0);
+      dots_ = obj::make_symbol("...");
+      base_env_ = env::make(obj::null_const());
+      global_env_ = env::make(base_env_);
+      heap_.add_root(&base_env_);
+      heap_.add_root(&global_env_);
+      stack_.resize(stack_size);
+      heap_.add_root_stack(stack_.data(), &sp_);
+      const std::vector<builtin> &table = builtins();
+      for (size_t i = 0; i != table.size(); ++i) {
+        env::define(base_env_, obj::make_symbol(table[i].name), obj::make_builtin(table[i].type, (int)i));
+      }
+      env::define(base_env_, obj::make_symbol("T"), obj::make_logical(1));
+      env::define(base_env_, obj::make_symbol("F"), obj::make_logical(0));
+      env::define(base_env_, obj::make_symbol("pi"), obj::make_real(3.141592653589793238462643383280));
+    }
+
+    ~evaluator() {
+      heap_.remove_root_stack(stack_.data());
+      heap_.remove_root(&global_env_);
+      heap_.remove_root(&base_env_);
+    }
+
+    evaluator(const evaluator &) = delete;
+    evaluator &operator=(const evaluator &) = delete;
+
+    objref global_env() const { return global_env_; }
+    objref base_env() const { return base_env_; }
+
+    size_t cache_hits() const { return cache_hits_; }
+    size_t cache_misses() const { return cache_misses_; }
+
+    // calls before a closure is compiled. 0 never compiles anything.
+    unsigned jit_threshold() const { return jit_threshold_; }
+    void set_jit_threshold(unsigned value) { jit_threshold_ = value < 0xffff ? value : 0xffff; }
+
+    // the top level expressions from a parser, in the global environment. returns the last value.
+    objref eval_program(objref exprs) {
+      heap::protect_scope protect(heap_);
+      size_t slot = heap_.num_protected();
+      heap_.protect(obj::null_const());
+      objref res = obj::null_const();
+      for (objref e = exprs; e != obj::null_const(); e = e->tail()) {
+        if (jit_threshold_ && is_loop(e->head())) {
+          objref code = bc::compiler(global_env_, base_env_).compile(e->head(), false);
+          heap_.reprotect(slot, code);
+          res = run(code, global_env_);
+        } else {
+          res = eval(e->head(), global_env_);
+        }
+        heap_.reprotect(slot, res);
+        safepoint();
+      }
+      return res;
+    }
+
+    objref eval(objref e, objref rho) {
+      switch (e->type()) {
+        case ot::symbol: return symbol_value(e, lookup(nullptr, e, rho, false));
+        case ot::lang: return apply(e, rho);
+        case ot::bytecode: return run(e, rho);
+        default: return e;
+      }
+    }
+
+    // collect if it is time to. live values must be reachable from a root or the protect stack.
+    void safepoint() {
+      heap_.safepoint();
+    }
+
+    heap &get_heap() { return heap_; }
+
+  private:
+    objref apply(objref call, objref rho) {
+      heap::protect_scope protect(heap_);
+      objref fn_expr = call->head();
+      objref fn;
+      if (fn_expr->type() == ot::symbol) {
+        fn = function_value(fn_expr, lookup(call, fn_expr, rho, true));
+      } else {
+        fn = eval(fn_expr, rho);
+        if (!fn->is_function()) throw std::runtime_error("attempt to apply non-function");
+      }
+      heap_.protect(fn);
+      if (fn->type() == ot::special) {
+        return builtins()[fn->prim_offset()].fn(*this, call, call->tail(), rho);
+      }
+      if (fn->type() == ot::builtin) {
+        objref res = eval_fused(call, rho);
+        if (res) return res;
+      }
+      objref args = fn->type() == ot::closure ? promise_args(call->tail(), rho) : eval_args(call->tail(), rho);
+      return apply_function(fn, call, args, rho);
+    }
+
+    // a tree of two or more element-wise operators in one pass (fuse.hpp), or nullptr.
+    objref eval_fused(objref call, objref rho) {
+      bool nested = false;
+      for (objref a = call->tail(); a != obj::null_const(); a = a->tail()) nested |= a->head()->type() == ot::lang;
+      if (!nested || call->head()->type() != ot::symbol) return nullptr;
+      fuse::program p;
+      auto check = [this, rho](objref e) {
+        objref b = lookup(e, e->head(), rho, true);
+        return b && b == env::find_local(base_env_, e->head());
+      };
+      if (fuse::analyse(call, check, p) < 2) return nullptr;
+      for (size_t i = 0; i != p.leaves.size(); ++i) {
+        p.leaves[i] = eval(p.leaves[i], rho);
+        heap_.protect(p.leaves[i]);
+      }
+      return fuse::run(p.code.data(), p.code.size(), p.leaves.data());
+    }
+
+    // a builtin or closure with evaluated arguments. both must be protected.
+    objref apply_function(objref fn, objref call, objref args, objref rho) {
+      if (fn->type() == ot::builtin) {
+        return builtins()[fn->prim_offset()].fn(*this, call, args, rho);
+      }
+      if (fn->type() != ot::closure) throw std::runtime_error("attempt to apply non-function");
+      heap::protect_scope protect(heap_);
+      if (jit_threshold_ && fn->body()->type() != ot::bytecode) {
+        unsigned calls = fn->levels() + 1;
+        if (calls >= jit_threshold_) {
+          fn->set_body(bc::compiler(fn->cloenv(), base_env_).compile(fn->body(), true, fn->formals()));
+        } else {
+          fn->set_levels(calls);
+        }
+      }
+      objref fenv = env::make(fn->cloenv());
+      heap_.protect(fenv);
+      match_args(fn->formals(), args, fenv);
+      safepoint();
+      try {
+        return eval(fn->body(), fenv);
+      } catch (function_return &ret) {
+        if (ret.env != fenv) throw;
+        return ret.value;
+      }
+    }
+
+    // puts the stack back as it was when an error unwinds through run().
+    struct stack_guard {
+      stack_guard(size_t &sp) : sp(sp), saved(sp) {}
+      ~stack_guard() { sp = saved; }
+      size_t &sp;
+      size_t saved;
+    };
+
+    // the value is complete before the slot is taken, so a collection
+    // while it is made never sees an unset slot.
+    void push(objref value) {
+      stack_[sp_++] = value;
+    }
+
+    // run bytecode in "rho". the code must be protected.
+    objref run(objref code, objref rho) {
+      using bc::op;
+      const int *start = code->bc_code()->data<int>();
+      const int *pc = start + 1;
+      if (sp_ + (size_t)start[0] > stack_.size()) throw std::runtime_error("evaluation nested too deeply");
+      const objref *consts = code->bc_consts()->data<objref>();
+      lookup_cache *caches = (lookup_cache*)code->bc_caches()->data<rbyte>();
+      objref *stack = stack_.data();
+      stack_guard guard(sp_);
+
+      #define BC_POP() (stack[--sp_])
+      #define BC_TOP() (stack[sp_ - 1])
+      #define BC_ARITH(name, o) BC_OP(name): { objref y = BC_POP(); BC_TOP() = arith::scalar_binary(o, BC_TOP(), y); BC_NEXT(); }
+
+      #if LITTLE_R_THREADED_CODE
+        static void *const labels[] = {
+          #define LITTLE_R_BC_LABEL(name, operands, effect) &&op_##name,
+          LITTLE_R_BC_OPS(LITTLE_R_BC_LABEL)
+          #undef LITTLE_R_BC_LABEL
+        };
+        #define BC_OP(name) op_##name
+        #define BC_NEXT() goto *labels[*pc++]
+        BC_NEXT();
+      #else
+        #define BC_OP(name) case op::name
+        #define BC_NEXT() goto dispatch
+        dispatch:
+        switch ((op)*pc++) {
+      #endif
+
+      BC_OP(ldconst): {
+        push(consts[pc[0]]);
+        pc += 1;
+        BC_NEXT();
+      }
+      BC_OP(ldnull): {
+        push(obj::null_const());
+        BC_NEXT();
+      }
+      BC_OP(getvar): {
+        objref sym = consts[pc[0]];
+        push(symbol_value(sym, cached_lookup(&caches[pc[1]], sym, rho, false)));
+        pc += 2;
+        BC_NEXT();
+      }
+      BC_OP(setvar): {
+        env::define(rho, consts[pc[0]], BC_TOP());
+        pc += 1;
+        BC_NEXT();
+      }
+      BC_OP(setvar2): {
+        env::define_super(rho, consts[pc[0]], BC_TOP(), global_env_);
+        pc += 1;
+        BC_NEXT();
+      }
+      BC_OP(pop): {
+        --sp_;
+        BC_NEXT();
+      }
+      BC_OP(popn): {
+        sp_ -= pc[0];
+        pc += 1;
+        BC_NEXT();
+      }
+      BC_ARITH(add, arith::op::add)
+      BC_ARITH(sub, arith::op::sub)
+      BC_ARITH(mul, arith::op::mul)
+      BC_ARITH(div, arith::op::div)
+      BC_ARITH(pow, arith::op::pow)
+      BC_ARITH(mod, arith::op::mod)
+      BC_ARITH(idiv, arith::op::idiv)
+      BC_ARITH(eq, arith::op::eq)
+      BC_ARITH(ne, arith::op::ne)
+      BC_ARITH(lt, arith::op::lt)
+      BC_ARITH(le, arith::op::le)
+      BC_ARITH(gt, arith::op::gt)
+      BC_ARITH(ge, arith::op::ge)
+      BC_ARITH(and_, arith::op::and_)
+      BC_ARITH(or_, arith::op::or_)
+      BC_OP(uminus): {
+        BC_TOP() = arith::negate(BC_TOP());
+        BC_NEXT();
+      }
+      BC_OP(uplus): {
+        if (!arith::is_numeric(BC_TOP())) throw std::runtime_error("invalid argument to unary operator");
+        BC_NEXT();
+      }
+      BC_OP(not_): {
+        BC_TOP() = arith::logical_not(BC_TOP());
+        BC_NEXT();
+      }
+      BC_OP(fused): {
+        objref program = consts[pc[0]];
+        size_t n = (size_t)pc[1];
+        objref res = fuse::run(program->data<int>(), program->length(), &stack[sp_ - n]);
+        sp_ -= n;
+        push(res);
+        pc += 2;
+        BC_NEXT();
+      }
+      BC_OP(goto_): {
+        pc = start + pc[0];
+        BC_NEXT();
+      }
+      BC_OP(brifnot): {
+        pc = as_bool(BC_POP()) ? pc + 1 : start + pc[0];
+        BC_NEXT();
+      }
+      BC_OP(and1st): {
+        if (as_bool(BC_TOP())) {
+          pc += 1;
+        } else {
+          BC_TOP() = obj::make_logical(0);
+          pc = start + pc[0];
+        }
+        BC_NEXT();
+      }
+      BC_OP(and2nd): {
+        BC_TOP() = obj::make_logical(as_bool(BC_TOP()));
+        BC_NEXT();
+      }
+      BC_OP(or1st): {
+        if (as_bool(BC_TOP())) {
+          BC_TOP() = obj::make_logical(1);
+          pc = start + pc[0];
+        } else {
+          pc += 1;
+        }
+        BC_NEXT();
+      }
+      BC_OP(or2nd): {
+        BC_TOP() = obj::make_logical(as_bool(BC_TOP()));
+        BC_NEXT();
+      }
+      // the sequence stays on the stack under an integer counter.
+      BC_OP(startfor): {
+        objref seq = BC_TOP();
+        if (seq != obj::null_const() && !is_vector(seq)) throw std::runtime_error("invalid for() loop sequence");
+        push(obj::make_integer(-1));
+        pc = start + pc[1];
+        BC_NEXT();
+      }
+      BC_OP(stepfor): {
+        objref seq = stack[sp_ - 2];
+        int i = ++BC_TOP()->data<int>()[0];
+        if ((size_t)i < (seq == obj::null_const() ? 0 : seq->length())) {
+          env::define(rho, consts[pc[0]], element(seq, i));
+          safepoint();
+          pc = start + pc[1];
+        } else {
+          pc += 2;
+        }
+        BC_NEXT();
+      }
+      BC_OP(endfor): {
+        sp_ -= 2;
+        push(obj::null_const());
+        BC_NEXT();
+      }
+      BC_OP(loopback): {
+        safepoint();
+        pc = start + pc[0];
+        BC_NEXT();
+      }
+      BC_OP(getfun): {
+        objref call = consts[pc[0]];
+        objref fn = function_value(call->head(), cached_lookup(&caches[pc[1]], call->head(), rho, true));
+        if (fn->type() == ot::special) {
+          objref res = builtins()[fn->prim_offset()].fn(*this, call, call->tail(), rho);
+          push(res);
+          pc = start + pc[2];
+        } else {
+          push(fn);
+          push(obj::null_const());
+          push(obj::null_const());
+          pc += 3;
+        }
+        BC_NEXT();
+      }
+      // the function is under the argument list and its last cell.
+      BC_OP(getarg): {
+        objref sym = consts[pc[0]];
+        objref b = cached_lookup(&caches[pc[1]], sym, rho, false);
+        objref value = stack[sp_ - 3]->type() == ot::closure ? arg_value(sym, b, rho) : symbol_value(sym, b);
+        push(value);
+        pc += 2;
+        BC_NEXT();
+      }
+      BC_OP(makeprom): {
+        if (stack[sp_ - 3]->type() == ot::closure) {
+          push(obj::make_promise(consts[pc[0]], rho));
+          pc = start + pc[1];
+        } else {
+          pc += 2;
+        }
+        BC_NEXT();
+      }
+      // the argument list being built is under its last cell.
+      BC_OP(pusharg): {
+        objref cell = new obj(ot::list, BC_POP());
+        if (pc[0] >= 0) cell->set_tag(consts[pc[0]]);
+        if (BC_TOP() == obj::null_const()) stack[sp_ - 2] = cell; else BC_TOP()->set_tail(cell);
+        BC_TOP() = cell;
+        pc += 1;
+        BC_NEXT();
+      }
+      BC_OP(dodots): {
+        objref b = lookup(nullptr, dots_, rho, false);
+        if (!b) throw std::runtime_error("'...' used in an incorrect context");
+        bool force_dots = stack[sp_ - 3]->type() != ot::closure;
+        for (objref d = b->head(); d->type() == ot::dot || d->type() == ot::list; d = d->tail()) {
+          objref cell = new obj(ot::list, force_dots ? value_of(d->head()) : d->head());
+          cell->set_tag(d->tag());
+          if (BC_TOP() == obj::null_const()) stack[sp_ - 2] = cell; else BC_TOP()->set_tail(cell);
+          BC_TOP() = cell;
+        }
+        BC_NEXT();
+      }
+      BC_OP(call): {
+        objref res = apply_function(stack[sp_ - 3], consts[pc[0]], stack[sp_ - 2], rho);
+        sp_ -= 2;
+        BC_TOP() = res;
+        pc += 1;
+        BC_NEXT();
+      }
+      BC_OP(makeclosure): {
+        objref e = consts[pc[0]]->tail();
+        push(obj::make_closure(e->head(), e->tail()->head(), rho));
+        pc += 1;
+        BC_NEXT();
+      }
+      BC_OP(eval): {
+        objref res = eval(consts[pc[0]], rho);
+        push(res);
+        pc += 1;
+        BC_NEXT();
+      }
+      BC_OP(return_): {
+        return BC_POP();
+      }
+
+      #if !LITTLE_R_THREADED_CODE
+        default: throw std::runtime_error("bad bytecode");
+        }
+      #endif
+
+      #undef BC_POP
+      #undef BC_TOP
+      #undef BC_ARITH
+      #undef BC_OP
+      #undef BC_NEXT
+    }
+
+    // the binding of "sym" seen from "rho". "site" is the cell whose attrib holds the cache.
+    objref lookup(objref site, objref sym, objref rho, bool function) {
+      if (!site) {
+        size_t depth;
+        objref where;
+        return env::find(rho, sym, function, depth, where);
+      }
+      objref c = site->attrib();
+      if (c->type() != ot::raw) {
+        c = obj::make_vector(ot::raw, sizeof(lookup_cache));
+        memset(c->data<rbyte>(), 0, sizeof(lookup_cache));
+        site->set_attrib(c);
+      }
+      return cached_lookup((lookup_cache*)c->data<rbyte>(), sym, rho, function);
+    }
+
+    objref cached_lookup(lookup_cache *lc, objref sym, objref rho, bool function) {
+      if (lc->epoch == env::epoch() && lc->heap_epoch == heap_.epoch() && (!function || env::maybe_function(lc->binding->head()))) {
+        if (lc->rho == rho) {
+          ++cache_hits_;
+          return lc->binding;
+        }
+        if (lc->enclos == rho->enclos()) {
+          // another call of the same closure: a local is found locally, anything else where it was.
+          objref b = env::find_local(rho, sym);
+          if (lc->depth == 0 ? b && (!function || env::maybe_function(b->head())) : !b) {
+            ++cache_hits_;
+            return b ? b : lc->binding;
+          }
+        }
+      }
+      size_t depth;
+      objref where;
+      objref b = env::find(rho, sym, function, depth, where);
+      if (b) {
+        ++cache_misses_;
+        lookup_cache entry = { env::epoch(), heap_.epoch(), rho, rho->enclos(), b, depth };
+        *lc = entry;
+        // a new binding nearer than "where" would hide this one.
+        if (depth != 0) env::mark_cached(sym);
+      }
+      return b;
+    }
+
+    objref symbol_value(objref sym, objref binding) {
+      if (!binding) throw std::runtime_error(std::string("object '") + sym->chr_data() + "' not found");
+      objref value = binding->head();
+      if (value == missing_arg_) {
+        throw std::runtime_error(std::string("argument \"") + sym->chr_data() + "\" is missing, with no default");
+      }
+      return value_of(value);
+    }
+
+    // the function a function lookup found. a promise in the way is forced to see what it holds.
+    objref function_value(objref sym, objref binding) {
+      if (!binding) throw std::runtime_error(std::string("could not find function \"") + sym->chr_data() + "\"");
+      objref fn = value_of(binding->head());
+      if (!fn->is_function()) throw std::runtime_error("attempt to apply non-function");
+      return fn;
+    }
+
+    objref value_of(objref value) {
+      return value->type() == ot::promise ? force(value) : value;
+    }
+
+    // evaluate a promise the first time it is used and keep the value.
+    objref force(objref p) {
+      if (p->prom_value()) return p->prom_value();
+      if (p->levels() & prom_seen) {
+        throw std::runtime_error("promise already under evaluation: recursive default argument reference or earlier problems?");
+      }
+      heap::protect_scope protect(heap_);
+      heap_.protect(p);
+      p->set_levels(p->levels() | prom_seen);
+      objref value;
+      try {
+        value = eval(p->prom_expr(), p->prom_env());
+      } catch (...) {
+        p->set_levels(p->levels() & ~prom_seen);
+        throw;
+      }
+      p->set_levels(p->levels() & ~prom_seen);
+      p->set_prom_value(value);
+      p->set_prom_env(obj::null_const());
+      return value;
+    }
+
+    // a closure argument that is a symbol. its value if it has one, which saves making a promise.
+    objref arg_value(objref sym, objref binding, objref rho) {
+      if (binding) {
+        objref value = binding->head();
+        if (value->type() == ot::promise) {
+          return value->prom_value() ? value->prom_value() : value;
+        }
+        if (value != missing_arg_) return value;
+      }
+      return obj::make_promise(sym, rho);
+    }
+
+    // evaluated arguments with their tags. ... is expanded. the result stays protected
+    // until the caller's protect_scope ends.
+    objref eval_args(objref cells, objref rho) {
+      list_builder res;
+      size_t slot = start_args(res, cells);
+      for (objref c = cells; c != obj::null_const(); c = c->tail()) {
+        objref e = c->head();
+        if (e == dots_) {
+          objref b = lookup(nullptr, dots_, rho, false);
+          if (!b) throw std::runtime_error("'...' used in an incorrect context");
+          for (objref d = b->head(); d->type() == ot::dot || d->type() == ot::list; d = d->tail()) {
+            append(res, slot, value_of(d->head()), d->tag());
+          }
+          continue;
+        }
+        objref value =
+          e == missing_arg_ ? e :
+          e->type() == ot::symbol ? symbol_value(e, lookup(c, e, rho, false)) :
+          eval(e, rho)
+        ;
+        append(res, slot, value, c->tag());
+      }
+      return res.result();
+    }
+
+    // arguments for a closure, as eval_args. calls become promises and ... passes on the caller's.
+    objref promise_args(objref cells, objref rho) {
+      list_builder res;
+      size_t slot = start_args(res, cells);
+      for (objref c = cells; c != obj::null_const(); c = c->tail()) {
+        objref e = c->head();
+        if (e == dots_) {
+          objref b = lookup(nullptr, dots_, rho, false);
+          if (!b) throw std::runtime_error("'...' used in an incorrect context");
+          for (objref d = b->head(); d->type() == ot::dot || d->type() == ot::list; d = d->tail()) {
+            append(res, slot, d->head(), d->tag());
+          }
+          continue;
+        }
+        objref value =
+          e == missing_arg_ ? e :
+          e->type() == ot::symbol ? arg_value(e, lookup(c, e, rho, false), rho) :
+          e->type() == ot::lang ? obj::make_promise(e, rho) :
+          e
+        ;
+        append(res, slot, value, c->tag());
+      }
+      return res.result();
+    }
+
+    // longer argument lists get their cells in one run. short ones are quicker from the free list.
+    // the list is protected by the slot that is returned.
+    size_t start_args(list_builder &res, objref cells) {
+      size_t n = 0;
+      for (objref c = cells; c != obj::null_const(); c = c->tail()) {
+        if (c->head() != dots_) ++n;
+      }
+      if (n >= 4) res.reserve(n);
+      size_t slot = heap_.num_protected();
+      heap_.protect(res.head());
+      return slot;
+    }
+
+    void append(list_builder &res, size_t slot, objref value, objref tag) {
+      bool first = res.empty();
+      res.push_back(value, tag);
+      if (first) heap_.reprotect(slot, res.head());
+    }
+
+    // exact names first, then position. arguments that are left go to ... if there is one.
+    // defaults are evaluated in the new frame once everything else is bound.
+    void match_args(objref formals, objref args, objref fenv) {
+      size_t num_formals = 0, num_args = 0;
+      for (objref f = formals; f != obj::null_const(); f = f->tail()) ++num_formals;
+      for (objref a = args; a != obj::null_const(); a = a->tail()) ++num_args;
+
+      objref small_values[16];
+      bool small_used[16];
+      std::vector<objref> big_values;
+      std::vector<char> big_used;
+      objref *values = small_values;
+      bool *used = small_used;
+      if (num_formals > 16 || num_args > 16) {
+        big_values.resize(num_formals);
+        big_used.resize(num_args);
+        values = big_values.data();
+        used = (bool*)big_used.data();
+      }
+      for (size_t i = 0; i != num_formals; ++i) values[i] = nullptr;
+      for (size_t i = 0; i != num_args; ++i) used[i] = false;
+
+      size_t ai = 0;
+      for (objref a = args; a != obj::null_const(); a = a->tail(), ++ai) {
+        if (a->tag() == obj::null_const()) continue;
+        size_t fi = 0;
+        for (objref f = formals; f != obj::null_const(); f = f->tail(), ++fi) {
+          if (f->tag() == a->tag() && f->tag() != dots_) {
+            if (values[fi]) throw std::runtime_error(std::string("formal argument \"") + f->tag()->chr_data() + "\" matched by multiple actual arguments");
+            values[fi] = a->head();
+            used[ai] = true;
+            break;
+          }
+        }
+      }
+
+      objref a = args;
+      ai = 0;
+      size_t fi = 0;
+      objref dots = nullptr;
+      for (objref f = formals; f != obj::null_const(); f = f->tail(), ++fi) {
+        if (f->tag() == dots_) {
+          dots = f;
+          break;
+        }
+        if (values[fi]) continue;
+        while (a != obj::null_const() && (used[ai] || a->tag() != obj::null_const())) {
+          a = a->tail();
+          ++ai;
+        }
+        if (a == obj::null_const()) continue;
+        values[fi] = a->head();
+        used[ai] = true;
+      }
+
+      list_builder dots_list(ot::dot, ot::dot);
+      ai = 0;
+      for (objref a = args; a != obj::null_const(); a = a->tail(), ++ai) {
+        if (used[ai]) continue;
+        if (!dots) throw std::runtime_error("unused argument");
+        dots_list.push_back(a->head(), a->tag());
+      }
+      objref rest = dots_list.result();
+
+      fi = 0;
+      for (objref f = formals; f != obj::null_const(); f = f->tail(), ++fi) {
+        objref value = f == dots ? rest : values[fi] ? values[fi] : default_value(f->head(), fenv);
+        env::bind_fresh(fenv, f->tag(), value);
+      }
+    }
+
+    objref default_value(objref e, objref fenv) {
+      if (e == missing_arg_) return e;
+      return e->type() == ot::symbol || e->type() == ot::lang ? obj::make_promise(e, fenv) : e;
+    }
+
+    static objref arg(objref args, size_t i) {
+      for (; i != 0 && args != obj::null_const(); --i) args = args->tail();
+      if (args == obj::null_const()) throw std::runtime_error("missing argument");
+      return args->head();
+    }
+
+    static size_t num_args(objref args) {
+      size_t n = 0;
+      for (; args != obj::null_const(); args = args->tail()) ++n;
+      return n;
+    }
+
+    static bool as_bool(objref x) {
+      if (!arith::is_numeric(x)) throw std::runtime_error("argument is not interpretable as logical");
+      if (x->length() == 0) throw std::runtime_error("argument is of length zero");
+      int value = arith::logical_at(x, 0);
+      if (value == na_logical) throw std::runtime_error("missing value where TRUE/FALSE needed");
+      return value != 0;
+    }
+
+    // atomic vectors.
+    static bool is_vector(objref x) {
+      return x->type() != ot::vec && obj::elem_size(x->type()) != 0;
+    }
+
+    static bool is_loop(objref e) {
+      if (e->type() != ot::lang || e->head()->type() != ot::symbol) return false;
+      std::string name = e->head()->chr_data();
+      return name == "for" || name == "while" || name == "repeat";
+    }
+
+    static objref element(objref x, size_t i) {
+      size_t size = obj::elem_size(x->type());
+      objref res = obj::make_vector(x->type(), 1);
+      memcpy(element_data(res), element_data(x) + i * size, size);
+      return res;
+    }
+
+    static char *element_data(objref x) {
+      switch (x->type()) {
+        case ot::logical: case ot::integer: return (char*)x->data<int>();
+        case ot::real: return (char*)x->data<double>();
+        case ot::complex: return (char*)x->data<rcomplex>();
+        default: return (char*)x->data<rbyte>();
+      }
+    }
+
+    // specials
+
+    static objref do_quote(evaluator &, objref, objref args, objref) {
+      return arg(args, 0);
+    }
+
+    static objref do_if(evaluator &ev, objref, objref args, objref rho) {
+      if (as_bool(ev.eval(arg(args, 0), rho))) {
+        return ev.eval(arg(args, 1), rho);
+      }
+      objref rest = args->tail()->tail();
+      return rest != obj::null_const() ? ev.eval(rest->head(), rho) : obj::null_const();
+    }
+
+    static objref do_for(evaluator &ev, objref, objref args, objref rho) {
+      heap::protect_scope protect(ev.heap_);
+      objref sym = arg(args, 0);
+      objref seq = ev.eval(arg(args, 1), rho);
+      objref body = arg(args, 2);
+      ev.heap_.protect(seq);
+      if (seq != obj::null_const() && !is_vector(seq)) throw std::runtime_error("invalid for() loop sequence");
+      size_t n = seq == obj::null_const() ? 0 : seq->length();
+      for (size_t i = 0; i != n; ++i) {
+        env::define(rho, sym, element(seq, i));
+        try {
+          ev.eval(body, rho);
+        } catch (loop_next &) {
+        } catch (loop_break &) {
+          break;
+        }
+        ev.safepoint();
+      }
+      return obj::null_const();
+    }
+
+    static objref do_while(evaluator &ev, objref, objref args, objref rho) {
+      objref cond = arg(args, 0);
+      objref body = arg(args, 1);
+      while (as_bool(ev.eval(cond, rho))) {
+        try {
+          ev.eval(body, rho);
+        } catch (loop_next &) {
+        } catch (loop_break &) {
+          break;
+        }
+        ev.safepoint();
+      }
+      return obj::null_const();
+    }
+
+    static objref do_repeat(evaluator &ev, objref, objref args, objref rho) {
+      objref body = arg(args, 0);
+      for (;;) {
+        try {
+          ev.eval(body, rho);
+        } catch (loop_next &) {
+        } catch (loop_break &) {
+          break;
+        }
+        ev.safepoint();
+      }
+      return obj::null_const();
+    }
+
+    static objref do_break(evaluator &, objref, objref, objref) {
+      throw loop_break();
+    }
+
+    static objref do_next(evaluator &, objref, objref, objref) {
+      throw loop_next();
+    }
+
+    static objref do_function(evaluator &, objref, objref args, objref rho) {
+      return obj::make_closure(arg(args, 0), arg(args, 1), rho);
+    }
+
+    static objref do_return(evaluator &ev, objref, objref args, objref rho) {
+      function_return ret = { args != obj::null_const() ? ev.eval(args->head(), rho) : obj::null_const(), rho };
+      throw ret;
+    }
+
+    // x <- value, and f(x, ...) <- value as x <- `f<-`(x, ..., value = value).
+    static objref assign(evaluator &ev, objref args, objref rho, bool super) {
+      heap::protect_scope protect(ev.heap_);
+      objref lhs = arg(args, 0);
+      objref value = ev.eval(arg(args, 1), rho);
+      ev.heap_.protect(value);
+      objref target = lhs;
+      if (lhs->type() == ot::chr) {
+        target = obj::make_symbol(lhs->chr_data());
+      } else if (lhs->type() == ot::lang) {
+        target = lhs->tail()->head();
+        if (lhs->head()->type() != ot::symbol || target->type() != ot::symbol) {
+          throw std::runtime_error("invalid assignment target");
+        }
+        objref fn_sym = obj::make_symbol(std::string(lhs->head()->chr_data()) + "<-");
+        objref fn = ev.function_value(fn_sym, ev.lookup(nullptr, fn_sym, rho, true));
+        ev.heap_.protect(fn);
+        objref current = ev.symbol_value(target, super ? ev.lookup(nullptr, target, rho->enclos(), false) : ev.lookup(nullptr, target, rho, false));
+        objref rest = ev.eval_args(lhs->tail()->tail(), rho);
+        objref value_cell = new obj(ot::list, value);
+        value_cell->set_tag(obj::make_symbol("value"));
+        objref fn_args = new obj(ot::list, current, rest == obj::null_const() ? value_cell : rest);
+        if (rest != obj::null_const()) {
+          objref last = rest;
+          while (last->tail() != obj::null_const()) last = last->tail();
+          last->set_tail(value_cell);
+        }
+        ev.heap_.protect(fn_args);
+        value = ev.apply_function(fn, lhs, fn_args, rho);
+        ev.heap_.protect(value);
+      } else if (lhs->type() != ot::symbol) {
+        throw std::runtime_error("invalid assignment target");
+      }
+      if (super) {
+        env::define_super(rho, target, value, ev.global_env_);
+      } else {
+        env::define(rho, target, value);
+      }
+      return value;
+    }
+
+    static objref do_assign(evaluator &ev, objref, objref args, objref rho) {
+      return assign(ev, args, rho, false);
+    }
+
+    static objref do_super_assign(evaluator &ev, objref, objref args, objref rho) {
+      return assign(ev, args, rho, true);
+    }
+
+    static objref do_begin(evaluator &ev, objref, objref args, objref rho) {
+      objref res = obj::null_const();
+      for (; args != obj::null_const(); args = args->tail()) {
+        res = ev.eval(args->head(), rho);
+      }
+      return res;
+    }
+
+    static objref do_paren(evaluator &ev, objref, objref args, objref rho) {
+      return ev.eval(arg(args, 0), rho);
+    }
+
+    static objref do_and2(evaluator &ev, objref, objref args, objref rho) {
+      return obj::make_logical(as_bool(ev.eval(arg(args, 0), rho)) && as_bool(ev.eval(arg(args, 1), rho)));
+    }
+
+    static objref do_or2(evaluator &ev, objref, objref args, objref rho) {
+      return obj::make_logical(as_bool(ev.eval(arg(args, 0), rho)) || as_bool(ev.eval(arg(args, 1), rho)));
+    }
+
+    // builtins
+
+    template <arith::op O>
+    static objref do_arith(evaluator &, objref, objref args, objref) {
+      if (num_args(args) == 1) {
+        if (O == arith::op::sub) return arith::negate(arg(args, 0));
+        if (O == arith::op::add) return arg(args, 0);
+      }
+      return arith::scalar_binary(O, arg(args, 0), arg(args, 1));
+    }
+
+    static objref do_not(evaluator &, objref, objref args, objref) {
+      return arith::logical_not(arg(args, 0));
+    }
+
+    static objref do_colon(evaluator &, objref, objref args, objref) {
+      objref from = arg(args, 0), to = arg(args, 1);
+      if (!arith::is_numeric(from) || !arith::is_numeric(to) || from->length() == 0 || to->length() == 0) {
+        throw std::runtime_error("argument of length 0");
+      }
+      double a = arith::coerce(from, ot::real)->data<double>()[0];
+      double b = arith::coerce(to, ot::real)->data<double>()[0];
+      if (a != a || b != b) throw std::runtime_error("NA/NaN argument");
+      double r = std::fabs(b - a);
+      if (!std::isfinite(r) || r >= (double)std::numeric_limits<node_length>::max()) {
+        throw std::runtime_error("result would be too long a vector");
+      }
+      size_t n = (size_t)(r + 1e-10) + 1;
+      // the range first, as casting a double outside it to int is undefined.
+      bool integer = a > INT_MIN && a <= INT_MAX && b > INT_MIN && b <= INT_MAX && a == (int)a;
+      objref res = obj::make_vector(integer ? ot::integer : ot::real, n);
+      for (size_t i = 0; i != n; ++i) {
+        double v = a <= b ? a + i : a - i;
+        if (integer) res->data<int>()[i] = (int)v; else res->data<double>()[i] = v;
+      }
+      return res;
+    }
+
+    // c() of atomic vectors. the result has the highest type of the arguments.
+    static objref do_c(evaluator &, objref, objref args, objref) {
+      ot type = ot::nil;
+      size_t n = 0;
+      for (objref a = args; a != obj::null_const(); a = a->tail()) {
+        objref x = a->head();
+        if (x == obj::null_const()) continue;
+        if (!is_vector(x) || x->type() == ot::raw) throw std::runtime_error("c() of this type is not supported");
+        if (type == ot::nil || (unsigned)x->type() > (unsigned)type) type = x->type();
+        n += x->length();
+      }
+      if (type == ot::nil) return obj::null_const();
+      objref res = obj::make_vector(type, n);
+      size_t i = 0;
+      for (objref a = args; a != obj::null_const(); a = a->tail()) {
+        objref x = a->head();
+        if (x == obj::null_const()) continue;
+        for (size_t j = 0; j != x->length(); ++j, ++i) {
+          set_element(res, i, x, j);
+        }
+      }
+      return res;
+    }
+
+    // res[i] <- x[j] converting up to the type of res.
+    static void set_element(objref res, size_t i, objref x, size_t j) {
+      if (res->type() == x->type()) {
+        size_t size = obj::elem_size(x->type());
+        memcpy(element_data(res) + i * size, element_data(x) + j * size, size);
+        return;
+      }
+      double value = x->type() == ot::real ? x->data<double>()[j] : x->data<int>()[j] == na_integer ? na_real() : x->data<int>()[j];
+      switch (res->type()) {
+        case ot::integer: res->data<int>()[i] = x->data<int>()[j]; break;
+        case ot::real: res->data<double>()[i] = value; break;
+        case ot::complex: {
+          rcomplex c = { value, is_na(value) ? value : 0 };
+          res->data<rcomplex>()[i] = c;
+          break;
+        }
+        default: throw std::runtime_error("can't convert element");
+      }
+    }
+
+    static objref do_length(evaluator &, objref, objref args, objref) {
+      objref x = arg(args, 0);
+      if (x == obj::null_const()) return obj::make_integer(0);
+      if (is_vector(x)) return obj::make_integer((int)x->length());
+      if (x->type() == ot::list || x->type() == ot::lang) return obj::make_integer((int)num_args(x));
+      return obj::make_integer(1);
+    }
+
+    static objref do_sum(evaluator &, objref, objref args, objref) {
+      bool real = false;
+      for (objref a = args; a != obj::null_const(); a = a->tail()) {
+        if (!arith::is_numeric(a->head())) throw std::runtime_error("invalid 'type' of argument");
+        real |= a->head()->type() == ot::real;
+      }
+      double total = 0;
+      long long itotal = 0;
+      bool na = false;
+      for (objref a = args; a != obj::null_const(); a = a->tail()) {
+        objref x = a->head();
+        for (size_t i = 0; i != x->length(); ++i) {
+          if (x->type() == ot::real) {
+            total += x->data<double>()[i];
+          } else if (x->data<int>()[i] == na_integer) {
+            na = true;
+          } else {
+            itotal += x->data<int>()[i];
+            total += x->data<int>()[i];
+          }
+        }
+      }
+      if (real) return obj::make_real(na ? na_real() : total);
+      return obj::make_integer(na ? na_integer : arith::int_result(itotal));
+    }
+
+    // is.na, is.nan, is.finite and is.infinite. NA_real_ is a NaN so is.na is true of both.
+    enum class test { na, nan, finite, infinite };
+
+    template <test T>
+    static objref do_is(evaluator &, objref, objref args, objref) {
+      objref x = arg(args, 0);
+      size_t n = is_vector(x) ? x->length() : 0;
+      objref res = obj::make_vector(ot::logical, n);
+      int *r = res->data<int>();
+      for (size_t i = 0; i != n; ++i) {
+        switch (x->type()) {
+          case ot::logical: case ot::integer: {
+            int v = x->data<int>()[i];
+            r[i] = T == test::na ? v == na_integer : T == test::finite ? v != na_integer : 0;
+            break;
+          }
+          case ot::real: {
+            double v = x->data<double>()[i];
+            r[i] = T == test::na ? v != v : T == test::nan ? v != v && !is_na(v) :
+              T == test::finite ? std::isfinite(v) : std::isinf(v);
+            break;
+          }
+          case ot::complex: {
+            rcomplex v = x->data<rcomplex>()[i];
+            r[i] = T == test::na ? v.r != v.r || v.i != v.i :
+              T == test::nan ? (v.r != v.r && !is_na(v.r)) || (v.i != v.i && !is_na(v.i)) :
+              T == test::finite ? std::isfinite(v.r) && std::isfinite(v.i) : std::isinf(v.r) || std::isinf(v.i);
+            break;
+          }
+          default: r[i] = 0; break;
+        }
+      }
+      return res;
+    }
+
+    // all() and any() of logical vectors. an NA only matters if nothing decides the answer.
+    template <bool All>
+    static objref do_all_any(evaluator &, objref, objref args, objref) {
+      bool na = false;
+      for (objref a = args; a != obj::null_const(); a = a->tail()) {
+        objref x = a->head();
+        if (x == obj::null_const()) continue;
+        if (!arith::is_numeric(x)) throw std::runtime_error("invalid 'type' of argument");
+        for (size_t i = 0; i != x->length(); ++i) {
+          int v = arith::logical_at(x, i);
+          if (v == na_logical) na = true; else if ((v != 0) != All) return obj::make_logical(!All);
+        }
+      }
+      return obj::make_logical(na ? na_logical : All);
+    }
+
+    // positive indices, negative indices to drop, logical masks or a missing index for everything.
+    static std::vector<size_t> indices(objref x, objref index) {
+      std::vector<size_t> res;
+      size_t n = x->length();
+      if (index->type() == ot::symbol) {
+        for (size_t i = 0; i != n; ++i) res.push_back(i);
+      } else if (index->type() == ot::logical) {
+        size_t m = index->length() > n ? index->length() : n;
+        for (size_t i = 0; i != m && index->length() != 0; ++i) {
+          int v = index->data<int>()[i % index->length()];
+          if (v == na_logical) res.push_back((size_t)-1); else if (v) res.push_back(i);
+        }
+      } else if (arith::is_numeric(index)) {
+        objref r = arith::coerce(index, ot::real);
+        bool negative = false;
+        for (size_t i = 0; i != r->length(); ++i) negative |= r->data<double>()[i] < 0;
+        if (negative) {
+          std::vector<char> keep(n, 1);
+          for (size_t i = 0; i != r->length(); ++i) {
+            double v = r->data<double>()[i];
+            if (v > 0) throw std::runtime_error("can't mix positive and negative subscripts");
+            if (-v >= 1 && -v <= n) keep[(size_t)-v - 1] = 0;
+          }
+          for (size_t i = 0; i != n; ++i) if (keep[i]) res.push_back(i);
+        } else {
+          for (size_t i = 0; i != r->length(); ++i) {
+            double v = r->data<double>()[i];
+            if (v != v) res.push_back((size_t)-1); else if (v >= 1) res.push_back((size_t)v - 1);
+          }
+        }
+      } else {
+        throw std::runtime_error("invalid subscript type");
+      }
+      return res;
+    }
+
+    static void set_na(objref x, size_t i) {
+      switch (x->type()) {
+        case ot::logical: case ot::integer: x->data<int>()[i] = na_integer; break;
+        case ot::real: x->data<double>()[i] = na_real(); break;
+        case ot::complex: { rcomplex c = { na_real(), na_real() }; x->data<rcomplex>()[i] = c; break; }
+        default: x->data<rbyte>()[i] = 0; break;
+      }
+    }
+
+    static objref do_subset(evaluator &ev, objref, objref args, objref) {
+      objref x = arg(args, 0);
+      if (x == obj::null_const()) return x;
+      if (!is_vector(x)) throw std::runtime_error("object is not subsettable");
+      objref index = args->tail() != obj::null_const() ? arg(args, 1) : ev.missing_arg_;
+      std::vector<size_t> idx = indices(x, index);
+      objref res = obj::make_vector(x->type(), idx.size());
+      for (size_t i = 0; i != idx.size(); ++i) {
+        if (idx[i] < x->length()) set_element(res, i, x, idx[i]); else set_na(res, i);
+      }
+      return res;
+    }
+
+    static objref do_subset2(evaluator &, objref, objref args, objref) {
+      objref x = arg(args, 0);
+      if (!is_vector(x)) throw std::runtime_error("object is not subsettable");
+      std::vector<size_t> idx = indices(x, arg(args, 1));
+      if (idx.size() != 1 || idx[0] >= x->length()) throw std::runtime_error("subscript out of bounds");
+      return element(x, idx[0]);
+    }
+
+    // `[<-` and `[[<-`. the vector is copied and grows with NAs if the index is past the end.
+    static objref do_subassign(evaluator &ev, objref, objref args, objref) {
+      objref x = arg(args, 0);
+      objref value = arg(args, num_args(args) - 1);
+      objref index = num_args(args) > 2 ? arg(args, 1) : ev.missing_arg_;
+      if (x == obj::null_const()) x = obj::make_vector(value->type(), 0);
+      if (!is_vector(x) || !is_vector(value)) throw std::runtime_error("invalid subassignment");
+      if (value->length() == 0) throw std::runtime_error("replacement has length zero");
+      std::vector<size_t> idx = indices(x, index);
+      size_t n = x->length();
+      for (size_t i = 0; i != idx.size(); ++i) {
+        if (idx[i] != (size_t)-1 && idx[i] >= n) n = idx[i] + 1;
+      }
+      ot type = (unsigned)value->type() > (unsigned)x->type() ? value->type() : x->type();
+      objref res = obj::make_vector(type, n);
+      for (size_t i = 0; i != n; ++i) {
+        if (i < x->length()) set_element(res, i, x, i); else set_na(res, i);
+      }
+      for (size_t i = 0; i != idx.size(); ++i) {
+        if (idx[i] == (size_t)-1) throw std::runtime_error("NAs are not allowed in subscripted assignments");
+        set_element(res, idx[i], value, i % value->length());
+      }
+      return res;
+    }
+
+    static objref do_is_null(evaluator &, objref, objref args, objref) {
+      return obj::make_logical(arg(args, 0) == obj::null_const());
+    }
+
+    // exists("x") looks in the calling environment and those enclosing it.
+    static objref do_exists(evaluator &, objref, objref args, objref rho) {
+      objref name = arg(args, 0);
+      if (name->type() != ot::chr) throw std::runtime_error("invalid first argument");
+      size_t depth;
+      objref where;
+      return obj::make_logical(env::find(rho, obj::make_symbol(name->chr_data()), false, depth, where) != nullptr);
+    }
+
+    // rm(x, "y") removes bindings from the calling environment only.
+    static objref do_rm(evaluator &, objref, objref args, objref rho) {
+      for (objref a = args; a != obj::null_const(); a = a->tail()) {
+        objref name = a->head();
+        if (name->type() == ot::chr) name = obj::make_symbol(name->chr_data());
+        if (name->type() != ot::symbol) throw std::runtime_error("... must contain names or character strings");
+        env::remove(rho, name);
+      }
+      return obj::null_const();
+    }
+
+    static objref do_stop(evaluator &, objref, objref args, objref) {
+      objref msg = args != obj::null_const() ? args->head() : obj::null_const();
+      throw std::runtime_error(msg->type() == ot::chr ? msg->chr_data() : "error");
+    }
+
+    static const std::vector<builtin> &builtins() {
+      static const std::vector<builtin> table = {
+        { "quote", ot::special, do_quote },
+        { "if", ot::special, do_if },
+        { "for", ot::special, do_for },
+        { "while", ot::special, do_while },
+        { "repeat", ot::special, do_repeat },
+        { "break", ot::special, do_break },
+        { "next", ot::special, do_next },
+        { "function", ot::special, do_function },
+        { "return", ot::special, do_return },
+        { "<-", ot::special, do_assign },
+        { "=", ot::special, do_assign },
+        { "<<-", ot::special, do_super_assign },
+        { "{", ot::special, do_begin },
+        { "(", ot::special, do_paren },
+        { "&&", ot::special, do_and2 },
+        { "||", ot::special, do_or2 },
+        { "+", ot::builtin, do_arith<arith::op::add> },
+        { "-", ot::builtin, do_arith<arith::op::sub> },
+        { "*", ot::builtin, do_arith<arith::op::mul> },
+        { "/", ot::builtin, do_arith<arith::op::div> },
+        { "^", ot::builtin, do_arith<arith::op::pow> },
+        { "%%", ot::builtin, do_arith<arith::op::mod> },
+        { "%/%", ot::builtin, do_arith<arith::op::idiv> },
+        { "==", ot::builtin, do_arith<arith::op::eq> },
+        { "!=", ot::builtin, do_arith<arith::op::ne> },
+        { "<", ot::builtin, do_arith<arith::op::lt> },
+        { "<=", ot::builtin, do_arith<arith::op::le> },
+        { ">", ot::builtin, do_arith<arith::op::gt> },
+        { ">=", ot::builtin, do_arith<arith::op::ge> },
+        { "&", ot::builtin, do_arith<arith::op::and_> },
+        { "|", ot::builtin, do_arith<arith::op::or_> },
+        { "!", ot::builtin, do_not },
+        { ":", ot::builtin, do_colon },
+        { "c", ot::builtin, do_c },
+        { "length", ot::builtin, do_length },
+        { "sum", ot::builtin, do_sum },
+        { "is.na", ot::builtin, do_is<test::na> },
+        { "is.nan", ot::builtin, do_is<test::nan> },
+        { "is.finite", ot::builtin, do_is<test::finite> },
+        { "is.infinite", ot::builtin, do_is<test::infinite> },
+        { "all", ot::builtin, do_all_any<true> },
+        { "any", ot::builtin, do_all_any<false> },
+        { "[", ot::builtin, do_subset },
+        { "[[", ot::builtin, do_subset2 },
+        { "[<-", ot::builtin, do_subassign },
+        { "[[<-", ot::builtin, do_subassign },
+        { "is.null", ot::builtin, do_is_null },
+        { "exists", ot::builtin, do_exists },
+        { "rm", ot::special, do_rm },
+        { "stop", ot::builtin, do_stop },
+      };
+      return table;
+    }
+
+    static const size_t stack_size = 1 << 16;
+
+    heap &heap_;
+    std::vector<objref> stack_;
+    size_t sp_;
+    unsigned jit_threshold_;
+    objref base_env_;
+    objref global_env_;
+    objref missing_arg_;
+    objref dots_;
+    size_t cache_hits_;
+    size_t cache_misses_;
+  };
+}
+
+#endif
@@ -0,0 +1,256 @@
+#ifndef FUSE_HPP
+#define FUSE_HPP
+
+#include <cstring>
+#include <vector>
+
+#include "arith.hpp"
+#include "objects.hpp"
+
+namespace little_r {
+  // Fused element-wise arithmetic.
+  //
+  // A tree of + - * / ^ %% %/%, comparisons and unary minus whose leaves are symbols
+  // and constants is flattened into a postfix program: an integer >= 0 is a leaf and
+  // -1 - code an operator. The leaves are evaluated first, then the program runs one
+  // block of block_size elements at a time through the arith kernels, so the only
+  // full length vector made is the result.
+  //
+  // Recycling only gives the same answers as the unfused operators when every operand
+  // length divides the length of the operator it feeds, and short vectors are faster
+  // the ordinary way, so anything else is done an operator at a time.
+  namespace fuse {
+    const int negate_code = (int)arith::op::ge + 1;
+    const size_t block_size = 512;
+    const size_t min_length = 64;
+
+    struct program {
+      std::vector<int> code;
+      std::vector<objref> leaves;
+    };
+
+    // the operator code of a call to "name" with "n" arguments, or -1.
+    inline int op_code(const char *name, size_t n) {
+      static const char *names[] = { "+", "-", "*", "/", "^", "%%", "%/%", "==", "!=", "<", "<=", ">", ">=" };
+      if (n == 1) return std::strcmp(name, "-") == 0 ? negate_code : -1;
+      if (n != 2) return -1;
+      for (int i = 0; i != negate_code; ++i) {
+        if (std::strcmp(name, names[i]) == 0) return i;
+      }
+      return -1;
+    }
+
+    // add e to the program and return how many operators it has, or -1 if it can't be fused.
+    // is_base(call) says whether the function of a call is still the base one.
+    template <class IsBase>
+    int analyse(objref e, IsBase &is_base, program &p) {
+      if (e->type() != ot::lang) {
+        if (e->type() == ot::symbol && (e->chr_data()[0] == 0 || std::strcmp(e->chr_data(), "...") == 0)) return -1;
+        p.code.push_back((int)p.leaves.size());
+        p.leaves.push_back(e);
+        return 0;
+      }
+      objref fn = e->head();
+      if (fn->type() != ot::symbol) return -1;
+      size_t n = 0;
+      for (objref a = e->tail(); a != obj::null_const(); a = a->tail(), ++n) {
+        if (a->tag() != obj::null_const()) return -1;
+      }
+      bool paren = n == 1 && std::strcmp(fn->chr_data(), "(") == 0;
+      int code = op_code(fn->chr_data(), n);
+      if ((!paren && code < 0) || !is_base(e)) return -1;
+      int ops = paren ? 0 : 1;
+      for (objref a = e->tail(); a != obj::null_const(); a = a->tail()) {
+        int r = analyse(a->head(), is_base, p);
+        if (r < 0) return -1;
+        ops += r;
+      }
+      if (!paren) p.code.push_back(-1 - code);
+      return ops;
+    }
+
+    // the type of the unfused operator's result.
+    inline ot result_type(int code, ot x, ot y) {
+      if (code >= (int)arith::op::eq && code <= (int)arith::op::ge) return ot::logical;
+      if (code == negate_code) return x == ot::real ? ot::real : ot::integer;
+      bool real = x == ot::real || y == ot::real || code == (int)arith::op::div || code == (int)arith::op::pow;
+      return real ? ot::real : ot::integer;
+    }
+
+    // the program an operator at a time, as the evaluator would have done it.
+    inline objref run_unfused(const int *code, size_t len, const objref *leaves) {
+      objref small[32];
+      std::vector<objref> big;
+      objref *stack = small;
+      if (len > 32) {
+        big.resize(len);
+        stack = big.data();
+      }
+      size_t sp = 0;
+      for (size_t i = 0; i != len; ++i) {
+        if (code[i] >= 0) {
+          stack[sp++] = leaves[code[i]];
+        } else if (-1 - code[i] == negate_code) {
+          stack[sp - 1] = arith::negate(stack[sp - 1]);
+        } else {
+          --sp;
+          stack[sp - 1] = arith::scalar_binary((arith::op)(-1 - code[i]), stack[sp - 1], stack[sp]);
+        }
+      }
+      return stack[0];
+    }
+
+    struct node {
+      ot type;
+      size_t length;
+      int left;
+      int right;
+    };
+
+    // a block of a node's values: "count" is 1 for a length 1 operand, otherwise the block length.
+    struct view {
+      const void *data;
+      size_t count;
+    };
+
+    // elements start to start + m of a leaf, recycled into a buffer if it is shorter than the result.
+    inline view leaf_view(objref x, size_t start, size_t m, double *real_buf, int *int_buf) {
+      size_t length = x->length();
+      view v;
+      v.count = length == 1 ? 1 : m;
+      if (x->type() == ot::real) {
+        const double *data = x->data<double>();
+        if (length == 1 || start + m <= length) {
+          v.data = length == 1 ? data : data + start;
+        } else {
+          for (size_t j = 0; j != m; ++j) real_buf[j] = data[(start + j) % length];
+          v.data = real_buf;
+        }
+      } else {
+        const int *data = x->data<int>();
+        if (length == 1 || start + m <= length) {
+          v.data = length == 1 ? data : data + start;
+        } else {
+          for (size_t j = 0; j != m; ++j) int_buf[j] = data[(start + j) % length];
+          v.data = int_buf;
+        }
+      }
+      return v;
+    }
+
+    inline view as_real(ot type, view v, double *buf) {
+      if (type == ot::real) return v;
+      const int *src = (const int*)v.data;
+      for (size_t j = 0; j != v.count; ++j) buf[j] = src[j] == na_integer ? na_real() : src[j];
+      view res = { buf, v.count };
+      return res;
+    }
+
+    inline view negate(ot type, view v, double *real_buf, int *int_buf) {
+      view res;
+      res.count = v.count;
+      if (type == ot::real) {
+        const double *src = (const double*)v.data;
+        for (size_t j = 0; j != v.count; ++j) real_buf[j] = -src[j];
+        res.data = real_buf;
+      } else {
+        const int *src = (const int*)v.data;
+        for (size_t j = 0; j != v.count; ++j) int_buf[j] = src[j] == na_integer ? na_integer : -src[j];
+        res.data = int_buf;
+      }
+      return res;
+    }
+
+    inline void apply(int code, bool real, void *r, size_t count, view a, view b) {
+      arith::op o = (arith::op)code;
+      bool compare = o >= arith::op::eq && o <= arith::op::ge;
+      if (real) {
+        const double *x = (const double*)a.data, *y = (const double*)b.data;
+        if (compare) {
+          arith::kernels::compare<arith::kernels::real_compare>(o, (int*)r, count, x, a.count, y, b.count);
+        } else {
+          arith::kernels::arith<arith::kernels::real_arith>(o, (double*)r, count, x, a.count, y, b.count);
+        }
+      } else {
+        const int *x = (const int*)a.data, *y = (const int*)b.data;
+        if (compare) {
+          arith::kernels::compare<arith::kernels::int_compare>(o, (int*)r, count, x, a.count, y, b.count);
+        } else {
+          arith::kernels::arith<arith::kernels::int_arith>(o, (int*)r, count, x, a.count, y, b.count);
+        }
+      }
+    }
+
+    // the value of a program with at least one operator. the leaves must be protected.
+    inline objref run(const int *code, size_t len, const objref *leaves) {
+      size_t longest = 0;
+      for (size_t i = 0; i != len; ++i) {
+        if (code[i] < 0) continue;
+        objref x = leaves[code[i]];
+        if (!arith::is_numeric(x)) return run_unfused(code, len, leaves);
+        if (x->length() > longest) longest = x->length();
+      }
+      if (longest < min_length) return run_unfused(code, len, leaves);
+
+      std::vector<node> nodes(len);
+      std::vector<int> stack;
+      bool fusable = true;
+      for (size_t i = 0; i != len; ++i) {
+        node &nd = nodes[i];
+        nd.left = nd.right = -1;
+        if (code[i] >= 0) {
+          objref x = leaves[code[i]];
+          nd.type = x->type();
+          nd.length = x->length();
+        } else if (-1 - code[i] == negate_code) {
+          nd.left = stack.back();
+          nd.type = result_type(negate_code, nodes[nd.left].type, ot::nil);
+          nd.length = nodes[nd.left].length;
+          stack.pop_back();
+        } else {
+          nd.right = stack.back();
+          stack.pop_back();
+          nd.left = stack.back();
+          stack.pop_back();
+          const node &l = nodes[nd.left], &r = nodes[nd.right];
+          nd.type = result_type(-1 - code[i], l.type, r.type);
+          nd.length = l.length == 0 || r.length == 0 ? 0 : l.length > r.length ? l.length : r.length;
+          if (nd.length != 0 && (nd.length % l.length != 0 || nd.length % r.length != 0)) fusable = false;
+        }
+        stack.push_back((int)i);
+      }
+      size_t n = nodes.back().length;
+      if (!fusable || n < min_length) return run_unfused(code, len, leaves);
+
+      objref res = obj::make_vector(nodes.back().type, n);
+      std::vector<double> reals(len * block_size);
+      std::vector<int> ints(len * block_size);
+      std::vector<view> views(len);
+      for (size_t start = 0; start < n; start += block_size) {
+        size_t m = n - start < block_size ? n - start : block_size;
+        for (size_t i = 0; i != len; ++i) {
+          const node &nd = nodes[i];
+          double *real_buf = i + 1 == len && nd.type == ot::real ? res->data<double>() + start : &reals[i * block_size];
+          int *int_buf = i + 1 == len && nd.type != ot::real ? res->data<int>() + start : &ints[i * block_size];
+          if (code[i] >= 0) {
+            views[i] = leaf_view(leaves[code[i]], start, m, real_buf, int_buf);
+          } else if (nd.right < 0) {
+            views[i] = negate(nd.type, views[nd.left], real_buf, int_buf);
+          } else {
+            int c = -1 - code[i];
+            bool real = nodes[nd.left].type == ot::real || nodes[nd.right].type == ot::real || nd.type == ot::real;
+            view a = real ? as_real(nodes[nd.left].type, views[nd.left], &reals[nd.left * block_size]) : views[nd.left];
+            view b = real ? as_real(nodes[nd.right].type, views[nd.right], &reals[nd.right * block_size]) : views[nd.right];
+            size_t count = a.count > b.count ? a.count : b.count;
+            apply(c, real, nd.type == ot::real ? (void*)real_buf : (void*)int_buf, count, a, b);
+            views[i].data = nd.type == ot::real ? (void*)real_buf : (void*)int_buf;
+            views[i].count = count;
+          }
+        }
+      }
+      return res;
+    }
+  }
+}
+
+#endif
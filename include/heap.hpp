@@ -0,0 +1,635 @@
+#ifndef HEAP_HPP
+#define HEAP_HPP
+
+#include <cstddef>
+#include <cstdlib>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+#include "objects.hpp"
+
+namespace little_r {
+  // Region allocator and generational garbage collector for obj nodes.
+  //
+  // Small nodes are carved out of pages with a bump pointer, one set of pages per
+  // size class (sxpinfo.gccls), so that cells of the same shape sit next to each other.
+  // Anything bigger than the largest class comes from a separate variable size area
+  // that is bucketed by powers of two.
+  //
+  // Every live node is on the young or old list of its class, linked through
+  // gengc_next_node/gengc_prev_node. Collections only happen at safepoints,
+  // so C++ locals between safepoints do not need protecting. Roots are the
+  // registered pointers (the little_r instance, the parser) and the protect stack.
+  //
+  // release() still drops the whole region at once.
+  //
+  // With LITTLE_R_COMPRESSED the blocks, and the list heads, come from the node_space
+  // so that every node can be reached with a 32 bit reference.
+  class heap {
+  public:
+    static const size_t page_size = 64 * 1024;
+    static const size_t chunk_size = 1024 * 1024;
+    static const size_t alignment = 16;
+    static const unsigned num_classes = 6;
+    static const unsigned large_class = 6;
+    static const unsigned permanent_class = 7;
+    static const unsigned num_buckets = 10;
+    static const size_t min_bucket = 512;
+
+    heap() {
+      young_ = (SEXPREC*)alloc_block(sizeof(SEXPREC) * num_lists * 2);
+      old_ = young_ + num_lists;
+      for (unsigned cls = 0; cls != num_lists; ++cls) {
+        init_list(young_[cls]);
+        init_list(old_[cls]);
+      }
+      reset();
+      epoch_ = 1;
+      young_limit_ = 4 * 1024 * 1024;
+      full_limit_ = 64 * 1024 * 1024;
+    }
+
+    ~heap() {
+      release();
+      free_block((char*)young_, sizeof(SEXPREC) * num_lists * 2);
+    }
+
+    heap(const heap &) = delete;
+    heap &operator=(const heap &) = delete;
+
+    // payload bytes that fit in each size class on top of the node header.
+    static size_t class_extra(unsigned cls) {
+      static const size_t extra[num_classes] = { 0, 16, 32, 64, 128, 256 };
+      return extra[cls];
+    }
+
+    // smallest class that fits a node of "size" bytes or large_class if none do.
+    static unsigned size_class(size_t size) {
+      for (unsigned cls = 0; cls != num_classes; ++cls) {
+        if (size <= sizeof(obj) + class_extra(cls)) return cls;
+      }
+      return large_class;
+    }
+
+    // allocate a node of "size" bytes and put it on the young list.
+    void *alloc(size_t size) {
+      unsigned cls = size_class(size);
+      SEXPREC *res = cls == large_class ? alloc_large(size) : alloc_small(cls);
+      adopt(res, cls);
+      return res;
+    }
+
+    // n nodes of "size" bytes side by side in one page, skipping the free list.
+    // what is left of the current page goes on the free list if the run doesn't fit.
+    void alloc_run(size_t size, size_t n, void **nodes) {
+      unsigned cls = size_class(size);
+      size_t cell = cell_size(cls);
+      if (cls == large_class || n * cell > page_size) {
+        for (size_t i = 0; i != n; ++i) nodes[i] = alloc(size);
+        return;
+      }
+      if (size_t(end_[cls] - pos_[cls]) < n * cell) {
+        for (; size_t(end_[cls] - pos_[cls]) >= cell; pos_[cls] += cell) {
+          SEXPREC *node = (SEXPREC*)pos_[cls];
+          node->gengc_next_node = (obj*)free_[cls];
+          free_[cls] = node;
+        }
+        char *page = new_block(page_size);
+        pos_[cls] = page;
+        end_[cls] = page + page_size;
+      }
+      for (size_t i = 0; i != n; ++i) {
+        SEXPREC *res = (SEXPREC*)pos_[cls];
+        pos_[cls] += cell;
+        num_bytes_ += cell;
+        young_bytes_ += cell;
+        adopt(res, cls);
+        nodes[i] = res;
+      }
+    }
+
+    // free every node in the region at once.
+    void release() {
+      free_large_list(young_[large_class]);
+      free_large_list(old_[large_class]);
+      for (size_t i = 0; i != blocks_.size(); ++i) {
+        disown_block(blocks_[i].first, blocks_[i].second);
+      }
+      blocks_.clear();
+      for (unsigned cls = 0; cls != num_lists; ++cls) {
+        init_list(young_[cls]);
+        init_list(old_[cls]);
+      }
+      reset();
+      ++epoch_;
+    }
+
+    // pointers that are scanned on every collection.
+    void add_root(obj **root) {
+      roots_.push_back(root);
+    }
+
+    void remove_root(obj **root) {
+      roots_.erase(std::find(roots_.begin(), roots_.end(), root));
+    }
+
+    // an array whose first *size entries are scanned, such as an interpreter's stack.
+    void add_root_stack(obj **base, size_t *size) {
+      root_stacks_.push_back(std::make_pair(base, size));
+    }
+
+    void remove_root_stack(obj **base) {
+      for (size_t i = 0; i != root_stacks_.size(); ++i) {
+        if (root_stacks_[i].first == base) {
+          root_stacks_.erase(root_stacks_.begin() + i);
+          return;
+        }
+      }
+    }
+
+    // protect stack for values that are only held in C++ locals across a safepoint.
+    void protect(obj *value) { protected_.push_back(value); }
+    void unprotect(size_t n = 1) { protected_.resize(protected_.size() - n); }
+    void reprotect(size_t index, obj *value) { protected_[index] = value; }
+    size_t num_protected() const { return protected_.size(); }
+
+    // unprotects everything protected during its lifetime, also when an exception unwinds.
+    class protect_scope {
+    public:
+      protect_scope(heap &h) : heap_(h), size_(h.protected_.size()) {}
+      ~protect_scope() { heap_.protected_.resize(size_); }
+    private:
+      heap &heap_;
+      size_t size_;
+    };
+
+    // the heap whose blocks hold "node", or nullptr if it isn't in any heap.
+    // each thread keeps the last few blocks it found, which stay good until a
+    // block is given back.
+    static heap *owner(const void *node) {
+      struct cached { const char *begin; const char *end; heap *owner; size_t generation; };
+      static thread_local cached cache[4];
+      static thread_local unsigned next_slot;
+      const char *p = (const char*)node;
+      regions &r = all_regions();
+      size_t generation = r.generation.load(std::memory_order_acquire);
+      for (const cached &c : cache) {
+        if (c.generation == generation && p >= c.begin && p < c.end) return c.owner;
+      }
+      std::lock_guard<std::mutex> lock(r.mutex);
+      auto i = r.map.upper_bound(p);
+      if (i == r.map.begin()) return nullptr;
+      --i;
+      if (p >= i->second.first) return nullptr;
+      cached c = { i->first, i->second.first, i->second.second, r.generation.load(std::memory_order_relaxed) };
+      cache[next_slot++ % 4] = c;
+      return c.owner;
+    }
+
+    // called by the write barrier when an old node of this heap is made to point at
+    // a young one. the writer may be on another thread.
+    void remember(SEXPREC *node) {
+      std::lock_guard<std::mutex> lock(remembered_mutex_);
+      node->sxpinfo.spare = 1;
+      remembered_.push_back(node);
+    }
+
+    // called by the write barrier when a node of another heap is made to point at a
+    // young node of this one, which is then kept by the next collection.
+    void remember_value(obj *value) {
+      std::lock_guard<std::mutex> lock(remembered_mutex_);
+      remembered_values_.push_back(value);
+    }
+
+    // collect if enough has been allocated since the last collection.
+    // a full collection is done when the old generation has grown past its limit.
+    void safepoint() {
+      if (young_bytes_ < young_limit_) return;
+      collect(false);
+      if (num_bytes_ >= full_limit_) {
+        collect(true);
+        if (num_bytes_ >= full_limit_ / 2) {
+          full_limit_ *= 2;
+        }
+      }
+    }
+
+    // mark everything reachable from the roots and free the rest.
+    // a young collection only looks at nodes allocated since the last collection.
+    void collect(bool full) {
+      std::lock_guard<std::mutex> lock(remembered_mutex_);
+      mark_roots(full);
+      // forget the remembered nodes before the sweep, which may free some of them.
+      for (size_t i = 0; i != remembered_.size(); ++i) {
+        remembered_[i]->sxpinfo.spare = 0;
+      }
+      remembered_.clear();
+      remembered_values_.clear();
+      // the old generation first: survivors moved into it have their marks cleared.
+      for (unsigned cls = 0; cls != num_lists; ++cls) {
+        if (full) sweep(old_[cls], cls);
+        sweep(young_[cls], cls);
+      }
+      young_bytes_ = 0;
+      ++(full ? num_full_collections_ : num_young_collections_);
+      ++epoch_;
+    }
+
+    size_t num_nodes() const { return num_nodes_; }
+    size_t num_bytes() const { return num_bytes_; }
+    size_t num_blocks() const { return blocks_.size(); }
+    size_t num_allocs() const { return num_allocs_; }
+    size_t num_young_collections() const { return num_young_collections_; }
+    size_t num_full_collections() const { return num_full_collections_; }
+
+    // moves on whenever nodes may have been freed, by a collection or release(), so
+    // that addresses kept outside the heap can be checked before they are trusted.
+    size_t epoch() const { return epoch_; }
+
+    void set_limits(size_t young_limit, size_t full_limit) {
+      young_limit_ = young_limit;
+      full_limit_ = full_limit;
+    }
+
+    // the heap that obj::operator new allocates from on this thread.
+    static heap &current() {
+      heap *h = current_ptr();
+      if (h) return *h;
+      static thread_local heap fallback;
+      return fallback;
+    }
+
+    // make a heap current for the lifetime of the scope.
+    class scope {
+    public:
+      scope(heap &h) : prev_(current_ptr()) { current_ptr() = &h; }
+      ~scope() { current_ptr() = prev_; }
+    private:
+      scope(const scope &) = delete;
+      scope &operator=(const scope &) = delete;
+      heap *prev_;
+    };
+
+  private:
+    static const unsigned num_lists = num_classes + 1;
+
+    static heap *&current_ptr() {
+      static thread_local heap *ptr;
+      return ptr;
+    }
+
+    static size_t align(size_t size) {
+      return (size + alignment - 1) & ~(alignment - 1);
+    }
+
+    static size_t cell_size(unsigned cls) {
+      return align(sizeof(obj) + class_extra(cls));
+    }
+
+    // large nodes carry their size in front of the header.
+    static size_t &large_size(SEXPREC *node) {
+      return *(size_t*)((char*)node - alignment);
+    }
+
+    void adopt(SEXPREC *node, unsigned cls) {
+      node->sxpinfo = sxpinfo_struct();
+      node->sxpinfo.type = ot::news;
+      node->sxpinfo.gccls = cls;
+      link(young_[cls], node);
+      ++num_nodes_;
+      ++num_allocs_;
+    }
+
+    static unsigned bucket(size_t size) {
+      unsigned b = 0;
+      while ((min_bucket << b) < size) ++b;
+      return b;
+    }
+
+    void reset() {
+      for (unsigned cls = 0; cls != num_classes; ++cls) {
+        pos_[cls] = end_[cls] = nullptr;
+        free_[cls] = nullptr;
+      }
+      for (unsigned b = 0; b != num_buckets; ++b) {
+        free_large_[b] = nullptr;
+      }
+      chunk_pos_ = chunk_end_ = nullptr;
+      remembered_.clear();
+      remembered_values_.clear();
+      num_nodes_ = 0;
+      num_bytes_ = 0;
+      young_bytes_ = 0;
+      num_allocs_ = 0;
+      num_young_collections_ = 0;
+      num_full_collections_ = 0;
+    }
+
+    SEXPREC *alloc_small(unsigned cls) {
+      size_t cell = cell_size(cls);
+      num_bytes_ += cell;
+      young_bytes_ += cell;
+      if (free_[cls]) {
+        SEXPREC *res = free_[cls];
+        free_[cls] = (SEXPREC*)(obj*)res->gengc_next_node;
+        return res;
+      }
+      if (size_t(end_[cls] - pos_[cls]) < cell) {
+        char *page = new_block(page_size);
+        pos_[cls] = page;
+        end_[cls] = page + page_size;
+      }
+      SEXPREC *res = (SEXPREC*)pos_[cls];
+      pos_[cls] += cell;
+      return res;
+    }
+
+    // the variable size area. very large nodes get a block of their own.
+    SEXPREC *alloc_large(size_t size) {
+      size = align(size) + alignment;
+      char *mem;
+      if (size > chunk_size / 4) {
+        mem = own_block(size);
+      } else {
+        unsigned b = bucket(size);
+        size = min_bucket << b;
+        if (free_large_[b]) {
+          mem = (char*)free_large_[b] - alignment;
+          free_large_[b] = (SEXPREC*)(obj*)free_large_[b]->gengc_next_node;
+        } else {
+          if (size_t(chunk_end_ - chunk_pos_) < size) {
+            chunk_pos_ = new_block(chunk_size);
+            chunk_end_ = chunk_pos_ + chunk_size;
+          }
+          mem = chunk_pos_;
+          chunk_pos_ += size;
+        }
+      }
+      num_bytes_ += size;
+      young_bytes_ += size;
+      SEXPREC *res = (SEXPREC*)(mem + alignment);
+      large_size(res) = size;
+      return res;
+    }
+
+    void free_node(SEXPREC *node, unsigned cls) {
+      node->sxpinfo.type = ot::frees;
+      --num_nodes_;
+      if (cls != large_class) {
+        num_bytes_ -= cell_size(cls);
+        node->gengc_next_node = (obj*)free_[cls];
+        free_[cls] = node;
+      } else {
+        size_t size = large_size(node);
+        num_bytes_ -= size;
+        if (size > chunk_size / 4) {
+          disown_block((char*)node - alignment, size);
+        } else {
+          unsigned b = bucket(size);
+          node->gengc_next_node = (obj*)free_large_[b];
+          free_large_[b] = node;
+        }
+      }
+    }
+
+    void free_large_list(SEXPREC &list) {
+      for (SEXPREC *p = next(&list); p != &list; ) {
+        SEXPREC *n = next(p);
+        if (large_size(p) > chunk_size / 4) disown_block((char*)p - alignment, large_size(p));
+        p = n;
+      }
+    }
+
+    static char *alloc_block(size_t size) {
+      #if LITTLE_R_COMPRESSED
+        return node_space::alloc(size);
+      #else
+        char *block = (char*)std::malloc(size);
+        if (!block) throw std::bad_alloc();
+        return block;
+      #endif
+    }
+
+    static void free_block(char *block, size_t size) {
+      #if LITTLE_R_COMPRESSED
+        node_space::free(block, size);
+      #else
+        // only node_space needs the size back.
+        (void)size;
+        std::free(block);
+      #endif
+    }
+
+    char *new_block(size_t size) {
+      char *block = own_block(size);
+      blocks_.push_back(std::make_pair(block, size));
+      return block;
+    }
+
+    // the blocks of every heap by address, for owner(). never destroyed, as heaps
+    // in other statics may outlive it. the generation moves on when a block is
+    // given back, so that the threads' caches of it are dropped.
+    struct regions {
+      std::mutex mutex;
+      std::map<const char *, std::pair<const char *, heap *> > map;
+      std::atomic<size_t> generation{1};
+    };
+
+    static regions &all_regions() {
+      static regions *r = new regions();
+      return *r;
+    }
+
+    char *own_block(size_t size) {
+      char *block = alloc_block(size);
+      regions &r = all_regions();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      r.map[block] = std::make_pair(block + size, this);
+      return block;
+    }
+
+    void disown_block(char *block, size_t size) {
+      {
+        regions &r = all_regions();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.map.erase(block);
+        r.generation.fetch_add(1, std::memory_order_release);
+      }
+      free_block(block, size);
+    }
+
+    static SEXPREC *next(SEXPREC *node) { return (SEXPREC*)(obj*)node->gengc_next_node; }
+    static SEXPREC *prev(SEXPREC *node) { return (SEXPREC*)(obj*)node->gengc_prev_node; }
+
+    static void init_list(SEXPREC &sentinel) {
+      sentinel.gengc_next_node = sentinel.gengc_prev_node = (obj*)&sentinel;
+    }
+
+    static void link(SEXPREC &list, SEXPREC *node) {
+      node->gengc_prev_node = (obj*)&list;
+      node->gengc_next_node = list.gengc_next_node;
+      next(&list)->gengc_prev_node = (obj*)node;
+      list.gengc_next_node = (obj*)node;
+    }
+
+    static void unlink(SEXPREC *node) {
+      prev(node)->gengc_next_node = node->gengc_next_node;
+      next(node)->gengc_prev_node = node->gengc_prev_node;
+    }
+
+    void mark_roots(bool full) {
+      for (size_t i = 0; i != roots_.size(); ++i) {
+        mark(*roots_[i], full);
+      }
+      for (size_t i = 0; i != protected_.size(); ++i) {
+        mark(protected_[i], full);
+      }
+      for (size_t i = 0; i != root_stacks_.size(); ++i) {
+        for (size_t j = 0; j != *root_stacks_[i].second; ++j) {
+          mark(root_stacks_[i].first[j], full);
+        }
+      }
+      if (!full) {
+        // old nodes that point into the young generation.
+        for (size_t i = 0; i != remembered_.size(); ++i) {
+          mark_children(remembered_[i], full);
+        }
+      }
+      // nodes of this heap stored into other heaps since the last collection.
+      for (size_t i = 0; i != remembered_values_.size(); ++i) {
+        mark(remembered_values_[i], full);
+      }
+      while (!stack_.empty()) {
+        SEXPREC *node = stack_.back();
+        stack_.pop_back();
+        mark_children(node, full);
+      }
+    }
+
+    // push a node on the mark stack unless it is already marked
+    // or, in a young collection, is part of the old generation.
+    void mark(obj *value, bool full) {
+      SEXPREC *node = (SEXPREC*)value;
+      if (node == nullptr || value == obj::null_const()) return;
+      if (node->sxpinfo.gccls == permanent_class) return;
+      if (node->sxpinfo.mark) return;
+      if (!full && node->sxpinfo.gcgen) return;
+      node->sxpinfo.mark = 1;
+      stack_.push_back(node);
+    }
+
+    void mark_children(SEXPREC *node, bool full) {
+      mark(node->attrib, full);
+      switch (node->sxpinfo.type) {
+        case ot::list: case ot::lang: case ot::closure: case ot::env:
+        case ot::promise: case ot::dot: case ot::symbol: case ot::bytecode: {
+          mark(node->listsxp.carval, full);
+          mark(node->listsxp.cdrval, full);
+          mark(node->listsxp.tagval, full);
+          break;
+        }
+        case ot::vec: {
+          obj **elems = ((obj*)node)->data<obj*>();
+          for (size_t i = 0; i != node->vecsxp.length; ++i) {
+            mark(elems[i], full);
+          }
+          break;
+        }
+        default: break;
+      }
+    }
+
+    // free unmarked nodes and move the survivors to the old generation.
+    void sweep(SEXPREC &list, unsigned cls) {
+      for (SEXPREC *p = next(&list); p != &list; ) {
+        SEXPREC *n = next(p);
+        if (p->sxpinfo.mark) {
+          p->sxpinfo.mark = 0;
+          if (&list != &old_[cls]) {
+            unlink(p);
+            p->sxpinfo.gcgen = 1;
+            link(old_[cls], p);
+          }
+        } else {
+          unlink(p);
+          free_node(p, cls);
+        }
+        p = n;
+      }
+    }
+
+    SEXPREC *young_;
+    SEXPREC *old_;
+    char *pos_[num_classes];
+    char *end_[num_classes];
+    SEXPREC *free_[num_classes];
+    SEXPREC *free_large_[num_buckets];
+    char *chunk_pos_;
+    char *chunk_end_;
+    std::vector<std::pair<char *, size_t> > blocks_;
+    std::vector<obj **> roots_;
+    std::vector<obj *> protected_;
+    std::vector<std::pair<obj **, size_t *> > root_stacks_;
+    std::vector<SEXPREC *> remembered_;
+    std::vector<obj *> remembered_values_;
+    std::mutex remembered_mutex_;
+    std::vector<SEXPREC *> stack_;
+    size_t num_nodes_;
+    size_t num_bytes_;
+    size_t young_bytes_;
+    size_t young_limit_;
+    size_t full_limit_;
+    size_t num_allocs_;
+    size_t num_young_collections_;
+    size_t num_full_collections_;
+    size_t epoch_;
+  };
+
+  inline void *obj::operator new(size_t size) {
+    return heap::current().alloc(size);
+  }
+
+  inline void *obj::operator new(size_t size, size_t extra) {
+    return heap::current().alloc(size + extra);
+  }
+
+  // permanent nodes, such as symbols, count as old and are never marked or swept.
+  inline void obj::make_permanent() {
+    sxpinfo.gcgen = 1;
+    sxpinfo.gccls = heap::permanent_class;
+  }
+
+  inline void list_builder::reserve(size_t n) {
+    void *small[16];
+    std::vector<void*> big;
+    void **cells = small;
+    if (n > 16) {
+      big.resize(n);
+      cells = big.data();
+    }
+    heap::current().alloc_run(sizeof(obj), n, cells);
+    for (size_t i = 0; i != n; ++i) {
+      objref cell = ::new (cells[i]) obj(rest_);
+      if (end_) end_->set_tail(cell); else head_ = cell;
+      end_ = cell;
+    }
+  }
+
+  // write barrier: an old node that now points at a young one is remembered by
+  // the young node's heap, which need not be the current one, so that a young
+  // collection of that heap can find it. a node of another heap, such as a
+  // symbol, can't be scanned there, so the young node itself is kept instead.
+  inline void obj::barrier(objref value) {
+    if (sxpinfo.gcgen && !sxpinfo.spare && value && value != null_const() && !value->sxpinfo.gcgen) {
+      heap *h = heap::owner(value);
+      if (!h) return;
+      if (heap::owner(this) == h) h->remember(this); else h->remember_value(value);
+    }
+  }
+}
+
+#endif
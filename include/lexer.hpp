@@ -7,10 +7,17 @@
 #include <memory>
 #include <vector>
 #include <cstdint>
-#include <cwctype>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 
 #include "objects.hpp"
+#include "mapped_file.hpp"
+#include "number.hpp"
+#include "scan.hpp"
+#include "trace.hpp"
+#include "unicode.hpp"
 
 namespace little_r {
   enum class tt {
@@ -135,40 +142,210 @@ namespace little_r {
     "-",
   };
 
-  inline void indent(int delta = 0) {
-    static int depth;
-    if (delta == -1) --depth;
-    printf("%*s", depth*2, "");
-    if (delta == 1) ++depth;
-  }
+  // R's reserved words, classified with a perfect hash that is found at compile time.
+  namespace keywords {
+    // the value of a constant.
+    enum class lit {
+      none,
+      true_,
+      false_,
+      inf,
+      nan,
+      na,
+      na_integer,
+      na_real,
+      na_complex,
+      na_character,
+    };
+
+    struct keyword {
+      const char *name;
+      unsigned len;
+      tt tok;
+      lit value;
+    };
+
+    constexpr keyword table[] = {
+      { "if", 2, tt::if_, lit::none },
+      { "else", 4, tt::else_, lit::none },
+      { "repeat", 6, tt::repeat, lit::none },
+      { "while", 5, tt::while_, lit::none },
+      { "function", 8, tt::function, lit::none },
+      { "for", 3, tt::for_, lit::none },
+      { "next", 4, tt::next, lit::none },
+      { "break", 5, tt::break_, lit::none },
+      { "in", 2, tt::in, lit::none },
+      { "TRUE", 4, tt::num_const, lit::true_ },
+      { "FALSE", 5, tt::num_const, lit::false_ },
+      { "NULL", 4, tt::null_const, lit::none },
+      { "Inf", 3, tt::num_const, lit::inf },
+      { "NaN", 3, tt::num_const, lit::nan },
+      { "NA", 2, tt::num_const, lit::na },
+      { "NA_integer_", 11, tt::num_const, lit::na_integer },
+      { "NA_real_", 8, tt::num_const, lit::na_real },
+      { "NA_character_", 13, tt::str_const, lit::na_character },
+      { "NA_complex_", 11, tt::num_const, lit::na_complex },
+      { "...", 3, tt::dotdotdot, lit::none },
+    };
+
+    constexpr unsigned num_keywords = sizeof(table) / sizeof(table[0]);
+    constexpr unsigned min_len = 2;
+    constexpr unsigned max_len = 13;
+    constexpr unsigned slot_bits = 7;
+    constexpr unsigned num_slots = 1 << slot_bits;
+
+    // first, middle and last characters and the length, multiplied by the seed.
+    constexpr unsigned hash(const char *str, size_t len, unsigned seed) {
+      return ((
+        (unsigned)(unsigned char)str[0] |
+        (unsigned)(unsigned char)str[len - 1] << 8 |
+        (unsigned)(unsigned char)str[len / 2] << 16 |
+        (unsigned)len << 24
+      ) * seed & 0xffffffffu) >> (32 - slot_bits);
+    }
 
-  inline void push_debug(const char *label) {
-    indent(); puts(label);
-    indent(1); puts("{");
-  }
+    constexpr unsigned slot(unsigned i, unsigned seed) {
+      return hash(table[i].name, table[i].len, seed);
+    }
+
+    constexpr bool collides(unsigned seed, unsigned i, unsigned j) {
+      return j != num_keywords && (slot(i, seed) == slot(j, seed) || collides(seed, i, j + 1));
+    }
+
+    constexpr bool any_collide(unsigned seed, unsigned i) {
+      return i != num_keywords && (collides(seed, i, i + 1) || any_collide(seed, i + 1));
+    }
+
+    constexpr unsigned find_seed(unsigned seed) {
+      return any_collide(seed, 0) ? find_seed(seed + 2) : seed;
+    }
+
+    constexpr unsigned seed = find_seed(1);
 
-  inline void pop_debug() {
-    indent(-1); puts("}");
+    // keyword in a slot or -1.
+    constexpr int keyword_at(unsigned s, unsigned i) {
+      return i == num_keywords ? -1 : slot(i, seed) == s ? (int)i : keyword_at(s, i + 1);
+    }
+
+    template <unsigned... I> struct seq {};
+    template <unsigned N, unsigned... I> struct make_seq : make_seq<N - 1, N - 1, I...> {};
+    template <unsigned... I> struct make_seq<0, I...> { typedef seq<I...> type; };
+
+    template <class S> struct slots;
+    template <unsigned... I> struct slots<seq<I...> > {
+      static constexpr signed char value[] = { (signed char)keyword_at(I, 0)... };
+    };
+    template <unsigned... I> constexpr signed char slots<seq<I...> >::value[];
+
+    typedef slots<make_seq<num_slots>::type> slot_table;
+
+    // one hash and one compare.
+    inline const keyword *find(const char *str, size_t len) {
+      if (len < min_len || len > max_len) return nullptr;
+      int k = slot_table::value[hash(str, len, seed)];
+      if (k < 0) return nullptr;
+      const keyword &kw = table[k];
+      return kw.len == len && !memcmp(kw.name, str, len) ? &kw : nullptr;
+    }
   }
 
+  // where the value of a token comes from.
+  enum class literal_kind : unsigned char {
+    symbol,
+    number,
+    string,
+    constant,
+    exception,
+  };
+
+  // the value of a token in a token_chunk. symbols are permanent so they are kept as they
+  // are; other values are made when the token is read back. strings and the messages of
+  // errors the lexer threw are slices of the chunk's strings.
+  struct token_literal {
+    literal_kind kind;
+    char suffix;
+    keywords::lit constant;
+    union {
+      obj *symbol;
+      double number;
+      struct {
+        uint32_t offset;
+        uint32_t length;
+      } str;
+    };
+  };
+
+  // A run of tokens, a field to an array.
+  //
+  // values[i] is 0 or one more than the index of the token's literal. strings holds the
+  // decoded bodies of string literals and the messages of errors. tokens before begin
+  // are not part of the stream.
+  struct token_chunk {
+    static const size_t capacity = 4096;
+
+    size_t begin = 0;
+    size_t size = 0;
+    uint8_t kinds[capacity];
+    uint32_t offsets[capacity];
+    uint32_t lengths[capacity];
+    uint32_t values[capacity];
+    std::vector<token_literal> literals;
+    std::string strings;
+
+    tt kind(size_t i) const { return (tt)kinds[i]; }
+  };
+
+  // chunks of tokens in order. the last one ends with end_of_input.
+  class token_source {
+  public:
+    virtual ~token_source() {}
+    virtual const token_chunk *chunk(size_t i) = 0;
+  };
+
   class lexer {
   public:
-    lexer(std::wistream &istr) : istr(istr) {
-      id_.reserve(2048);
-      eof_chr = std::char_traits<wchar_t>::eof();
-      chr = istr.get();
-      value_ = nullptr;
+    // lex a caller-owned buffer in place. tokens are (offset, length) slices of it.
+    lexer(const char *src, size_t size) : heap_(heap::current()) {
+      init(src, size);
+    }
+
+    // read back tokens that were lexed from src into a token_source.
+    lexer(const char *src, size_t size, token_source &tokens) : heap_(heap::current()) {
+      init(src, size);
+      source_ = &tokens;
+      chunk_ = tokens.chunk(0);
+      index_ = chunk_->begin;
     }
 
+    lexer(const mapped_file &file) : heap_(heap::current()) {
+      init(file.data(), file.size());
+    }
+
+    // the stream is read into a buffer owned by the lexer. its bytes are taken as UTF-8.
+    lexer(std::istream &istr) :
+      heap_(heap::current()),
+      text_(std::istreambuf_iterator<char>(istr), std::istreambuf_iterator<char>())
+    {
+      init(text_.data(), text_.size());
+    }
+
+    ~lexer() {
+      heap_.remove_root(&value_);
+    }
+
+    lexer(const lexer &) = delete;
+    lexer &operator=(const lexer &) = delete;
+
     tt next() {
+      if (source_) return replay();
+
       skip_whitespace();
 
       if (chr == '#') {
-        id_.resize(0);
         skip_comment();
       }
 
-      id_.resize(0);
+      tok_begin_ = pos_;
 
       switch (chr) {
         case '>': consume(); tok_ = next_is('=') ? tt::ge : tt::gt; break;
@@ -195,12 +372,19 @@ namespace little_r {
         case '\n': consume(); tok_ = tt::newline; break;
 
         case '\'': case '"':  tok_ = parse_string(); break;
-        case '`': parse_string(); tok_ = tt::symbol; break;
+        case '`': {
+          tok_ = parse_string();
+          if (tok_ == tt::str_const) {
+            literal_ = literal_kind::symbol;
+            value_ = obj::make_symbol(str_);
+            tok_ = tt::symbol;
+          }
+          break;
+        }
         case '%': tok_ = parse_special(); break;
 
         case '.': {
-          consume();
-          tok_ = is_digit(chr) ? parse_numeric_value() : parse_symbol();
+          tok_ = pos_ + 1 != end_ && is_digit(pos_[1]) ? parse_numeric_value() : parse_symbol();
           break;
         }
 
@@ -238,22 +422,174 @@ namespace little_r {
         default: {
           tok_ =
             is_digit(chr) ? parse_numeric_value() :
-            std::iswalpha(chr) ? parse_symbol() :
+            is_alpha() ? parse_symbol() :
             chr == eof_chr ? tt::end_of_input :
             tt::error
           ;
+          if (tok_ == tt::error && chr != eof_chr) {
+            unsigned len = 1;
+            if (chr >= 0x80) utf8_class(len);
+            advance_to(pos_ + (len ? len : 1));
+          }
           break;
         }
       }
-      indent(); std::cout << "[" << id_ << "]\n";
+      trace_.token((int)tok_, offset(), length());
+      ++num_tokens_;
       return tok_;
     }
 
     tt tok() const { return tok_; }
-    std::string id() const { return id_; }
     obj *value() const { return value_; }
 
+    // the current token as a slice of the source.
+    const char *source() const { return src_; }
+    const char *text() const { return tok_begin_; }
+    size_t offset() const { return size_t(tok_begin_ - src_); }
+    size_t length() const { return size_t(pos_ - tok_begin_); }
+    std::string id() const { return std::string(tok_begin_, pos_); }
+
+    size_t num_tokens() const { return num_tokens_; }
+
+    // the whole source has been read.
+    bool at_end() const { return pos_ == end_; }
+
+    // a lexer position for looking ahead and backing up.
+    struct state {
+      const char *pos;
+      const char *tok_begin;
+      tt tok;
+      obj *value;
+      size_t token;
+    };
+
+    state save() const {
+      state s = { pos_, tok_begin_, tok_, value_, chunk_no_ * token_chunk::capacity + index_ };
+      return s;
+    }
+
+    void restore(const state &s) {
+      tok_begin_ = s.tok_begin;
+      tok_ = s.tok;
+      value_ = s.value;
+      advance_to(s.pos);
+      if (source_) {
+        chunk_no_ = s.token / token_chunk::capacity;
+        index_ = s.token % token_chunk::capacity;
+        chunk_ = source_->chunk(chunk_no_);
+      }
+    }
+
+    // lex up to a chunk of tokens. only symbols, which are shared by every heap, are made,
+    // so this can run on a thread of its own. returns false once end_of_input is in the chunk.
+    bool lex_chunk(token_chunk &c) {
+      c.size = c.begin = 0;
+      c.literals.clear();
+      c.strings.clear();
+      while (c.size != token_chunk::capacity) {
+        if (lex_token(c) == tt::end_of_input) return false;
+      }
+      return true;
+    }
+
+    // add one token to a chunk that has room for it, as lex_chunk does.
+    tt lex_token(token_chunk &c) {
+      values_off guard(make_values_);
+      size_t i = c.size++;
+      c.values[i] = 0;
+      try {
+        next();
+      } catch (std::runtime_error &e) {
+        token_literal lit = token_literal();
+        lit.kind = literal_kind::exception;
+        lit.str.offset = (uint32_t)c.strings.size();
+        lit.str.length = (uint32_t)std::strlen(e.what());
+        c.strings.append(e.what(), lit.str.length);
+        c.literals.push_back(lit);
+        c.kinds[i] = (uint8_t)tt::error;
+        c.offsets[i] = (uint32_t)offset();
+        c.lengths[i] = (uint32_t)length();
+        c.values[i] = (uint32_t)c.literals.size();
+        return tt::error;
+      }
+      c.kinds[i] = (uint8_t)tok_;
+      c.offsets[i] = (uint32_t)offset();
+      c.lengths[i] = (uint32_t)length();
+      if (tok_ == tt::num_const || tok_ == tt::str_const || tok_ == tt::null_const || tok_ == tt::symbol) {
+        token_literal lit = token_literal();
+        lit.kind = literal_;
+        switch (literal_) {
+          case literal_kind::symbol: lit.symbol = value_; break;
+          case literal_kind::number: lit.number = number_.value; lit.suffix = number_.suffix; break;
+          case literal_kind::constant: lit.constant = constant_; break;
+          default: {
+            lit.str.offset = (uint32_t)c.strings.size();
+            lit.str.length = (uint32_t)str_.size();
+            c.strings += str_;
+            break;
+          }
+        }
+        c.literals.push_back(lit);
+        c.values[i] = (uint32_t)c.literals.size();
+      }
+      return tok_;
+    }
+
+    // carry on lexing from a position where a token could start.
+    void seek(size_t offset) {
+      state s = { src_ + offset, src_ + offset, tt::undefined, nullptr, 0 };
+      restore(s);
+    }
+
+    // send trace events to a sink, or stop tracing with nullptr.
+    void set_trace(trace_sink *sink) { trace_.set_sink(sink); }
+
+  protected:
+    heap &heap_;
+    tracer trace_;
+
   private:
+    void init(const char *src, size_t size) {
+      src_ = pos_ = tok_begin_ = src;
+      end_ = src + size;
+      eof_chr = -1;
+      chr = pos_ != end_ ? (unsigned char)*pos_ : eof_chr;
+      tok_ = tt::undefined;
+      num_tokens_ = 0;
+      value_ = nullptr;
+      heap_.add_root(&value_);
+    }
+
+    // the next token from the token_source. the lexer's state is set as if it had lexed it,
+    // including throwing the same error.
+    tt replay() {
+      if (index_ == chunk_->size) {
+        if (chunk_->kind(index_ - 1) == tt::end_of_input) {
+          --index_;
+        } else {
+          chunk_ = source_->chunk(++chunk_no_);
+          index_ = chunk_->begin;
+        }
+      }
+      size_t i = index_++;
+      tok_begin_ = src_ + chunk_->offsets[i];
+      pos_ = tok_begin_ + chunk_->lengths[i];
+      if (uint32_t v = chunk_->values[i]) {
+        const token_literal &lit = chunk_->literals[v - 1];
+        switch (lit.kind) {
+          case literal_kind::symbol: value_ = lit.symbol; break;
+          case literal_kind::number: value_ = number_value(lit.number, lit.suffix); break;
+          case literal_kind::constant: value_ = constant_value(lit.constant); break;
+          case literal_kind::string: value_ = obj::make_string(chunk_->strings.data() + lit.str.offset, lit.str.length); break;
+          case literal_kind::exception: throw std::runtime_error(chunk_->strings.substr(lit.str.offset, lit.str.length));
+        }
+      }
+      tok_ = chunk_->kind(i);
+      trace_.token((int)tok_, offset(), length());
+      ++num_tokens_;
+      return tok_;
+    }
+
     static bool is_digit(int c) {
       return c >= '0' && c <= '9';
     }
@@ -262,13 +598,29 @@ namespace little_r {
       return (c >= '0' && c <= '9') || ((c&~32) >= 'A' && (c&~32) <= 'F');
     }
 
+    // the current character can start a name. only non-ASCII characters are decoded.
+    bool is_alpha() const {
+      if (chr < 0x80) return (chr | 32) >= 'a' && (chr | 32) <= 'z';
+      unsigned len;
+      return utf8_class(len) == unicode::alpha;
+    }
+
+    // the class of the character at pos_ and its length, which is 0 if it is not UTF-8.
+    unicode::ident_class utf8_class(unsigned &len) const {
+      unsigned cp;
+      len = unicode::decode(pos_, end_, cp);
+      return len ? unicode::classify(cp) : unicode::none;
+    }
+
     void consume() {
-      id_.push_back(chr);
-      chr = istr.get();
+      if (pos_ != end_) ++pos_;
+      chr = pos_ != end_ ? (unsigned char)*pos_ : eof_chr;
     }
 
-    void skip() {
-      chr = istr.get();
+    // jump to the end of a run found by one of the scan kernels.
+    void advance_to(const char *pos) {
+      pos_ = pos;
+      chr = pos_ != end_ ? (unsigned char)*pos_ : eof_chr;
     }
 
     bool next_is(int c) {
@@ -279,84 +631,70 @@ namespace little_r {
       return false;
     }
 
+    // the newline that ends a comment is left for the next token.
     void skip_comment() {
-      while (chr == '#') {
-        do {
-          consume();
-        } while(chr != eof_chr && chr != '\n');
-        if (chr != eof_chr) {
-          consume();
-        }
-      }
+      advance_to(scan::line_end(pos_, end_));
     }
 
+    // ASCII runs are scanned in blocks, other letters one at a time.
     tt parse_symbol() {
-      while (iswalnum(chr) || chr == '.' || chr == '_') {
-        consume();
+      for (;;) {
+        advance_to(scan::ident_end(pos_, end_));
+        unsigned len;
+        if (chr < 0x80 || utf8_class(len) == unicode::none) break;
+        advance_to(pos_ + len);
       }
-      switch (id()[0]) {
-        case '.': if (is_sym("...")) return tt::dotdotdot; else break;
-        case 'b': if (is_sym("break")) return tt::break_; else break;
-        case 'e': if (is_sym("else")) return tt::else_; else break;
-        case 'F': if (is_sym("FALSE")) return tt::num_const; else break;
-        case 'f': if (is_sym("for")) return tt::for_; else if (is_sym("function")) return tt::function; else break;
-        case 'i': if (is_sym("if")) return tt::if_; else if (is_sym("in")) return tt::in; else break;
-        case 'I': if (is_sym("Inf")) return value_ = obj::null_const(), tt::num_const; else break;
-        case 'N':
-          if (is_sym("NA")) return value_ = obj::null_const(), tt::num_const;
-          if (is_sym("NA_complex_")) return value_ = obj::null_const(), tt::num_const;
-          if (is_sym("NA_integer_")) return value_ = obj::null_const(), tt::num_const;
-          if (is_sym("NA_real_")) return value_ = obj::null_const(), tt::num_const;
-          if (is_sym("Nan")) return value_ = obj::null_const(), tt::num_const;
-          if (is_sym("NULL")) return value_ = obj::null_const(), tt::null_const;
-          else break;
-        case 'n': if (is_sym("next")) return tt::next; else break;
-        case 'r': if (is_sym("repeat")) return tt::repeat; else break;
-        case 'T': if (is_sym("TRUE")) return tt::num_const; else break;
-        case 'w': if (is_sym("while")) return tt::while_; else break;
+      if (const keywords::keyword *kw = keywords::find(tok_begin_, length())) {
+        if (kw->tok == tt::num_const || kw->tok == tt::str_const || kw->tok == tt::null_const) {
+          literal_ = literal_kind::constant;
+          constant_ = kw->value;
+          if (make_values_) value_ = constant_value(kw->value);
+        }
+        return kw->tok;
       }
-      value_ = obj::make_symbol(id());
+      literal_ = literal_kind::symbol;
+      value_ = obj::make_symbol(tok_begin_, length());
       return tt::symbol;
     }
 
-    bool is_sym(const char *sym) {
-      return !std::strcmp(id_.c_str(), sym);
-    }
-
+    // the literal is scanned and converted in one pass.
+    // L makes an integer if the value is a whole number that fits, i makes it imaginary.
     tt parse_numeric_value() {
-      bool expect_dot = true;
-      int exp_code = 'E';
-      int max_code = '9';
-      if (chr == '0') {
-        consume();
-        if (chr == 'x' || chr == 'X') {
-          consume();
-          exp_code = 'P';
-          max_code = 'f';
-        }
-      }
-
-      while ((chr <= max_code && is_hex_digit(chr)) || (chr == '.' && expect_dot)) {
-        expect_dot = chr != '.';
-        consume();
-      }
+      number::literal lit;
+      const char *end = number::parse(pos_, end_, lit);
+      if (!end) return tt::error;
+      advance_to(end);
+      literal_ = literal_kind::number;
+      number_ = lit;
+      if (make_values_) value_ = number_value(lit.value, lit.suffix);
+      return tt::num_const;
+    }
 
-      if ((chr & ~32) == exp_code) {
-        consume();
-        if (chr == '+' || chr == '-') consume();
-        if (!is_digit(chr)) return tt::error;
-        do {
-          consume();
-        } while (is_digit(chr));
-      } else if (exp_code == 'p' && !expect_dot) {
-        // can't have 0x1p8
-        return tt::error;
+    static obj *number_value(double value, char suffix) {
+      if (suffix == 'i') {
+        return obj::make_complex(0, value);
+      } else if (suffix == 'L' && value > INT_MIN && value <= INT_MAX && value == (int)value) {
+        return obj::make_integer((int)value);
+      } else {
+        return obj::make_real(value);
       }
+    }
 
-      if (next_is('L')) {
+    // R makes NaN and Inf by dividing by zero at run time, so do the same to get the same bits.
+    static obj *constant_value(keywords::lit value) {
+      volatile double zero = 0;
+      switch (value) {
+        case keywords::lit::true_: return obj::make_logical(1);
+        case keywords::lit::false_: return obj::make_logical(0);
+        case keywords::lit::inf: return obj::make_real(1 / zero);
+        case keywords::lit::nan: return obj::make_real(0 / zero);
+        case keywords::lit::na: return obj::make_logical(na_logical);
+        case keywords::lit::na_integer: return obj::make_integer(na_integer);
+        case keywords::lit::na_real: return obj::make_real(na_real());
+        case keywords::lit::na_complex: return obj::make_complex(na_real(), na_real());
+        case keywords::lit::na_character: return obj::na_string();
+        default: return obj::null_const();
       }
-
-      return tt::num_const;
     }
 
     tt parse_special() {
@@ -369,29 +707,40 @@ namespace little_r {
       return tt::special;
     }
 
+    // the body of a string or backquoted name is decoded into str_.
     tt parse_string() {
-      int terminator = chr == '"' ? '"' : '\'';
-      skip();
+      int terminator = chr;
+      str_.resize(0);
+      consume();
       while (chr != terminator && chr != eof_chr) {
-        if (chr == '\\') {
-          skip();
-          if (chr == '0') {
-            skip();
+        const char *stop = scan::string_stop(pos_, end_, (char)terminator);
+        if (stop != pos_) {
+          str_.append(pos_, stop);
+          advance_to(stop);
+        } else if (chr == '\\') {
+          consume();
+          if (chr >= '0' && chr <= '7') {
+            unsigned value = 0;
             for (int i = 0; i != 3 && chr >= '0' && chr <= '7'; ++i) {
-              skip();
-            }
-            if (chr >= '0' && chr <= '7') {
-              skip();
-              if (chr >= '0' && chr <= '7') {
-                skip();
-              }
+              value = value * 8 + (chr - '0');
+              consume();
             }
+            str_.push_back((char)value);
           } else if (chr == 'x' || chr == 'u' || chr == 'U') {
             int num_digits = chr == 'x' ? 2 : chr == 'u' ? 4 : 8;
-            skip();
-            for (int i = 0; i != num_digits; ++i) {
-              if (!is_hex_digit(chr)) return tt::error;
-              skip();
+            consume();
+            bool braces = num_digits != 2 && next_is('{');
+            unsigned value = 0;
+            int i = 0;
+            for (; i != num_digits && is_hex_digit(chr); ++i) {
+              value = value * 16 + (chr <= '9' ? chr - '0' : (chr & ~32) - 'A' + 10);
+              consume();
+            }
+            if (i == 0 || (braces && !next_is('}'))) return tt::error;
+            if (num_digits == 2) {
+              str_.push_back((char)value);
+            } else {
+              unicode::append_utf8(str_, value);
             }
           } else {
             switch (chr) {
@@ -412,29 +761,52 @@ namespace little_r {
                 throw std::runtime_error("invalid escape char");
               }
             }
-            skip();
+            str_.push_back((char)chr);
+            consume();
           }
-        } else {
-           skip();
         }
       }
-      next_is(terminator);
+      if (!next_is(terminator)) return tt::error;
+      literal_ = literal_kind::string;
+      if (make_values_) value_ = obj::make_string(str_);
       return tt::str_const;
     }
 
     void skip_whitespace() {
-      id_.resize(0);
-      while (chr == ' ' || chr == '\t' || chr == '\f') {
-        consume();
-      }
+      advance_to(scan::space_end(pos_, end_));
     }
 
-    std::wistream &istr;
+    std::string text_;
+    const char *src_;
+    const char *pos_;
+    const char *end_;
+    const char *tok_begin_;
     tt tok_;
-    std::string id_;
+    size_t num_tokens_;
+    std::string str_;
     int chr;
     int eof_chr;
     obj *value_;
+
+    // chunks hold literals rather than values, so lex_token turns values off while it runs.
+    struct values_off {
+      values_off(bool &flag) : flag(flag), saved(flag) { flag = false; }
+      ~values_off() { flag = saved; }
+      bool &flag;
+      bool saved;
+    };
+
+    // what lex_chunk needs to record a value without making it.
+    bool make_values_ = true;
+    literal_kind literal_ = literal_kind::symbol;
+    keywords::lit constant_ = keywords::lit::none;
+    number::literal number_ = number::literal();
+
+    // reading back from a token_source.
+    token_source *source_ = nullptr;
+    const token_chunk *chunk_ = nullptr;
+    size_t chunk_no_ = 0;
+    size_t index_ = 0;
   };
 }
 
@@ -1,5 +1,10 @@
 
 #include "parser.hpp"
+#include "ast_cache.hpp"
+#include "eval.hpp"
+#include "parallel_lexer.hpp"
+#include "parse_pool.hpp"
+#include "token_buffer.hpp"
 
 #include <sstream>
 
@@ -9,9 +14,14 @@ namespace little_r {
     little_r() {
     }
 
+    // nodes created by this instance. collected at safepoints or dropped in bulk by release().
+    heap &get_heap() { return heap_; }
+
     bool unit_test() {
+      heap::scope scope(heap_);
+
       if (false) {
-        std::wfstream istr("../test/R-tests/arith.R");
+        std::ifstream istr("../test/R-tests/arith.R");
         lexer lex(istr);
         do {
           lex.next();
@@ -24,17 +34,709 @@ namespace little_r {
       }
 
       if (false) {
-        std::wfstream istr("../test/R-tests/arith.R");
+        std::ifstream istr("../test/R-tests/arith.R");
         parser p(istr);
       }
 
       if (true) {
-        std::wistringstream istr(L"1 + b");
+        std::istringstream istr("1 + b");
         parser p(istr);
+        if (heap_.num_nodes() == 0) return false;
+        if (p.exprs()->head()->type() != ot::lang) return false;
+      }
+
+      if (true) {
+        // with LITTLE_R_COMPRESSED the references in a node are 32 bits and a cons cell is half the size.
+        if (LITTLE_R_COMPRESSED && sizeof(obj) != 32) return false;
+        objref x = obj::make_symbol("x");
+        objref p = obj::make_promise(new obj(ot::lang, x, obj::make_list(ot::list, x)), obj::null_const());
+        if (p->prom_value() != nullptr || p->prom_env() != obj::null_const()) return false;
+        if (p->prom_expr()->head() != x || p->prom_expr()->tail()->tail() != obj::null_const()) return false;
+      }
+
+      if (true) {
+        // lists are built at the tail, in reserved cells first. long calls parse in linear time.
+        objref x = obj::make_symbol("x");
+        auto count = [](objref l) { size_t n = 0; for (; l != obj::null_const(); l = l->tail()) ++n; return n; };
+        for (size_t n : { 0, 10, 20000 }) {
+          list_builder b(ot::lang);
+          b.reserve(n);
+          for (size_t i = 0; i != 10000; ++i) b.push_back(x, i % 3 ? obj::null_const() : x);
+          objref l = b.result();
+          if (l->type() != ot::lang || l->tail()->type() != ot::list || count(l) != 10000) return false;
+          if (l->tag() != x || l->tail()->tag() != obj::null_const() || l->last()->tail() != obj::null_const()) return false;
+        }
+        objref l = obj::make_list(ot::list, x);
+        l->append(obj::make_list(ot::list, x));
+        l->append(obj::make_list(ot::list, x));
+        if (count(l) != 3 || l->last() != l->tail()->tail()) return false;
+
+        std::string src = "c(0";
+        for (int i = 1; i != 10000; ++i) src += "," + std::to_string(i);
+        src += ")";
+        parser p(src.data(), src.size());
+        if (p.num_errors() != 0 || count(p.exprs()->head()) != 10001) return false;
+      }
+
+      if (true) {
+        // literals are length 1 vectors and decimals are correctly rounded.
+        const char src[] = "0.1 2L 1e3L 1.5L 0x1.8p1 .5e-3 3i TRUE NA NA_real_ Inf 4.9e-324 1.7976931348623157e308 0x10L";
+        lexer lex(src, sizeof(src) - 1);
+        std::ostringstream os;
+        while (lex.next() == tt::num_const) {
+          os << *lex.value() << ",";
+        }
+        if (lex.tok() != tt::end_of_input) return false;
+        if (os.str() != "0.1,2L,1000L,1.5,3,0.0005,0+3i,TRUE,NA,NA,Inf,4.94066e-324,1.79769e+308,16L,") return false;
+
+        // NA_character_ is one string, printed without quotes, and not the same as "NA".
+        lexer na("NA_character_ 'NA'", 18);
+        if (na.next() != tt::str_const || na.value() != obj::na_string()) return false;
+        if (na.next() != tt::str_const || na.value() == obj::na_string()) return false;
+        for (unsigned jit = 0; jit != 3; ++jit) {
+          const char src[] = "f <- function() { x <- NA_character_; x }\nf()\nf()\nf()";
+          parser p(src, sizeof(src) - 1);
+          evaluator ev;
+          ev.set_jit_threshold(jit);
+          if (ev.eval_program(p.exprs()) != obj::na_string()) return false;
+        }
+        std::ostringstream nas;
+        nas << *obj::na_string() << " " << *obj::make_string("NA");
+        if (nas.str() != "NA \"NA\"") return false;
+
+        const char *decimals[] = { "0.1", "2.2250738585072011e-308", "9007199254740993", "1e23", "123456789012345678901234567890" };
+        for (const char *str : decimals) {
+          lexer lex(str, strlen(str));
+          if (lex.next() != tt::num_const || lex.value()->type() != ot::real) return false;
+          if (lex.value()->data<double>()[0] != strtod(str, nullptr)) return false;
+        }
+      }
+
+      if (true) {
+        // vectors grow into their spare capacity and big ones are aligned for SIMD.
+        obj *v = obj::make_vector(ot::real, 0);
+        size_t moves = 0;
+        for (int i = 0; i != 1000; ++i) {
+          obj *w = v->push_back((double)i);
+          moves += w != v;
+          v = w;
+        }
+        if (v->length() != 1000 || v->truelength() < 1000 || moves > 11) return false;
+        if ((uintptr_t)v->data<double>() % obj::vector_align != 0) return false;
+        for (int i = 0; i != 1000; ++i) {
+          if (v->data<double>()[i] != i) return false;
+        }
+        obj *r = obj::make_vector(ot::raw, 2);
+        r->data<rbyte>()[0] = 0x1f;
+        r->data<rbyte>()[1] = 0xa0;
+        std::ostringstream os;
+        os << *r << " " << *obj::make_complex(1, -2);
+        if (os.str() != "1f a0 1-2i") return false;
+        // data<T>() checks the element type, not just its size.
+        if (!elem_of<int>::type(ot::logical) || !elem_of<obj*>::type(ot::vec) || !elem_of<rbyte>::type(ot::raw)) return false;
+        if (elem_of<double>::type(ot::vec) || elem_of<int>::type(ot::raw) || elem_of<float>::type(ot::integer)) return false;
+
+        // type names are indexed by ot.
+        std::ostringstream names;
+        names << object_names[(int)obj::make_vector(ot::vec, 1)->type()] << " " << object_names[(int)obj::make_vector(ot::expr, 1)->type()];
+        if (names.str() != "list expression") return false;
+      }
+
+      if (true) {
+        // calls, subscripts and keywords build R shaped trees.
+        const char src[] = "f(x, y = z)[[i]]$a\nif (a) b else -c\nfunction(x, ...) x ** k -> y\n(";
+        parser p(src, sizeof(src) - 1);
+        std::ostringstream os;
+        os << *p.exprs();
+        if (os.str() != "[[L `$', [L `[[', [L `f', `x', `z'+`y'], `i'], `a'], [L `if', `a', `b', [L `-', `c']], "
+          "[L `function', [`'(t=`x'), `'(t=`...')], [L `<-', `y', [L `^', `x', `k']], NULL]]") return false;
+        if (p.num_errors() != 1) return false;
+      }
+
+      if (true) {
+        // the parser keeps its own stack, so nesting is not limited by the C++ one.
+        const size_t depth = 100000;
+        const char *shapes[][2] = { { "-", "" }, { "a <- ", "" }, { "f(", ")" }, { "{", "}" }, { "x[[", "]]" } };
+        for (auto &shape : shapes) {
+          std::string src;
+          for (size_t i = 0; i != depth; ++i) src += shape[0];
+          src += "1";
+          for (size_t i = 0; i != depth; ++i) src += shape[1];
+          src += "\n(1 +\n2";
+          parser p(src.data(), src.size());
+          if (p.num_errors() != 1 || p.exprs()->tail() != obj::null_const()) return false;
+          size_t n = 0;
+          objref e = p.exprs()->head();
+          for (; e->type() == ot::lang; ++n) {
+            e = e->tail()->tail() != obj::null_const() ? e->last()->head() : e->tail()->head();
+          }
+          if (n != depth || e->type() != ot::real) return false;
+        }
+      }
+
+      if (LITTLE_R_TRACE) {
+        // parser trace events go to a ring buffer that is dumped after the parse.
+        trace_ring ring;
+        const char src[] = "a + b * c";
+        parser p(src, sizeof(src) - 1, &ring);
+        trace_event ev;
+        int depth = 0, tokens = 0;
+        while (ring.pop(ev)) {
+          if (ev.kind == te::enter) ++depth;
+          if (ev.kind == te::leave) --depth;
+          if (ev.kind == te::token) ++tokens;
+          if (depth < 0) return false;
+        }
+        if (depth != 0 || tokens != 6) return false;
+
+        parser p2(src, sizeof(src) - 1, &ring);
+        std::ostringstream os;
+        ring.dump(os, src, tok_to_str);
+        if (os.str().find("[*]") == std::string::npos || ring.size() != 0) return false;
+      }
+
+      if (true) {
+        // chunks split anywhere give the same expressions as one parse, each as soon as its line ends.
+        const char src[] =
+          "f <- function(x, y) {\n"
+          "  # a quote ' and a brace {\n"
+          "  s <- \"two\nlines\"\n"
+          "  x + y\n"
+          "}\n"
+          "x <-\n"
+          "  1\n"
+          "y <- c(1,\n"
+          "  2) # (\n"
+          "`odd name` <- 'it\\'s'\n"
+          "z <- )\n"
+          "w <- x; v <- y\n"
+        ;
+        size_t size = sizeof(src) - 1;
+        parser p(src, size);
+        std::ostringstream expected;
+        for (objref e = p.exprs(); e != obj::null_const(); e = e->tail()) {
+          expected << *e->head() << ";";
+        }
+        for (size_t chunk : { (size_t)1, (size_t)7, size }) {
+          stream_parser sp;
+          std::ostringstream os;
+          for (size_t i = 0; i < size; i += chunk) {
+            sp.feed(src + i, i + chunk < size ? chunk : size - i);
+            while (obj *e = sp.pop()) os << *e << ";";
+          }
+          if (os.str() != expected.str() || sp.buffered() != 0) return false;
+          if (sp.num_errors() != 1 || p.num_errors() != 1) return false;
+          sp.finish();
+          if (sp.pop() != nullptr) return false;
+        }
+        stream_parser sp;
+        sp.feed("a <-\n", 5);
+        if (sp.pop() != nullptr || sp.buffered() != 5) return false;
+        sp.feed("2; b", 4);
+        if (sp.pop() != nullptr) return false;
+        sp.finish();
+        std::ostringstream os;
+        while (obj *e = sp.pop()) os << *e << ";";
+        if (os.str() != "[L `<-', `a', 2];`b';" || sp.num_errors() != 0) return false;
+      }
+
+      if (true) {
+        // tokens lexed into a token_buffer, here or on another thread, parse the same as the lexer's.
+        std::string src;
+        for (int i = 0; i != 1000; ++i) {
+          src += "{ if (x) `a b`[[" + std::to_string(i) + "L]]\n\n else f(y = 'q\\t', NA_character_, 1e3i) }\n";
+          if (i % 300 == 0) src += "z <- )\n";
+        }
+        src += "s <- 'bad \\q'\n";
+        parser p(src.data(), src.size());
+        std::ostringstream expected;
+        for (objref e = p.exprs(); e != obj::null_const(); e = e->tail()) {
+          expected << *e->head() << ";";
+        }
+        for (bool threaded : { false, true }) {
+          token_buffer tokens(src.data(), src.size(), threaded);
+          if (tokens.threaded() != threaded) return false;
+          parser q(src.data(), src.size(), tokens);
+          std::ostringstream os;
+          for (objref e = q.exprs(); e != obj::null_const(); e = e->tail()) {
+            os << *e->head() << ";";
+          }
+          if (os.str() != expected.str() || q.num_errors() != p.num_errors() || q.num_tokens() != p.num_tokens()) return false;
+        }
+        if (p.num_errors() != 5 || p.num_tokens() < 3 * token_chunk::capacity) return false;
+      }
+
+      if (true) {
+        // a lexer that has filled a chunk makes values for the tokens it lexes after it.
+        const char src[] = "1 2";
+        lexer lex(src, sizeof(src) - 1);
+        std::unique_ptr<token_chunk> chunk(new token_chunk());
+        if (lex.lex_token(*chunk) != tt::num_const || chunk->values[0] == 0) return false;
+        if (lex.next() != tt::num_const || !lex.value() || lex.value()->type() != ot::real) return false;
+      }
+
+      if (true) {
+        // segments lexed in parallel stitch into the serial tokens, even when strings, names and
+        // specials run over the places the source is cut.
+        std::string src;
+        for (int i = 0; i != 200; ++i) {
+          src += "x <- 'a\nb # \\'\n c'\ny <- \"q'\n\"\n`odd\nname` <- 1 # it's\nw <- a %in\n% 3\n";
+          if (i % 50 == 0) src += "s <- 'bad \\q'\nfoo\n'\n\"\n";
+        }
+        token_buffer serial(src.data(), src.size(), false);
+        for (unsigned threads : { 1, 3, 8 }) {
+          for (size_t min_segment : { 1, 300 }) {
+            parallel_lexer par(src.data(), src.size(), threads, min_segment);
+            if (par.num_segments() > threads) return false;
+            // only a special cut in two is beyond a guess.
+            if (par.num_segments() > 1 && par.num_fallbacks() >= par.num_segments()) return false;
+            lexer a(src.data(), src.size(), serial), b(src.data(), src.size(), par);
+            for (;;) {
+              std::string ea, eb;
+              try { a.next(); } catch (std::runtime_error &e) { ea = e.what(); }
+              try { b.next(); } catch (std::runtime_error &e) { eb = e.what(); }
+              if (ea != eb || a.tok() != b.tok() || a.offset() != b.offset() || a.length() != b.length()) return false;
+              if (a.tok() == tt::symbol && a.value() != b.value()) return false;
+              if (a.tok() == tt::end_of_input) break;
+            }
+          }
+        }
+      }
+
+      if (true) {
+        // an ast cache image loads the same trees as the parse it was made from.
+        const char src[] =
+          "f <- function(x, y = NULL, ...) x[[1]]$a\n"
+          "c(TRUE, NA, NA_integer_, NA_real_, -Inf, 2L, 1e300, 3i, 'a\\nb', \"\", NA_character_, 'NA')\n"
+          "x[, 2] <- list(a = 1, `b c` = f)\n"
+          "x <- )\n"
+        ;
+        size_t size = sizeof(src) - 1;
+        parser p(src, size);
+        std::string image = ast_cache::save(p, src, size);
+        ast_cache::reader r(image.data(), image.size());
+        std::ostringstream expected, os;
+        expected << *p.exprs();
+        os << *r.exprs();
+        if (os.str() != expected.str() || r.num_errors() != 1) return false;
+        if (!r.matches(src, size) || r.matches(src, size - 1)) return false;
+        std::string other(src, size);
+        other[0] = 'g';
+        if (r.matches(other.data(), size)) return false;
+        try {
+          ast_cache::reader bad(image.data(), image.size() - 1);
+          return false;
+        } catch (std::runtime_error &) {
+        }
+      }
+
+      if (true) {
+        // closures, loops and assignment. repeated lookups hit the call site caches.
+        const char src[] =
+          "f <- function(x, y = 2) x * y + 1\n"
+          "s <- 0\n"
+          "for (i in 1:100) s <- s + f(i)\n"
+          "g <- function(...) { n <- 0; for (v in c(...)) { if (v > 3) break; n <- n + v }; return(n) }\n"
+          "x <- c(1L, 5L, 7L); x[2] <- 10L\n"
+          "list(s, g(1, 2, 3, 4), x[-1], f(y = 3, 1))\n"
+        ;
+        parser p(src, sizeof(src) - 1);
+        evaluator ev;
+        objref last = p.exprs();
+        while (last->tail() != obj::null_const()) last = last->tail();
+        last->set_head(last->head()->tail());
+        ev.eval_program(p.exprs());
+        std::ostringstream os;
+        for (objref e = last->head(); e != obj::null_const(); e = e->tail()) {
+          os << *ev.eval(e->head(), ev.global_env()) << ";";
+        }
+        if (os.str() != "10200;6;10L 7L;4;") return false;
+        if (ev.cache_hits() < 300 || ev.cache_misses() > 50) return false;
+
+        // a collection that the evaluator didn't start still drops what the caches hold.
+        size_t misses = ev.cache_misses();
+        ev.get_heap().collect(true);
+        objref call = last->head()->tail()->tail()->tail()->head();
+        if (ev.eval(call, ev.global_env())->type() != ot::real || ev.cache_misses() == misses) return false;
+      }
+
+      if (true) {
+        // closures are compiled on their second call and give the same answers as the tree walker.
+        const char src[] = "f <- function(n) { s <- 0; i <- 0; while (i < n) { i <- i + 1; if (i %% 2 == 0) next; s <- s + i * 2 }; s }\nf(10) + f(11)";
+        for (unsigned jit = 0; jit != 3; ++jit) {
+          parser p(src, sizeof(src) - 1);
+          evaluator ev;
+          ev.set_jit_threshold(jit);
+          std::ostringstream os;
+          os << *ev.eval_program(p.exprs());
+          if (os.str() != "122") return false;
+          objref body = env::find_local(ev.global_env(), obj::make_symbol("f"))->head()->body();
+          if ((body->type() == ot::bytecode) != (jit != 0)) return false;
+          if (jit) {
+            std::ostringstream code;
+            bc::disassemble(code, body);
+            if (code.str().find("loopback") == std::string::npos || code.str().find(" eval ") != std::string::npos) return false;
+          }
+        }
+      }
+
+      if (true) {
+        // arguments are evaluated when first used and only once. defaults see the new frame.
+        const char src[] =
+          "n <- 0; g <- function() { n <<- n + 1; n }\n"
+          "twice <- function(x) x + x\n"
+          "lazy <- function(x, y = x * 2) { x <- 10; y }\n"
+          "unused <- function(x) 1\n"
+          "ap <- function(f, v) f(v)\n"
+          "c(twice(g()), n, lazy(1), unused(stop(\"forced\")), ap(function(z) z * 3, 4))";
+        for (unsigned jit = 0; jit != 3; ++jit) {
+          parser p(src, sizeof(src) - 1);
+          evaluator ev;
+          ev.set_jit_threshold(jit);
+          std::ostringstream os;
+          os << *ev.eval_program(p.exprs());
+          if (os.str() != "2 1 20 1 12") return false;
+        }
+      }
+
+      if (true) {
+        // a base function bound in the body, even on some paths, is called and not inlined.
+        const char *srcs[][2] = {
+          { "f <- function() { `+` <- function(a, b) 42; 1 + 1 }; c(f(), f(), f())", "42 42 42" },
+          { "g <- function(x) { if (x) `*` <- function(a, b) 0; 2 * 3 }; c(g(FALSE), g(FALSE), g(TRUE))", "6 6 0" },
+        };
+        for (auto &src : srcs) {
+          for (unsigned jit = 0; jit != 3; ++jit) {
+            parser p(src[0], strlen(src[0]));
+            evaluator ev;
+            ev.set_jit_threshold(jit);
+            std::ostringstream os;
+            os << *ev.eval_program(p.exprs());
+            if (os.str() != src[1]) return false;
+          }
+        }
+      }
+
+      if (true) {
+        // element-wise trees run as one fused loop and agree with the operators one at a time.
+        const char src[] =
+          "f <- function(x, y, z) -x * 2L + y - z\n"
+          "id <- function(v) v\n"
+          "x <- 1:1000; y <- x / 7; z <- c(2L, NA)\n"
+          "a <- f(x, y, z); a <- f(x, y, z)\n"
+          "b <- -id(x) * 2L + id(y) - id(z)\n"
+          "c(length(a), sum(is.na(a)), all(a == b | is.na(a)) & all(is.na(a) == is.na(b)))";
+        for (unsigned jit = 0; jit != 4; jit += 2) {
+          parser p(src, sizeof(src) - 1);
+          evaluator ev;
+          ev.set_jit_threshold(jit);
+          std::ostringstream os;
+          os << *ev.eval_program(p.exprs());
+          if (os.str() != "1000L 500L 1L") return false;
+          if (jit) {
+            std::ostringstream code;
+            bc::disassemble(code, env::find_local(ev.global_env(), obj::make_symbol("f"))->head()->body());
+            if (code.str().find("fused") == std::string::npos) return false;
+          }
+        }
+      }
+
+      if (true) {
+        // the IEEE checks from arith-true.R, which should all be TRUE, and whole vector
+        // arithmetic long enough to use the SIMD kernels and their scalar tails.
+        const char src[] =
+          "i1 <- 3.14 / 0\n"
+          "i1 == (i2 <- 1:1 / 0:0)\n"
+          "is.infinite( i1) & is.infinite( i2) &   i1 > 12   &   i2 > 12\n"
+          "is.infinite(-i1) & is.infinite(-i2) & (-i1) < -12 & (-i2) < -12\n"
+          "is.nan(n1 <- 0 / 0)\n"
+          "is.nan( - n1)\n"
+          "i1 ==  i1 + i1\n"
+          "i1 ==  i1 * i1\n"
+          "is.nan(i1 - i1)\n"
+          "is.nan(i1 / i1)\n"
+          "1/0 == Inf & 0 ^ -1 == Inf\n"
+          "1/Inf == 0 & Inf ^ -1 == 0\n"
+          "is.na(iNA <- NA_integer_)\n"
+          "!is.na(Inf) & !is.nan(Inf) &   is.infinite(Inf) & !is.finite(Inf)\n"
+          "!is.na(-Inf)& !is.nan(-Inf)&   is.infinite(-Inf)& !is.finite(-Inf)\n"
+          " is.na(NA)  & !is.nan(NA)  &  !is.infinite(NA)  & !is.finite(NA)\n"
+          " is.na(NaN) &  is.nan(NaN) &  !is.infinite(NaN) & !is.finite(NaN)\n"
+          " is.na(iNA) & !is.nan(iNA) &  !is.infinite(iNA) & !is.finite(iNA)\n"
+          "all(!is.nan(c(1.,NA)))\n"
+          "all(c(FALSE,TRUE,FALSE) == is.nan(c   (1.,NaN,NA)))\n"
+          "all((rn <- -c(Inf, 2:1)) < 0)\n"
+          "all(is.na(r <- c(rn, 0, rp <- c(1:2,Inf), NA, NaN)) == c(rep <- c(FALSE, FALSE, FALSE), FALSE, rep, TRUE, TRUE))\n"
+          "all(r^0 == 1)\n"
+          "all( 1^r  == 1)\n"
+          "all(c(NA, -2L, 0L, 3L)^0L == 1)\n"
+          "all((rn ^ -3) == -((-rn) ^ -3))\n"
+          "all(c(1.1,2,Inf) ^ Inf == Inf)\n"
+          "all(c(1.1,2,Inf) ^ -Inf == 0)\n"
+          ".9 ^ Inf == 0\n"
+          ".9 ^ -Inf == Inf\n"
+          "all(is.nan(rn ^ .5))\n"
+          "all(is.na(1:11 + c(2147483640L, NA)) == c(FALSE, TRUE, FALSE, TRUE, FALSE, TRUE, FALSE, TRUE, TRUE, TRUE, TRUE))\n"
+          "all((1:11 < 6L) == (1:11 - 5 <= 0.5)) & is.na((c(5, NA) == 5)[2])\n"
+          "all(c(-7, 7, -7.5) %% 2 == c(1, 1, 0.5) & c(-7L, 7L) %/% 2L == c(-4L, 3L))\n"
+          "all(c(1, -1, 1, 3) %% c(Inf, Inf, -Inf, 3) == c(1, Inf, -Inf, 0) & c(5, -5, 0.5) %/% c(Inf, Inf, 1) == c(0, -1, 0)) & is.nan(Inf %% 2)\n"
+          "any(c(NA, FALSE, TRUE)) & is.na(all(c(NA, TRUE))) & !all(c(NA, FALSE))\n"
+        ;
+        parser p(src, sizeof(src) - 1);
+        evaluator ev;
+        std::ostringstream os;
+        for (objref e = p.exprs(); e != obj::null_const(); e = e->tail()) {
+          objref value = ev.eval(e->head(), ev.global_env());
+          if (value->type() == ot::logical) os << *value << ";";
+        }
+        std::string expect;
+        for (int i = 0; i != 35; ++i) expect += "TRUE;";
+        if (p.num_errors() != 0 || os.str() != expect) return false;
+      }
+
+      if (true) {
+        // : with infinite bounds is too long, and bounds outside int give reals.
+        for (const char *src : { "1:Inf", "-Inf:1", "Inf:Inf" }) {
+          parser p(src, std::strlen(src));
+          evaluator ev;
+          std::string what;
+          try {
+            ev.eval(p.exprs()->head(), ev.global_env());
+          } catch (std::runtime_error &e) {
+            what = e.what();
+          }
+          if (what != "result would be too long a vector") return false;
+        }
+        const char src[] = "1e20:1e20";
+        parser p(src, sizeof(src) - 1);
+        evaluator ev;
+        objref value = ev.eval(p.exprs()->head(), ev.global_env());
+        if (value->type() != ot::real || value->length() != 1 || value->data<double>()[0] != 1e20) return false;
+      }
+
+      if (true) {
+        // big frames move into a hash table. removal keeps every other binding reachable.
+        objref rho = env::make(obj::null_const());
+        for (int i = 0; i != 1000; ++i) {
+          env::define(rho, obj::make_symbol("v" + std::to_string(i)), obj::make_integer(i));
+        }
+        if (!env::is_hashed(rho) || env::num_bindings(rho) != 1000) return false;
+        for (int i = 0; i != 1000; i += 2) {
+          if (!env::remove(rho, obj::make_symbol("v" + std::to_string(i)))) return false;
+        }
+        for (int i = 0; i != 1000; ++i) {
+          objref b = env::find_local(rho, obj::make_symbol("v" + std::to_string(i)));
+          if ((b != nullptr) != (i % 2 == 1) || (b && b->head()->data<int>()[0] != i)) return false;
+        }
+        if (env::num_bindings(rho) != 500 || env::remove(rho, obj::make_symbol("v0"))) return false;
+
+        std::string src;
+        for (int i = 0; i != 40; ++i) src += "a" + std::to_string(i) + " <- " + std::to_string(i) + "\n";
+        src += "f <- function() a39 + a0\nx <- f()\nrm(a0, \"a1\")\nc(x, exists(\"a0\"), exists(\"a1\"), exists(\"a2\"), exists(\"c\"))";
+        parser p(src.data(), src.size());
+        evaluator ev;
+        std::ostringstream os;
+        os << *ev.eval_program(p.exprs());
+        if (!env::is_hashed(ev.global_env()) || os.str() != "39 0 0 1 1") return false;
+      }
+
+      {
+        heap h;
+        heap::scope scope(h);
+        for (int i = 0; i != 10000; ++i) {
+          new obj(ot::list);
+          obj::make_string(std::string(300, 'x'));
+        }
+        if (h.num_nodes() != 20000) return false;
+        if (h.num_blocks() > 20) return false;
+        h.release();
+        if (h.num_nodes() != 0 || h.num_blocks() != 0) return false;
+      }
+
+      {
+        heap h;
+        heap::scope scope(h);
+        obj *root = obj::null_const();
+        h.add_root(&root);
+        for (int i = 0; i != 1000; ++i) {
+          root = new obj(ot::list, obj::make_string("kept"), root);
+          new obj(ot::list, obj::make_string(std::string(1000, 'x')));
+        }
+        h.collect(false);
+        if (h.num_nodes() != 2000 || h.num_young_collections() != 1) return false;
+
+        // old node pointing at a young one must survive a young collection.
+        obj *young = obj::make_string("young");
+        root->set_head(young);
+        h.collect(false);
+        if (h.num_nodes() != 2001 || root->head() != young) return false;
+
+        // reuse freed cells rather than growing.
+        size_t blocks = h.num_blocks();
+        root = root->tail();
+        h.collect(true);
+        if (h.num_nodes() != 1998) return false;
+        for (int i = 0; i != 3; ++i) new obj(ot::list);
+        if (h.num_blocks() != blocks) return false;
+
+        // a full collection keeps the young nodes it promotes.
+        obj *fresh = obj::make_string("fresh");
+        root->set_head(fresh);
+        h.collect(true);
+        if (h.num_nodes() != 1998 || root->head() != fresh || fresh->type() != ot::chr) return false;
+
+        // a remembered node that a full collection frees is forgotten first.
+        {
+          obj *big = obj::make_vector(ot::vec, heap::chunk_size / 4 / sizeof(obj*) + 1);
+          root->set_head(big);
+          h.collect(false);
+          big->set_elt(0, obj::make_string("young"));
+          root->set_head(fresh);
+          h.collect(true);
+          if (h.num_nodes() != 1998) return false;
+        }
+
+        // a write made while another heap is current is remembered by the node's own heap.
+        heap other;
+        heap::scope other_scope(other);
+        obj *other_node = new obj(ot::list);
+        if (heap::owner(root) != &h || heap::owner(other_node) != &other || heap::owner(obj::null_const()) != nullptr) return false;
+        obj *kept = nullptr;
+        {
+          heap::scope back(h);
+          kept = obj::make_string("kept");
+        }
+        root->set_head(kept);
+        h.collect(false);
+        if (root->head() != kept || kept->type() != ot::chr) return false;
+
+        // so is a young node written into an old node of another heap, by the young node's heap.
+        obj *holder = new obj(ot::list);
+        other.add_root(&holder);
+        other.collect(false);
+        obj *guest = nullptr;
+        {
+          heap::scope back(h);
+          guest = obj::make_string("guest");
+        }
+        size_t nodes = h.num_nodes();
+        holder->set_head(guest);
+        h.collect(false);
+        if (h.num_nodes() != nodes || holder->head() != guest) return false;
+        other.remove_root(&holder);
+        h.remove_root(&root);
+      }
+
+      {
+        // symbols are interned and survive collections of the heap that asked for them.
+        heap h;
+        heap::scope scope(h);
+        obj *x = obj::make_symbol("x");
+        if (obj::make_symbol(std::string("x")) != x) return false;
+        if (obj::make_symbol("xx") == x || !x->isSymbol()) return false;
+        for (int i = 0; i != 5000; ++i) {
+          obj::make_symbol("sym" + std::to_string(i));
+        }
+        if (symbol_table::global().find("sym4999", 7) != obj::make_symbol("sym4999")) return false;
+        if (symbol_table::global().find("sym5000", 7) != nullptr) return false;
+        h.collect(true);
+        if (obj::make_symbol("x") != x || std::strcmp(x->chr_data(), "x")) return false;
+      }
+
+      {
+        // tokens are slices of the source buffer.
+        const char src[] = "x <- `x` + 'a\\tb' # comment\nx";
+        lexer lex(src, sizeof(src) - 1);
+        static const tt toks[] = { tt::symbol, tt::left_assign, tt::symbol, tt::plus, tt::str_const, tt::newline, tt::symbol, tt::end_of_input };
+        static const size_t offsets[] = { 0, 2, 5, 9, 11, 27, 28, 29 };
+        static const size_t lengths[] = { 1, 2, 3, 1, 6, 1, 1, 0 };
+        for (int i = 0; i != 8; ++i) {
+          if (lex.next() != toks[i] || lex.offset() != offsets[i] || lex.length() != lengths[i]) return false;
+          if (toks[i] == tt::symbol && lex.value() != obj::make_symbol("x")) return false;
+          if (toks[i] == tt::str_const && std::strcmp(lex.value()->chr_data(), "a\tb")) return false;
+        }
+      }
+
+      {
+        // every reserved word is found, near misses are symbols.
+        for (unsigned i = 0; i != keywords::num_keywords; ++i) {
+          const keywords::keyword &kw = keywords::table[i];
+          lexer lex(kw.name, kw.len);
+          if (lex.next() != kw.tok || lex.length() != kw.len) return false;
+        }
+        const char src[] = "iff Nan NA_ NaNa functions TRUE_ el";
+        lexer lex(src, sizeof(src) - 1);
+        while (lex.next() != tt::end_of_input) {
+          if (lex.tok() != tt::symbol) return false;
+        }
+      }
+
+      {
+        // names may have non-ASCII letters, digits and marks. other characters and bad UTF-8 are errors.
+        const char src[] = "caf\xc3\xa9<-\xcf\x80 .na\xc3\xafve_\xd9\xa3 e\xcc\x81 \xc2\xab \xff \xc3 x";
+        lexer lex(src, sizeof(src) - 1);
+        const char *ids[] = { "caf\xc3\xa9", "<-", "\xcf\x80", ".na\xc3\xafve_\xd9\xa3", "e\xcc\x81", "\xc2\xab", "\xff", "\xc3", "x" };
+        const tt toks[] = { tt::symbol, tt::left_assign, tt::symbol, tt::symbol, tt::symbol, tt::error, tt::error, tt::error, tt::symbol };
+        for (int i = 0; i != 9; ++i) {
+          if (lex.next() != toks[i] || lex.id() != ids[i]) return false;
+        }
+        if (lex.next() != tt::end_of_input) return false;
+
+        unsigned cp;
+        const char *bad[] = { "\xc0\x80", "\xe0\x80\x80", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xe2\x82" };
+        for (const char *str : bad) {
+          if (unicode::decode(str, str + strlen(str), cp) != 0) return false;
+        }
+        const char good[] = "\xf0\x9f\x98\x80";
+        if (unicode::decode(good, good + 4, cp) != 4 || cp != 0x1f600 || unicode::classify(cp) != unicode::none) return false;
+      }
+
+      if (true) {
+        // files parsed by a pool of workers, each into its own heap, print the same as when
+        // they are parsed one by one and share their symbols.
+        std::vector<std::string> paths;
+        for (const char *name : { "arith.R", "complex.R", "reg-tests-1a.R", "any-all.R", "eval-etc.R", "datetime.R", "utf8-regex.R" }) {
+          paths.push_back(std::string("../test/R-tests/") + name);
+        }
+        for (unsigned threads : { 1, 3, 16 }) {
+          parse_pool pool(paths, threads);
+          if (pool.num_threads() > paths.size() || pool.files().size() != paths.size()) return false;
+          for (size_t i = 0; i != paths.size(); ++i) {
+            const parsed_file &f = pool.files()[i];
+            mapped_file src(paths[i]);
+            parser p(src);
+            std::ostringstream expected, os;
+            expected << *p.exprs();
+            os << *f.exprs;
+            if (f.path != paths[i] || f.bytes != src.size() || os.str() != expected.str() || f.num_errors != p.num_errors()) return false;
+          }
+          if (pool.files()[0].exprs->head()->head() != obj::make_symbol("options")) return false;
+        }
+        bool thrown = false;
+        try {
+          parse_pool pool({ paths[0], "../test/R-tests/no-such-file.R" }, 2);
+        } catch (std::runtime_error &) {
+          thrown = true;
+        }
+        if (!thrown) return false;
+      }
+
+      {
+        // a mapped file lexes the same as the stream it replaces.
+        mapped_file file("../test/R-tests/arith.R");
+        std::ifstream istr("../test/R-tests/arith.R");
+        lexer lex1(file);
+        lexer lex2(istr);
+        do {
+          if (lex1.next() != lex2.next() || lex1.id() != lex2.id()) return false;
+        } while (lex1.tok() != tt::end_of_input && lex1.tok() != tt::error);
+        if (lex1.tok() != tt::end_of_input) return false;
       }
 
+      heap_.release();
       return true;
     }
   private:
+    heap heap_;
   };
 }
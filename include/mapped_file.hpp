@@ -0,0 +1,96 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace little_r {
+  // Read-only view of a whole file for the lexer.
+  // The file is mapped rather than read so large sources are not copied.
+  class mapped_file {
+  public:
+    mapped_file(const std::string &path) : data_(nullptr), size_(0) {
+      #ifdef _WIN32
+        file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) throw std::runtime_error("can't open " + path);
+        LARGE_INTEGER size;
+        GetFileSizeEx(file_, &size);
+        size_ = (size_t)size.QuadPart;
+        mapping_ = nullptr;
+        if (size_ != 0) {
+          mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+          data_ = mapping_ ? (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : nullptr;
+          if (!data_) {
+            close();
+            throw std::runtime_error("can't map " + path);
+          }
+        }
+      #else
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) throw std::runtime_error("can't open " + path);
+        struct stat st;
+        if (fstat(fd_, &st) != 0) {
+          close();
+          throw std::runtime_error("can't stat " + path);
+        }
+        size_ = (size_t)st.st_size;
+        if (size_ != 0) {
+          void *mem = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+          if (mem == MAP_FAILED) {
+            close();
+            throw std::runtime_error("can't map " + path);
+          }
+          madvise(mem, size_, MADV_SEQUENTIAL);
+          data_ = (const char*)mem;
+        }
+      #endif
+    }
+
+    ~mapped_file() {
+      close();
+    }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    const char *data() const { return data_; }
+    size_t size() const { return size_; }
+
+  private:
+    void close() {
+      #ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        CloseHandle(file_);
+      #else
+        if (data_) munmap((void*)data_, size_);
+        ::close(fd_);
+      #endif
+      data_ = nullptr;
+    }
+
+    const char *data_;
+    size_t size_;
+    #ifdef _WIN32
+      HANDLE file_;
+      HANDLE mapping_;
+    #else
+      int fd_;
+    #endif
+  };
+}
+
+#endif
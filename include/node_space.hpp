@@ -0,0 +1,157 @@
+#ifndef NODE_SPACE_HPP
+#define NODE_SPACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <new>
+
+// LITTLE_R_COMPRESSED=1 stores the references inside a node as 32 bit offsets, which halves
+// the size of a cons cell. Every node then comes from one reserved range of address space.
+#ifndef LITTLE_R_COMPRESSED
+  #define LITTLE_R_COMPRESSED 0
+#endif
+
+#if LITTLE_R_COMPRESSED
+  #ifdef _WIN32
+    #ifndef NOMINMAX
+      #define NOMINMAX
+    #endif
+    #include <windows.h>
+  #else
+    #include <sys/mman.h>
+  #endif
+#endif
+
+namespace little_r {
+  class obj;
+
+#if LITTLE_R_COMPRESSED
+  // The address range shared by the node heaps of the process.
+  //
+  // A reference is the distance of a node from the base in granules, so 32 bits cover
+  // 64GB. 0 is nullptr and the first granule after it is R's NULL. The range is reserved
+  // once and blocks are committed as the heaps ask for them. Blocks that are given
+  // back are kept for reuse and the range is never released, as heaps may outlive main.
+  class node_space {
+  public:
+    static const unsigned shift = 4;
+    static const size_t granule = (size_t)1 << shift;
+    static const size_t reserve_size = (size_t)1 << (32 + shift);
+    static const size_t block_align = 64 * 1024;
+
+    static uint32_t compress(const obj *p) {
+      return p ? (uint32_t)(((const char*)p - base_ptr()) >> shift) : 0;
+    }
+
+    static obj *decompress(uint32_t ref) {
+      return ref ? (obj*)(base_ptr() + ((size_t)ref << shift)) : nullptr;
+    }
+
+    static obj *null_node() {
+      char *base = base_ptr();
+      return (obj*)((base ? base : space::get().base) + granule);
+    }
+
+    // committed memory for a heap block. sizes are rounded up to block_align.
+    static char *alloc(size_t size) {
+      return space::get().alloc(size);
+    }
+
+    static void free(char *block, size_t size) {
+      space::get().free(block, size);
+    }
+
+  private:
+    // a plain pointer so that the compiler can keep it in a register. it is set once,
+    // before the first node is made.
+    static char *&base_ptr() {
+      static char *ptr;
+      return ptr;
+    }
+
+    static size_t round(size_t size) {
+      return (size + block_align - 1) & ~(block_align - 1);
+    }
+
+    struct space {
+      char *base;
+      char *top;
+      char *end;
+      std::mutex mutex;
+      std::multimap<size_t, char*> free_blocks;
+
+      // leaked on purpose: symbols and thread local heaps release their nodes at exit.
+      static space &get() {
+        static space *s = new space();
+        return *s;
+      }
+
+      space() {
+        #ifdef _WIN32
+          base = (char*)VirtualAlloc(nullptr, reserve_size, MEM_RESERVE, PAGE_NOACCESS);
+        #else
+          void *mem = mmap(nullptr, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+          base = mem == MAP_FAILED ? nullptr : (char*)mem;
+        #endif
+        if (!base) throw std::bad_alloc();
+        end = base + reserve_size;
+        commit(base, block_align);
+        top = base + block_align;
+        base_ptr() = base;
+      }
+
+      static void commit(char *block, size_t size) {
+        #ifdef _WIN32
+          if (!VirtualAlloc(block, size, MEM_COMMIT, PAGE_READWRITE)) throw std::bad_alloc();
+        #else
+          if (mprotect(block, size, PROT_READ | PROT_WRITE) != 0) throw std::bad_alloc();
+        #endif
+      }
+
+      // the smallest free block that fits, split if it is bigger.
+      char *alloc(size_t size) {
+        size = round(size);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto i = free_blocks.lower_bound(size);
+        if (i != free_blocks.end()) {
+          char *res = i->second;
+          size_t spare = i->first - size;
+          free_blocks.erase(i);
+          if (spare) free_blocks.insert(std::make_pair(spare, res + size));
+          return res;
+        }
+        if (size > size_t(end - top)) throw std::bad_alloc();
+        char *res = top;
+        commit(res, size);
+        top += size;
+        return res;
+      }
+
+      void free(char *block, size_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        free_blocks.insert(std::make_pair(round(size), block));
+      }
+    };
+  };
+
+  // a reference held in a node. it converts to and from obj* so accessors are unchanged.
+  class node_ref {
+  public:
+    node_ref() = default;
+    node_ref &operator=(obj *value) { ref_ = node_space::compress(value); return *this; }
+    operator obj*() const { return node_space::decompress(ref_); }
+  private:
+    uint32_t ref_;
+  };
+
+  typedef uint32_t node_length;
+#else
+  typedef obj *node_ref;
+  typedef size_t node_length;
+#endif
+}
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef NUMBER_HPP
+#define NUMBER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+  #include <intrin.h>
+#endif
+
+namespace little_r {
+  // Numeric literals.
+  //
+  // A literal is scanned and converted in one pass. Decimals use the Eisel-Lemire
+  // algorithm (as in fast_float): the digits go in a 64 bit integer and are
+  // multiplied by a 128 bit approximation of the power of ten, which gives the
+  // correctly rounded double without any big number arithmetic.
+  // The rare cases it can't decide (more than 19 digits) go to strtod.
+  namespace number {
+    struct literal {
+      double value;
+      char suffix;  // 0, 'L' for integers or 'i' for imaginary numbers
+    };
+
+    inline uint64_t umul128(uint64_t a, uint64_t b, uint64_t &hi) {
+      #if defined(__SIZEOF_INT128__)
+        unsigned __int128 res = (unsigned __int128)a * b;
+        hi = (uint64_t)(res >> 64);
+        return (uint64_t)res;
+      #elif defined(_MSC_VER) && defined(_M_X64)
+        return _umul128(a, b, &hi);
+      #else
+        uint64_t a_lo = (uint32_t)a, a_hi = a >> 32, b_lo = (uint32_t)b, b_hi = b >> 32;
+        uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi, hl = a_hi * b_lo, hh = a_hi * b_hi;
+        uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+        hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+        return (mid << 32) | (uint32_t)ll;
+      #endif
+    }
+
+    inline int leading_zeros(uint64_t x) {
+      #if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long res;
+        _BitScanReverse64(&res, x);
+        return 63 - (int)res;
+      #elif defined(__GNUC__)
+        return __builtin_clzll(x);
+      #else
+        int res = 0;
+        while (!(x & (uint64_t(1) << 63))) { x <<= 1; ++res; }
+        return res;
+      #endif
+    }
+
+    constexpr int smallest_power = -342;
+    constexpr int largest_power = 308;
+
+    // 128 bit approximations of 5^q, normalised so that the top bit is set.
+    // They are truncated for q >= 0 and rounded up for -27 <= q < 0, as Eisel-Lemire expects.
+    // The table is made once from exact big integers rather than pasted in.
+    class pow5_table {
+    public:
+      static const pow5_table &get() {
+        static const pow5_table table;
+        return table;
+      }
+
+      uint64_t hi(int q) const { return hi_[q - smallest_power]; }
+      uint64_t lo(int q) const { return lo_[q - smallest_power]; }
+
+    private:
+      // little-endian 32 bit limbs.
+      typedef std::vector<uint32_t> big;
+
+      pow5_table() {
+        big b(1, 1);
+        for (int q = 0; q <= largest_power; ++q) {
+          top128(b, q);
+          mul5(b);
+        }
+
+        // floor(2^1100 / 5^n) keeps well over 128 bits down to 5^342
+        // and floor(floor(x) / 5) == floor(x / 5) so the divisions are exact.
+        big r(1100 / 32 + 1, 0);
+        r.back() = uint32_t(1) << (1100 % 32);
+        for (int n = 1; n <= -smallest_power; ++n) {
+          div5(r);
+          top128(r, -n);
+          if (n <= 27 && ++lo_[-n - smallest_power] == 0) ++hi_[-n - smallest_power];
+        }
+      }
+
+      static void mul5(big &b) {
+        uint64_t carry = 0;
+        for (size_t i = 0; i != b.size(); ++i) {
+          uint64_t x = (uint64_t)b[i] * 5 + carry;
+          b[i] = (uint32_t)x;
+          carry = x >> 32;
+        }
+        if (carry) b.push_back((uint32_t)carry);
+      }
+
+      static void div5(big &b) {
+        uint64_t rem = 0;
+        for (size_t i = b.size(); i-- != 0; ) {
+          uint64_t x = (rem << 32) | b[i];
+          b[i] = (uint32_t)(x / 5);
+          rem = x % 5;
+        }
+        while (b.size() > 1 && b.back() == 0) b.pop_back();
+      }
+
+      void top128(const big &b, int q) {
+        int bits = (int)b.size() * 32;
+        while (!(b[(bits - 1) / 32] >> ((bits - 1) % 32) & 1)) --bits;
+        uint64_t hi = 0, lo = 0;
+        for (int i = bits - 1; i != bits - 129; --i) {
+          unsigned bit = i >= 0 ? b[i / 32] >> (i % 32) & 1 : 0;
+          hi = hi << 1 | lo >> 63;
+          lo = lo << 1 | bit;
+        }
+        hi_[q - smallest_power] = hi;
+        lo_[q - smallest_power] = lo;
+      }
+
+      uint64_t hi_[largest_power - smallest_power + 1];
+      uint64_t lo_[largest_power - smallest_power + 1];
+    };
+
+    // w * 10^q rounded to the nearest double, or false if it can't be decided here.
+    inline bool eisel_lemire(uint64_t w, int q, double &result) {
+      uint64_t bits;
+      if (w == 0 || q < smallest_power) {
+        bits = 0;
+      } else if (q > largest_power) {
+        bits = uint64_t(0x7ff) << 52;
+      } else {
+        const pow5_table &pow5 = pow5_table::get();
+        int lz = leading_zeros(w);
+        w <<= lz;
+
+        // 55 bits of product are enough unless the bits below them are all ones.
+        uint64_t hi;
+        uint64_t lo = umul128(w, pow5.hi(q), hi);
+        const uint64_t precision_mask = ~uint64_t(0) >> 55;
+        if ((hi & precision_mask) == precision_mask) {
+          uint64_t hi2;
+          umul128(w, pow5.lo(q), hi2);
+          lo += hi2;
+          if (hi2 > lo) ++hi;
+        }
+        if (lo == ~uint64_t(0) && (q < -27 || q > 55)) return false;
+
+        int upper = (int)(hi >> 63);
+        int shift = upper + 64 - 52 - 3;
+        uint64_t mantissa = hi >> shift;
+        int power2 = (int)((((152170 + 65536) * (int64_t)q) >> 16) + 63) + upper - lz + 1023;
+
+        if (power2 <= 0) {
+          // subnormal
+          if (-power2 + 1 >= 64) {
+            bits = 0;
+          } else {
+            mantissa >>= -power2 + 1;
+            mantissa += mantissa & 1;
+            mantissa >>= 1;
+            power2 = mantissa < (uint64_t(1) << 52) ? 0 : 1;
+            bits = (mantissa & ~(uint64_t(1) << 52)) | (uint64_t)power2 << 52;
+          }
+        } else {
+          // exactly half way: round to even.
+          if (lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 && (mantissa << shift) == hi) {
+            mantissa &= ~uint64_t(1);
+          }
+          mantissa += mantissa & 1;
+          mantissa >>= 1;
+          if (mantissa >= (uint64_t(2) << 52)) {
+            mantissa = uint64_t(1) << 52;
+            ++power2;
+          }
+          mantissa &= ~(uint64_t(1) << 52);
+          bits = power2 >= 0x7ff ? uint64_t(0x7ff) << 52 : mantissa | (uint64_t)power2 << 52;
+        }
+      }
+      std::memcpy(&result, &bits, sizeof(result));
+      return true;
+    }
+
+    // w * 10^q. small cases are exact in double arithmetic (Clinger's fast path).
+    inline bool decimal_to_double(uint64_t w, int q, double &result) {
+      static const double exact[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+      };
+      if (w <= uint64_t(1) << 53 && q >= -22 && q <= 22) {
+        result = q < 0 ? (double)w / exact[-q] : (double)w * exact[q];
+        return true;
+      }
+      return eisel_lemire(w, q, result);
+    }
+
+    inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+    inline int hex_value(char c) {
+      return c >= '0' && c <= '9' ? c - '0' : (c | 32) >= 'a' && (c | 32) <= 'f' ? (c | 32) - 'a' + 10 : -1;
+    }
+
+    // a literal that Eisel-Lemire can't do.
+    inline double slow_path(const char *begin, const char *end) {
+      std::string str(begin, end);
+      return std::strtod(str.c_str(), nullptr);
+    }
+
+    // [+-]digits after e or p. huge exponents are clamped, they only make 0 or Inf.
+    inline const char *parse_exponent(const char *p, const char *end, int &exp) {
+      bool negative = false;
+      if (p != end && (*p == '+' || *p == '-')) negative = *p++ == '-';
+      if (p == end || !is_digit(*p)) return nullptr;
+      exp = 0;
+      for (; p != end && is_digit(*p); ++p) {
+        if (exp < 100000) exp = exp * 10 + (*p - '0');
+      }
+      if (negative) exp = -exp;
+      return p;
+    }
+
+    // 0x digits [. digits] [p exponent]. R requires the exponent if there is a point.
+    inline const char *parse_hex(const char *begin, const char *end, literal &res) {
+      const char *p = begin + 2;
+      uint64_t mantissa = 0;
+      int exp = 0;
+      int num_digits = 0;
+      bool exact = true;
+      bool point = false;
+      for (; p != end; ++p) {
+        int d;
+        if (*p == '.' && !point) {
+          point = true;
+        } else if ((d = hex_value(*p)) >= 0) {
+          if (mantissa >> 60) {
+            exact &= d == 0;
+            if (!point) exp += 4;
+          } else {
+            mantissa = mantissa << 4 | d;
+            if (point) exp -= 4;
+          }
+          ++num_digits;
+        } else {
+          break;
+        }
+      }
+      if (num_digits == 0) return nullptr;
+      if (p != end && (*p | 32) == 'p') {
+        int bexp;
+        p = parse_exponent(p + 1, end, bexp);
+        if (!p) return nullptr;
+        exp += bexp;
+      } else if (point) {
+        return nullptr;
+      }
+
+      // converting to double rounds once and ldexp is exact unless the result is subnormal.
+      double value = (double)mantissa;
+      if (mantissa == 0) {
+        res.value = 0;
+      } else if (exact && 64 - leading_zeros(mantissa) + exp > -1021) {
+        res.value = std::ldexp(value, exp);
+      } else {
+        res.value = slow_path(begin, p);
+      }
+      return p;
+    }
+
+    // scan and convert the literal at "begin". returns its end or nullptr if it is malformed.
+    inline const char *parse(const char *begin, const char *end, literal &res) {
+      const char *p = begin;
+      res.suffix = 0;
+      if (end - p >= 2 && p[0] == '0' && (p[1] | 32) == 'x') {
+        p = parse_hex(begin, end, res);
+      } else {
+        uint64_t w = 0;
+        int q = 0;
+        int num_digits = 0;
+        int significant = 0;
+        bool point = false;
+        for (; p != end; ++p) {
+          if (is_digit(*p)) {
+            ++num_digits;
+            if (significant != 0 || *p != '0') {
+              if (++significant <= 19) {
+                w = w * 10 + (*p - '0');
+                if (point) --q;
+              } else if (!point) {
+                ++q;
+              }
+            } else if (point) {
+              --q;
+            }
+          } else if (*p == '.' && !point) {
+            point = true;
+          } else {
+            break;
+          }
+        }
+        if (num_digits == 0) return nullptr;
+        if (p != end && (*p | 32) == 'e') {
+          int exp;
+          p = parse_exponent(p + 1, end, exp);
+          if (!p) return nullptr;
+          q += exp;
+        }
+        if (significant > 19 || !decimal_to_double(w, q, res.value)) {
+          res.value = slow_path(begin, p);
+        }
+      }
+      if (p && p != end && (*p == 'L' || *p == 'i')) {
+        res.suffix = *p++;
+      }
+      return p;
+    }
+  }
+}
+
+#endif
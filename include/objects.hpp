@@ -2,10 +2,18 @@
 #ifndef OBJECTS_HPP
 #define OBJECTS_HPP
 
+#include <cassert>
+#include <climits>
+#include <cstdint>
 #include <cstring>
+#include <string>
+#include <ostream>
+#include <stdexcept>
+
+#include "node_space.hpp"
 
 namespace little_r {
-  enum class ot {
+  enum class ot : unsigned {
     nil = 0, // nil  = null
     symbol = 1, // symbols
     list = 2, // lists of dotted pairs
@@ -62,14 +70,16 @@ namespace little_r {
     "builtin",    //an internal function that evaluates its arguments
     "char",    //a scalar string object (internal only) ***
     "logical",    //a vector containing logical values
+    "",
+    "",
     "integer",    //a vector containing integer values
     "double",    //a vector containing real values
     "complex",    //a vector containing complex values
     "character",    //a vector containing character values
     "...",    //the special variable length argument ***
     "any",    //a special type that matches all types: there are no objects of this type
-    "expression",    //an expression object
     "list",    //a list
+    "expression",    //an expression object
     "bytecode",    //byte code (internal only) ***
     "externalptr",    //an external pointer object
     "weakref",    //a weak reference object
@@ -78,12 +88,69 @@ namespace little_r {
   };
 
   class obj;
+  class heap;
+  class symbol_table;
+
+  // R's complex number.
+  struct rcomplex {
+    double r;
+    double i;
+  };
+
+  typedef unsigned char rbyte;
+
+  // the vector types whose elements obj::data<T> may hand out as a T.
+  template <class T> struct elem_of {
+    static bool type(ot) { return false; }
+  };
+
+  template <> struct elem_of<int> {
+    static bool type(ot t) { return t == ot::logical || t == ot::integer; }
+  };
+
+  template <> struct elem_of<double> {
+    static bool type(ot t) { return t == ot::real; }
+  };
+
+  template <> struct elem_of<rcomplex> {
+    static bool type(ot t) { return t == ot::complex; }
+  };
+
+  template <> struct elem_of<rbyte> {
+    static bool type(ot t) { return t == ot::raw; }
+  };
+
+  template <> struct elem_of<obj *> {
+    static bool type(ot t) { return t == ot::vec || t == ot::expr || t == ot::str; }
+  };
+
+  // missing values. NA_real_ is a NaN with 1954 in its low word.
+  static const int na_integer = INT_MIN;
+  static const int na_logical = INT_MIN;
+
+  inline double na_real() {
+    uint64_t bits = 0x7ff00000000007a2ull;
+    double res;
+    memcpy(&res, &bits, sizeof(res));
+    return res;
+  }
+
+  inline bool is_na(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits & 0xffffffff) == 1954 && value != value;
+  }
 
   // Record to use when using the original R C code stuctures.
+  // With LITTLE_R_COMPRESSED the references and lengths are 32 bits and a record is 32 bytes.
+#if LITTLE_R_COMPRESSED
+  struct alignas(16) SEXPREC {
+#else
   struct SEXPREC {
+#endif
     struct vecsxp_struct {
-      size_t length;
-      size_t truelength;
+      node_length length;
+      node_length truelength;
     };
 
     struct primsxp_struct {
@@ -91,41 +158,42 @@ namespace little_r {
     };
 
     struct symsxp_struct {
-      obj *pname;
-      obj *value;
-      obj *internal;
+      node_ref pname;
+      node_ref value;
+      node_ref internal;
     };
 
     struct listsxp_struct {
-      obj *carval;
-      obj *cdrval;
-      obj *tagval;
+      node_ref carval;
+      node_ref cdrval;
+      node_ref tagval;
     };
 
     struct envsxp_struct {
-      obj *frame;
-      obj *enclos;
-      obj *hashtab;
+      node_ref frame;
+      node_ref enclos;
+      node_ref hashtab;
     };
 
     struct closxp_struct {
-      obj *formals;
-      obj *body;
-      obj *env;
+      node_ref formals;
+      node_ref body;
+      node_ref env;
     };
 
     struct promsxp_struct {
-      obj *value;
-      obj *expr;
-      obj *env;
+      node_ref value;
+      node_ref expr;
+      node_ref env;
     };
 
     sxpinfo_struct sxpinfo;
-    obj *attrib;
-    obj *gengc_next_node;
-    obj *gengc_prev_node;
+    node_ref attrib;
+    node_ref gengc_next_node;
+    node_ref gengc_prev_node;
 
     union {
+       vecsxp_struct vecsxp;
        primsxp_struct primsxp;
        symsxp_struct symsxp;
        listsxp_struct listsxp;
@@ -162,22 +230,21 @@ namespace little_r {
     }
 
     static objref null_const() {
-      static const SEXPREC value;
-      return objref(&value);
+      #if LITTLE_R_COMPRESSED
+        return node_space::null_node();
+      #else
+        static const SEXPREC value = {};
+        return objref(&value);
+      #endif
     }
 
-    void *operator new(size_t size) {
-      // stand-in allocator
-      return malloc(size);
-    }
+    // nodes live in the current heap and are freed by its collector.
+    void *operator new(size_t size);
 
     void operator delete(void *) {
     }
 
-    void *operator new(size_t size, size_t extra) {
-      // stand-in allocator
-      return malloc(size + extra);
-    }
+    void *operator new(size_t size, size_t extra);
 
     void operator delete(void *, size_t) {
     }
@@ -188,40 +255,221 @@ namespace little_r {
     objref tag() const { return listsxp.tagval; }
 
     obj &set_type(ot value) { sxpinfo.type = value; return *this; }
-    obj &set_head(objref value) { listsxp.carval = value; return *this; }
-    obj &set_tail(objref value) { listsxp.cdrval = value; return *this; }
-    obj &set_tag(objref value) { listsxp.tagval = value; return *this; }
-
+    obj &set_head(objref value) { barrier(value); listsxp.carval = value; return *this; }
+    obj &set_tail(objref value) { barrier(value); listsxp.cdrval = value; return *this; }
+    obj &set_tag(objref value) { barrier(value); listsxp.tagval = value; return *this; }
+
+    objref attrib() const { return SEXPREC::attrib; }
+    obj &set_attrib(objref value) { barrier(value); SEXPREC::attrib = value; return *this; }
+
+    // the general purpose bits, R's LEVELS.
+    unsigned levels() const { return sxpinfo.gp; }
+    obj &set_levels(unsigned value) { sxpinfo.gp = value; return *this; }
+
+    // environments, closures and promises share the three pointers of a list cell.
+    objref frame() const { return envsxp.frame; }
+    objref enclos() const { return envsxp.enclos; }
+    objref hashtab() const { return envsxp.hashtab; }
+    objref formals() const { return closxp.formals; }
+    objref body() const { return closxp.body; }
+    objref cloenv() const { return closxp.env; }
+    obj &set_frame(objref value) { barrier(value); envsxp.frame = value; return *this; }
+    obj &set_hashtab(objref value) { barrier(value); envsxp.hashtab = value; return *this; }
+    obj &set_body(objref value) { barrier(value); closxp.body = value; return *this; }
+
+    // a promise's value is nullptr until it is forced, then its environment is dropped.
+    objref prom_value() const { return promsxp.value; }
+    objref prom_expr() const { return promsxp.expr; }
+    objref prom_env() const { return promsxp.env; }
+    obj &set_prom_value(objref value) { barrier(value); promsxp.value = value; return *this; }
+    obj &set_prom_env(objref value) { barrier(value); promsxp.env = value; return *this; }
+
+    // bytecode is a list cell too: instructions, constants and inline caches, as R's BCODESXP.
+    objref bc_code() const { return listsxp.carval; }
+    objref bc_consts() const { return listsxp.cdrval; }
+    objref bc_caches() const { return listsxp.tagval; }
+
+    // elements of a generic vector.
+    objref elt(size_t i) const { return data<objref>()[i]; }
+    obj &set_elt(size_t i, objref value) { barrier(value); data<objref>()[i] = value; return *this; }
+
+    // index of a builtin or special in the evaluator's table.
+    int prim_offset() const { return primsxp.offset; }
+
+    bool is_function() const { return type() == ot::closure || type() == ot::builtin || type() == ot::special; }
+
+    // the last cell of a list. use a list_builder to add more than the odd element.
     objref last() {
       objref p = this;
-      while (tail() != null_const()) {
-        p = tail();
+      while (p->tail() != null_const()) {
+        p = p->tail();
       }
       return p;
     }
 
     objref append(objref val) {
-      objref t = tail();
       objref extra = new obj(ot::list, val);
-      t->set_tail(extra);
+      last()->set_tail(extra);
       return extra;
     }
 
     char *chr_data() { return (char*)this + sizeof(obj); }
     const char *chr_data() const { return (const char*)this + sizeof(obj); }
 
-    static objref make_string(const std::string &str) {
-      objref res = new (str.size() + 1) obj(ot::chr);
-      memcpy(res->chr_data(), str.c_str(), str.size() + 1);
+    // Atomic vectors keep their elements inline after the header.
+    // truelength is the capacity and length the number in use.
+    // Vectors with at least vector_align bytes of capacity start on a vector_align
+    // boundary so that SIMD loops can use aligned loads.
+    static const size_t vector_align = 32;
+
+    size_t length() const { return vecsxp.length; }
+    size_t truelength() const { return vecsxp.truelength; }
+
+    // int for logical and integer, double, rcomplex and rbyte for raw.
+    template <class T> T *data() {
+      assert(elem_of<T>::type(type()));
+      return (T*)aligned_data(vecsxp.truelength * sizeof(T));
+    }
+
+    template <class T> const T *data() const {
+      assert(elem_of<T>::type(type()));
+      return (const T*)aligned_data(vecsxp.truelength * sizeof(T));
+    }
+
+    static size_t elem_size(ot type) {
+      switch (type) {
+        case ot::logical: case ot::integer: return sizeof(int);
+        case ot::real: return sizeof(double);
+        case ot::complex: return sizeof(rcomplex);
+        case ot::raw: return sizeof(rbyte);
+        case ot::vec: return sizeof(objref);
+        default: return 0;
+      }
+    }
+
+    // set the length, using the spare capacity if there is enough. otherwise the
+    // elements move to a new vector with twice the capacity so that growing one
+    // element at a time is amortised O(1). use the result from then on.
+    objref resize(size_t length) {
+      if (length <= vecsxp.truelength) {
+        if (type() == ot::vec) {
+          for (size_t i = vecsxp.length; i < length; ++i) data<objref>()[i] = null_const();
+        }
+        vecsxp.length = length;
+        return this;
+      }
+      size_t size = elem_size(type());
+      size_t capacity = length > vecsxp.truelength * 2 ? length : vecsxp.truelength * 2;
+      objref res = make_vector(type(), length, capacity);
+      memcpy(res->aligned_data(capacity * size), aligned_data(vecsxp.truelength * size), vecsxp.length * size);
+      res->SEXPREC::attrib = SEXPREC::attrib;
       return res;
     }
 
-    static objref make_symbol(const std::string &str) {
-      objref res = new (str.size() + 1) obj(ot::symbol);
-      memcpy(res->chr_data(), str.c_str(), str.size() + 1);
+    template <class T> objref push_back(T value) {
+      size_t n = length();
+      objref res = resize(n + 1);
+      res->data<T>()[n] = value;
       return res;
     }
 
+    // a list of the values ending in null_const(). the first cell has the given type
+    // so make_list(ot::lang, fn, arg) is a call. with no values it is null_const() whatever the type.
+    static objref make_list(ot) {
+      return null_const();
+    }
+
+    template <typename... elems>
+    static objref make_list(ot type, objref head, elems... tail) {
+      return new obj(type, head, make_list(ot::list, tail...));
+    }
+
+    // an uninitialised vector with room for "capacity" elements.
+    static objref make_vector(ot type, size_t length, size_t capacity = 0) {
+      if (capacity < length) capacity = length;
+      if ((node_length)capacity != capacity) throw std::runtime_error("vector too long");
+      size_t bytes = capacity * elem_size(type);
+      size_t slack = bytes >= vector_align ? vector_align - alignof(SEXPREC) : 0;
+      objref res = new (bytes + slack) obj(type);
+      res->vecsxp.length = length;
+      res->vecsxp.truelength = capacity;
+      if (type == ot::vec) {
+        for (size_t i = 0; i != capacity; ++i) res->data<objref>()[i] = null_const();
+      }
+      return res;
+    }
+
+    // length 1 vectors for literals.
+    static objref make_logical(int value) {
+      objref res = make_vector(ot::logical, 1);
+      res->data<int>()[0] = value;
+      return res;
+    }
+
+    static objref make_integer(int value) {
+      objref res = make_vector(ot::integer, 1);
+      res->data<int>()[0] = value;
+      return res;
+    }
+
+    static objref make_real(double value) {
+      objref res = make_vector(ot::real, 1);
+      res->data<double>()[0] = value;
+      return res;
+    }
+
+    static objref make_complex(double r, double i) {
+      objref res = make_vector(ot::complex, 1);
+      rcomplex value = { r, i };
+      res->data<rcomplex>()[0] = value;
+      return res;
+    }
+
+    static objref make_env(objref frame, objref enclos) {
+      return new obj(ot::env, frame, enclos);
+    }
+
+    static objref make_promise(objref expr, objref env) {
+      objref res = new obj(ot::promise, nullptr, expr);
+      res->promsxp.env = env;
+      return res;
+    }
+
+    static objref make_closure(objref formals, objref body, objref env) {
+      objref res = new obj(ot::closure, formals, body);
+      res->closxp.env = env;
+      return res;
+    }
+
+    // ot::builtin or ot::special.
+    static objref make_builtin(ot type, int offset) {
+      objref res = new obj(type);
+      res->listsxp.carval = nullptr;
+      res->primsxp.offset = offset;
+      return res;
+    }
+
+    static objref make_string(const char *str, size_t len) {
+      objref res = new (len + 1) obj(ot::chr);
+      memcpy(res->chr_data(), str, len);
+      res->chr_data()[len] = 0;
+      return res;
+    }
+
+    static objref make_string(const std::string &str) {
+      return make_string(str.data(), str.size());
+    }
+
+    // NA_character_: a string that is told apart from "NA" by its address, like R's NA_STRING.
+    static objref na_string();
+
+    // symbols are interned: one object per name.
+    static objref make_symbol(const char *str, size_t len);
+
+    static objref make_symbol(const std::string &str) {
+      return make_symbol(str.data(), str.size());
+    }
+
     bool isNull() const { return sxpinfo.type == ot::nil; }
     bool isSymbol() const { return sxpinfo.type == ot::symbol; }
     bool isLogical() const { return sxpinfo.type == ot::logical; }
@@ -236,12 +484,18 @@ namespace little_r {
       if (this == nullptr) return os << "<nullptr>";
       switch (type()) {
         case ot::nil: return os << "NULL";
+        case ot::closure: return os << "<closure>";
+        case ot::env: return os << "<environment>";
+        case ot::bytecode: return os << "<bytecode>";
+        case ot::promise: return os << "<promise>";
+        case ot::builtin: case ot::special: return os << "<builtin " << prim_offset() << ">";
+        case ot::chr: return this == na_string() ? os << "NA" : os << "\"" << chr_data() << "\"";
         case ot::symbol: return os << "`" << chr_data() << "\'";
         case ot::list: {
           os << "[";
           for (const obj *p = this; p != null_const(); p = p->tail()) {
-            os << *head();
-            if (tag() != nullptr) os << "(t=" << *tag() << ")";
+            os << *p->head();
+            if (p->tag() != null_const()) os << "(t=" << *p->tag() << ")";
             if (p->tail() != null_const()) os << ", ";
           }
           return os << "]";
@@ -249,19 +503,102 @@ namespace little_r {
         case ot::lang: {
           os << "[L ";
           for (const obj *p = this; p != null_const(); p = p->tail()) {
-            os << *head();
-            if (tag() != nullptr) os << "+" << *tag();
+            os << *p->head();
+            if (p->tag() != null_const()) os << "+" << *p->tag();
             if (p->tail() != null_const()) os << ", ";
           }
           return os << "]";
         }
+        case ot::logical: case ot::integer: case ot::real: case ot::complex: case ot::raw: {
+          for (size_t i = 0; i != length(); ++i) {
+            if (i) os << " ";
+            dump_element(os, i);
+          }
+          return os;
+        }
+        case ot::vec: {
+          os << "list(";
+          for (size_t i = 0; i != length(); ++i) {
+            if (i) os << ", ";
+            os << *elt(i);
+          }
+          return os << ")";
+        }
         default: return os << "[" << object_names[(int)type()] << " " << *head() << ", " << *tail() << "]";
       }
     }
 
 protected:
+    // R's spelling: TRUE, 2L, 1.5, 0+1i and NA.
+    void dump_element(std::ostream &os, size_t i) const {
+      switch (type()) {
+        case ot::logical: {
+          int value = data<int>()[i];
+          os << (value == na_logical ? "NA" : value ? "TRUE" : "FALSE");
+          break;
+        }
+        case ot::integer: {
+          int value = data<int>()[i];
+          if (value == na_integer) os << "NA"; else os << value << "L";
+          break;
+        }
+        case ot::real: {
+          dump_real(os, data<double>()[i]);
+          break;
+        }
+        case ot::raw: {
+          static const char hex[] = "0123456789abcdef";
+          rbyte value = data<rbyte>()[i];
+          os << hex[value >> 4] << hex[value & 15];
+          break;
+        }
+        case ot::complex: {
+          rcomplex value = data<rcomplex>()[i];
+          if (is_na(value.r) || is_na(value.i)) {
+            os << "NA";
+          } else {
+            dump_real(os, value.r);
+            if (!(value.i < 0)) os << "+";
+            dump_real(os, value.i);
+            os << "i";
+          }
+          break;
+        }
+        default: assert(!"dump_element of a type that isn't atomic"); break;
+      }
+    }
+
+    char *aligned_data(size_t capacity_bytes) const {
+      uintptr_t res = (uintptr_t)this + sizeof(obj);
+      if (capacity_bytes >= vector_align) res = (res + vector_align - 1) & ~(uintptr_t)(vector_align - 1);
+      return (char*)res;
+    }
+
+    static void dump_real(std::ostream &os, double value) {
+      if (is_na(value)) os << "NA";
+      else if (value != value) os << "NaN";
+      else if (value - value != 0) os << (value < 0 ? "-Inf" : "Inf");
+      else os << value;
+    }
+
+    friend class heap;
+    friend class symbol_table;
+
+    void barrier(objref value);
+    void make_permanent();
+
+    // the gc fields were filled in by operator new and are kept.
     void init(ot type, objref head, objref tail) {
-      memset((SEXPREC*)this, 0, sizeof(SEXPREC));
+      sxpinfo_struct info = sxpinfo_struct();
+      info.type = type;
+      info.gcgen = sxpinfo.gcgen;
+      info.gccls = sxpinfo.gccls;
+      sxpinfo = info;
+      SEXPREC::attrib = null_const();
+      memset(&listsxp, 0, sizeof(SEXPREC) - offsetof(SEXPREC, listsxp));
+      listsxp.carval = head;
+      listsxp.cdrval = tail;
+      listsxp.tagval = null_const();
     }
   };
 
@@ -270,6 +607,64 @@ protected:
     return os;
   }
 
+  // Builds a list front to back, keeping the last cell so that each element is O(1).
+  //
+  // The first cell gets its own type so that ot::lang calls can be built.
+  // reserve(n) makes n cells side by side in the heap and links them on the end, to be
+  // filled by push_back. They stay reachable from the first cell, so protecting that
+  // protects them, and result() cuts off any that were not used.
+  class list_builder {
+  public:
+    list_builder(ot first = ot::list, ot rest = ot::list) :
+      first_(first), rest_(rest), head_(obj::null_const()), last_(nullptr), end_(nullptr) {
+    }
+
+    // room for n more elements.
+    void reserve(size_t n);
+
+    objref push_back(objref value, objref tag = obj::null_const()) {
+      objref cell;
+      if (last_ != end_) {
+        cell = last_ ? last_->tail() : head_;
+        cell->set_head(value);
+      } else {
+        cell = new obj(rest_, value);
+        if (end_) end_->set_tail(cell); else head_ = cell;
+        end_ = cell;
+      }
+      if (cell == head_) cell->set_type(first_);
+      if (tag != obj::null_const()) cell->set_tag(tag);
+      last_ = cell;
+      return cell;
+    }
+
+    bool empty() const { return last_ == nullptr; }
+
+    // the first cell, which may be a reserved one, for protecting the list while it is built.
+    objref head() const { return head_; }
+    obj **root() { return &head_; }
+
+    // the list. more elements can still be pushed after this.
+    objref result() {
+      if (!last_) return obj::null_const();
+      if (last_ != end_) {
+        last_->set_tail(obj::null_const());
+        end_ = last_;
+      }
+      return head_;
+    }
+
+  private:
+    ot first_;
+    ot rest_;
+    objref head_;
+    objref last_;
+    objref end_;
+  };
+
 }
 
+#include "heap.hpp"
+#include "symbols.hpp"
+
 #endif
@@ -0,0 +1,274 @@
+#ifndef PARALLEL_LEXER_HPP
+#define PARALLEL_LEXER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "lexer.hpp"
+
+namespace little_r {
+  // Lexes one big source on several threads and gives the same tokens as the lexer.
+  //
+  // The source is cut into segments just after newlines, preferring ones that start an
+  // unindented line. A segment can't know what came before it, so it guesses: it is lexed
+  // from its start as code and, for each of ' " and `, from just after the first
+  // unescaped quote as if it began inside a string. A comment never runs past a newline
+  // so there is nothing to guess for those. A guess stops as soon as it reaches the end
+  // of a token of an earlier guess, as from there on they are the same.
+  //
+  // Between tokens the lexer only depends on where it is, so the segments are stitched by
+  // following the end of the last token taken: the guess that has a token ending there
+  // is the right one from then on. If none has, that segment is lexed again from there.
+  // The chunks of the guesses are used in place.
+  class parallel_lexer : public token_source {
+  public:
+    static const size_t min_segment_size = 64 * 1024;
+
+    parallel_lexer(const char *src, size_t size, unsigned num_threads, size_t min_segment = min_segment_size) :
+      src_(src), size_(size), num_segments_(0), num_fallbacks_(0)
+    {
+      if (size > UINT32_MAX - 1) throw std::runtime_error("source is too big for a token buffer");
+      split(num_threads ? num_threads : 1, min_segment ? min_segment : 1);
+
+      std::atomic<size_t> next(0);
+      std::vector<std::exception_ptr> errors(segments_.size());
+      auto work = [&]() {
+        for (size_t i = next++; i < segments_.size(); i = next++) {
+          try {
+            lex_segment(i);
+          } catch (...) {
+            errors[i] = std::current_exception();
+          }
+        }
+      };
+      std::vector<std::thread> threads;
+      for (unsigned i = 1; i < num_threads && i < segments_.size(); ++i) {
+        threads.emplace_back(work);
+      }
+      work();
+      for (auto &t : threads) t.join();
+      for (auto &e : errors) {
+        if (e) std::rethrow_exception(e);
+      }
+
+      num_segments_ = segments_.size();
+      stitch();
+    }
+
+    parallel_lexer(const parallel_lexer &) = delete;
+    parallel_lexer &operator=(const parallel_lexer &) = delete;
+
+    const token_chunk *chunk(size_t i) override {
+      return chunks_[i].get();
+    }
+
+    size_t num_segments() const { return num_segments_; }
+
+    // segments where no guess was right.
+    size_t num_fallbacks() const { return num_fallbacks_; }
+
+  private:
+    // the tokens lexed from one start, in full chunks but for the last.
+    struct run {
+      uint32_t start;
+      std::vector<std::unique_ptr<token_chunk> > chunks;
+      size_t size = 0;
+      int join_run = -1;
+      size_t join_token = 0;
+
+      const token_chunk &chunk(size_t i) const { return *chunks[i / token_chunk::capacity]; }
+
+      uint32_t end(size_t i) const {
+        const token_chunk &c = chunk(i);
+        size_t j = i % token_chunk::capacity;
+        return c.offsets[j] + c.lengths[j];
+      }
+
+      // the token that ends at pos, or size.
+      size_t find_end(uint32_t pos) const {
+        size_t lo = 0, hi = size;
+        while (lo != hi) {
+          size_t mid = (lo + hi) / 2;
+          if (end(mid) < pos) {
+            lo = mid + 1;
+          } else {
+            hi = mid;
+          }
+        }
+        return lo != size && end(lo) == pos ? lo : size;
+      }
+    };
+
+    // tokens that start in [begin, limit) belong to the segment.
+    struct segment {
+      uint32_t begin;
+      uint32_t limit;
+      std::vector<run> runs;
+    };
+
+    static bool is_blank(char c) {
+      return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f';
+    }
+
+    void split(unsigned num_threads, size_t min_segment) {
+      size_t n = size_ / min_segment;
+      if (n > num_threads) n = num_threads;
+      if (n == 0) n = 1;
+      size_t begin = 0;
+      for (size_t i = 1; i < n; ++i) {
+        size_t target = size_ * i / n;
+        if (target <= begin) continue;
+        size_t b = line_start(target);
+        if (b == size_) break;
+        if (b <= begin) continue;
+        add_segment(begin, b);
+        begin = b;
+      }
+      add_segment(begin, size_ + 1);
+    }
+
+    // the first line after target that starts with something other than a space, or failing
+    // that the first line at all.
+    size_t line_start(size_t target) const {
+      const size_t window = 4096;
+      size_t first = size_;
+      for (size_t p = target; p < size_ && p < target + window; ++p) {
+        if (src_[p] != '\n') continue;
+        if (first == size_) first = p + 1;
+        if (p + 1 < size_ && !is_blank(src_[p + 1])) return p + 1;
+      }
+      if (first != size_) return first;
+      for (size_t p = target + window; p < size_; ++p) {
+        if (src_[p] == '\n') return p + 1 < size_ ? p + 1 : size_;
+      }
+      return size_;
+    }
+
+    void add_segment(size_t begin, size_t limit) {
+      segment s;
+      s.begin = (uint32_t)begin;
+      s.limit = (uint32_t)limit;
+      segments_.push_back(std::move(s));
+    }
+
+    // just after the first quote that is not escaped, as if [begin, limit) started in a string.
+    size_t after_quote(size_t begin, size_t limit, char quote) const {
+      for (size_t p = begin; p < limit && p < size_; ++p) {
+        if (src_[p] == '\\') {
+          ++p;
+        } else if (src_[p] == quote) {
+          return p + 1;
+        }
+      }
+      return size_ + 1;
+    }
+
+    void lex_segment(size_t i) {
+      segment &s = segments_[i];
+      lexer lex(src_, size_);
+      add_run(lex, s, s.begin);
+      if (i == 0) return;
+      for (char quote : { '\'', '"', '`' }) {
+        size_t start = after_quote(s.begin, s.limit, quote);
+        if (start < s.limit) add_run(lex, s, start);
+      }
+    }
+
+    // lex from start to the limit of the segment, or until the run joins an earlier one.
+    void add_run(lexer &lex, segment &s, size_t start) {
+      s.runs.push_back(run());
+      run &r = s.runs.back();
+      size_t num_earlier = s.runs.size() - 1;
+      std::vector<size_t> cursors(num_earlier, 0);
+      r.start = (uint32_t)start;
+      lex.seek(start);
+      for (;;) {
+        if (r.chunks.empty() || r.chunks.back()->size == token_chunk::capacity) {
+          r.chunks.emplace_back(new token_chunk());
+        }
+        token_chunk &c = *r.chunks.back();
+        tt tok = lex.lex_token(c);
+        size_t j = c.size - 1;
+        if (c.offsets[j] >= s.limit) {
+          if (c.values[j]) c.literals.pop_back();
+          --c.size;
+          return;
+        }
+        ++r.size;
+        if (tok == tt::end_of_input) return;
+        uint32_t end = c.offsets[j] + c.lengths[j];
+        for (size_t k = 0; k != num_earlier; ++k) {
+          const run &other = s.runs[k];
+          size_t &pos = cursors[k];
+          while (pos != other.size && other.end(pos) < end) ++pos;
+          if (pos != other.size && other.end(pos) == end) {
+            r.join_run = (int)k;
+            r.join_token = pos + 1;
+            return;
+          }
+        }
+      }
+    }
+
+    // follow the serial lexer through the segments and keep the tokens it would have made.
+    void stitch() {
+      uint32_t resume = 0;
+      for (size_t i = 0; i != segments_.size(); ++i) {
+        segment &s = segments_[i];
+        if (resume >= s.limit) continue;
+        int r = -1;
+        size_t from = 0;
+        for (size_t k = 0; k != s.runs.size() && r < 0; ++k) {
+          if (s.runs[k].start == resume) {
+            r = (int)k;
+            from = 0;
+          } else if ((from = s.runs[k].find_end(resume)) != s.runs[k].size) {
+            r = (int)k;
+            ++from;
+          }
+        }
+        if (r < 0) {
+          ++num_fallbacks_;
+          lexer lex(src_, size_);
+          add_run(lex, s, resume);
+          r = (int)s.runs.size() - 1;
+          from = 0;
+        }
+        for (;;) {
+          run &ru = s.runs[r];
+          if (ru.size > from) resume = ru.end(ru.size - 1);
+          take(ru, from, ru.size);
+          if (ru.join_run < 0) break;
+          from = ru.join_token;
+          r = ru.join_run;
+        }
+      }
+      segments_.clear();
+    }
+
+    // tokens [from, to) of a run go on the end of the stream.
+    void take(run &r, size_t from, size_t to) {
+      for (size_t i = from / token_chunk::capacity; i < r.chunks.size() && i * token_chunk::capacity < to; ++i) {
+        std::unique_ptr<token_chunk> &c = r.chunks[i];
+        size_t base = i * token_chunk::capacity;
+        c->begin = from > base ? from - base : 0;
+        if (to - base < c->size) c->size = to - base;
+        if (c->begin < c->size) chunks_.push_back(std::move(c));
+      }
+    }
+
+    const char *src_;
+    size_t size_;
+    size_t num_segments_;
+    size_t num_fallbacks_;
+    std::vector<segment> segments_;
+    std::vector<std::unique_ptr<token_chunk> > chunks_;
+  };
+}
+
+#endif
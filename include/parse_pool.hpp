@@ -0,0 +1,156 @@
+#ifndef PARSE_POOL_HPP
+#define PARSE_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "heap.hpp"
+#include "mapped_file.hpp"
+#include "parser.hpp"
+
+namespace little_r {
+  // one source file parsed by a parse_pool.
+  struct parsed_file {
+    std::string path;
+    size_t bytes = 0;
+    objref exprs = nullptr;
+    size_t num_errors = 0;
+    std::string first_error;
+  };
+
+  // Parses many source files at once, such as the files of a package.
+  //
+  // The files are sorted largest first and dealt out in turn to the workers' queues, so
+  // every worker starts on a big file. A worker takes from the front of its own queue and,
+  // when that is empty, steals from the back of another's, where the small files are.
+  // Each worker parses into a heap of its own. Symbols are interned in the global
+  // symbol_table, which any thread can use, so every tree shares one symbol per name.
+  //
+  // The trees live in the pool's heaps: keep the pool for as long as they are used.
+  class parse_pool {
+  public:
+    parse_pool(const std::vector<std::string> &paths, unsigned num_threads = std::thread::hardware_concurrency()) :
+      num_steals_(0)
+    {
+      if (num_threads == 0) num_threads = 1;
+      if (num_threads > paths.size()) num_threads = paths.size() ? (unsigned)paths.size() : 1;
+
+      files_.resize(paths.size());
+      std::vector<size_t> order(paths.size());
+      for (size_t i = 0; i != paths.size(); ++i) {
+        files_[i].path = paths[i];
+        files_[i].bytes = file_size(paths[i]);
+        order[i] = i;
+      }
+      std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return files_[a].bytes > files_[b].bytes; });
+
+      for (unsigned i = 0; i != num_threads; ++i) {
+        workers_.emplace_back(new worker());
+      }
+      for (size_t i = 0; i != order.size(); ++i) {
+        workers_[i % num_threads]->queue.push_back(order[i]);
+      }
+
+      std::vector<std::exception_ptr> errors(num_threads);
+      std::vector<std::thread> threads;
+      for (unsigned i = 1; i < num_threads; ++i) {
+        threads.emplace_back([this, i, &errors]() { work(i, errors[i]); });
+      }
+      work(0, errors[0]);
+      for (auto &t : threads) t.join();
+      for (auto &e : errors) {
+        if (e) std::rethrow_exception(e);
+      }
+    }
+
+    ~parse_pool() {
+      for (auto &w : workers_) {
+        for (objref *root : w->roots) w->arena.remove_root(root);
+      }
+    }
+
+    parse_pool(const parse_pool &) = delete;
+    parse_pool &operator=(const parse_pool &) = delete;
+
+    // in the order of the paths given.
+    const std::vector<parsed_file> &files() const { return files_; }
+
+    size_t num_threads() const { return workers_.size(); }
+
+    // files parsed by a worker other than the one they were dealt to.
+    size_t num_steals() const { return num_steals_.load(std::memory_order_relaxed); }
+
+  private:
+    struct worker {
+      std::mutex mutex;
+      std::deque<size_t> queue;
+      heap arena;
+      std::vector<objref *> roots;
+    };
+
+    static size_t file_size(const std::string &path) {
+      std::ifstream is(path, std::ios::binary | std::ios::ate);
+      return is ? (size_t)is.tellg() : 0;
+    }
+
+    // the next file for worker w, from its own queue or stolen from the others.
+    bool next_file(unsigned w, size_t &file) {
+      {
+        worker &own = *workers_[w];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.queue.empty()) {
+          file = own.queue.front();
+          own.queue.pop_front();
+          return true;
+        }
+      }
+      for (size_t i = 1; i != workers_.size(); ++i) {
+        worker &victim = *workers_[(w + i) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.queue.empty()) {
+          file = victim.queue.back();
+          victim.queue.pop_back();
+          num_steals_.fetch_add(1, std::memory_order_relaxed);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // files are never added, so a worker that finds every queue empty is done.
+    // after an error the worker stops and leaves its files to the others.
+    void work(unsigned w, std::exception_ptr &error) {
+      worker &self = *workers_[w];
+      heap::scope scope(self.arena);
+      try {
+        for (size_t i; next_file(w, i); ) {
+          parsed_file &f = files_[i];
+          mapped_file src(f.path);
+          parser p(src);
+          f.bytes = src.size();
+          f.exprs = p.exprs();
+          f.num_errors = p.num_errors();
+          f.first_error = p.first_error();
+          self.arena.add_root(&f.exprs);
+          self.roots.push_back(&f.exprs);
+        }
+      } catch (...) {
+        error = std::current_exception();
+      }
+    }
+
+    std::vector<parsed_file> files_;
+    std::vector<std::unique_ptr<worker> > workers_;
+    std::atomic<size_t> num_steals_;
+  };
+}
+
+#endif
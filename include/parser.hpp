@@ -1,27 +1,131 @@
-
 #ifndef PARSER_HPP
 #define PARSER_HPP
 
 #include "lexer.hpp"
 #include "objects.hpp"
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 namespace little_r {
 
   class parser : public lexer {
   public:
-    parser(std::wistream &istr) : lexer(istr) {
+    parser(std::istream &istr, trace_sink *sink = nullptr) : lexer(istr) {
+      run(sink);
+    }
+
+    parser(const char *src, size_t size, trace_sink *sink = nullptr) : lexer(src, size) {
+      run(sink);
+    }
+
+    parser(const mapped_file &file, trace_sink *sink = nullptr) : lexer(file) {
+      run(sink);
+    }
+
+    // the tokens come from a token_buffer or other source made from the same text.
+    parser(const char *src, size_t size, token_source &tokens, trace_sink *sink = nullptr) : lexer(src, size, tokens) {
+      run(sink);
+    }
+
+    ~parser() {
+      heap_.remove_root(exprs_.root());
+    }
+
+    // the top level expressions as a pairlist.
+    obj *exprs() const { return exprs_.head(); }
+
+    // top level expressions that were skipped because of a syntax error.
+    size_t num_errors() const { return num_errors_; }
+    const std::string &first_error() const { return first_error_; }
+
+    // the last expression ran into the end of the source, so more text could finish it.
+    bool incomplete() const { return incomplete_; }
+    size_t incomplete_offset() const { return incomplete_offset_; }
+
+  private:
+    // the state of one expression: it stops at operators that bind no tighter than
+    // min_precedence, and a non-associative operator can't follow one of its own level.
+    struct level {
+      int min_precedence;
+      bool allow_assign;
+      int prev_precedence;
+    };
+
+    // where an expression is nested in the one that is waiting for it.
+    enum class step : uint8_t {
+      paren,            // '(' expr ')'
+      unary,            // '-' expr
+      binary,           // expr '+' expr
+      argument,         // expr '(' expr or SYMBOL EQ_ASSIGN expr
+      argument_value,   // the expr after SYMBOL EQ_ASSIGN
+      formal,           // FUNCTION '(' SYMBOL EQ_ASSIGN expr
+      body,             // FUNCTION '(' formlist ')' expr
+      statement,        // '{' exprlist
+      if_cond,
+      if_stmt,
+      if_else,
+      for_seq,
+      for_body,
+      while_cond,
+      while_body,
+      repeat_body,
+    };
+
+    // an expression waiting for one inside it, with what it has parsed so far.
+    // in_brackets is restored when it is popped.
+    struct frame {
+      step kind;
+      tt op;
+      tt lhs_tok;
+      bool in_brackets;
+      level outer;
+      obj *sym;
+      obj *a;
+      obj *b;
+      list_builder list;
+    };
+
+    void run(trace_sink *sink) {
+      in_brackets_ = false;
+      num_errors_ = 0;
+      incomplete_ = false;
+      incomplete_offset_ = 0;
+      heap_.add_root(exprs_.root());
+      set_trace(sink);
       next();
       prog();
     }
-  private:
+
+    // a syntax error skips the rest of the line and carries on with the next expression.
     void prog() {
       for(;;) {
-        if (tok() == tt::error) break;
+        while (tok() == tt::newline || tok() == tt::semicolon) {
+          next();
+        }
         if (tok() == tt::end_of_input) break;
-        obj *e = expr(0);
-        e->dump(std::cout);
+        size_t start = offset();
+        try {
+          obj *e = expr(0);
+          if (tok() != tt::newline && tok() != tt::semicolon && tok() != tt::end_of_input) {
+            error("unexpected");
+          }
+          exprs_.push_back(e);
+        } catch (std::runtime_error &e) {
+          if (num_errors_++ == 0) first_error_ = e.what();
+          in_brackets_ = false;
+          brace_depth_ = 0;
+          if (tok() == tt::end_of_input || (tok() == tt::error && at_end())) {
+            incomplete_ = true;
+            incomplete_offset_ = start;
+          }
+          while (tok() != tt::newline && tok() != tt::end_of_input) {
+            next();
+          }
+        }
+        heap_.safepoint();
       }
     }
 
@@ -67,12 +171,14 @@ namespace little_r {
         // 260 %left		UMINUS UPLUS
         case tt::uminus: case tt::uplus: return 260;
         // 270 %right		'^'
-        case tt::caret: return 270;
+        case tt::caret: case tt::star2: return 270;
         // 280 %left		'$' '@'
-        case tt::dollar: return 280;
+        case tt::dollar: case tt::at: return 280;
         // 290 %left		NS_GET NS_GET_INT
         case tt::ns_get: return 280;
         case tt::ns_get_int: return 290;
+        // 300 %nonassoc	'(' '[' LBB
+        case tt::lparen: case tt::lbracket: case tt::lbb: return 300;
       }
       return 0;
     }
@@ -91,7 +197,9 @@ namespace little_r {
         // 270 %right		'^'
         case tt::if_:
         case tt::left_assign:
-        case tt::eq_assign: {
+        case tt::eq_assign:
+        case tt::caret:
+        case tt::star2: {
           return grouping::right;
         }
 
@@ -105,330 +213,750 @@ namespace little_r {
       }
     }
 
-    obj *expr(int min_precedence=0, bool allow_assign=true) {
-      obj *result = obj::null_const();
-
-      push_debug("expr");
-      indent(); printf("min_precedence=%d\n", min_precedence);
+    // keywords have a precedence in the grammar but are not binary operators.
+    static bool is_keyword(tt sym) {
+      return sym == tt::while_ || sym == tt::for_ || sym == tt::repeat || sym == tt::if_ || sym == tt::else_ || sym == tt::not_;
+    }
 
-      // skip newlines
+    void skip_newlines() {
       while (tok() == tt::newline) {
         next();
       }
+    }
 
-      switch (tok()) {
-        //expr	: 	NUM_CONST			{ $$ = $1;	setId( $$, @$); }
-        // |	STR_CONST			{ $$ = $1;	setId( $$, @$); }
-        // |	NULL_CONST			{ $$ = $1;	setId( $$, @$); }          
-        // |	SYMBOL				{ $$ = $1;	setId( $$, @$); }
-        // |	SYMBOL NS_GET SYMBOL		{ $$ = xxbinary($2,$1,$3);      setId( $$, @$); modif_token( &@1, SYMBOL_PACKAGE ) ; }
-        // |	SYMBOL NS_GET STR_CONST		{ $$ = xxbinary($2,$1,$3);      setId( $$, @$); modif_token( &@1, SYMBOL_PACKAGE ) ; }
-        // |	STR_CONST NS_GET SYMBOL		{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-        // |	STR_CONST NS_GET STR_CONST	{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-        // |	SYMBOL NS_GET_INT SYMBOL	{ $$ = xxbinary($2,$1,$3);      setId( $$, @$); modif_token( &@1, SYMBOL_PACKAGE ) ;}
-        // |	SYMBOL NS_GET_INT STR_CONST	{ $$ = xxbinary($2,$1,$3);      setId( $$, @$); modif_token( &@1, SYMBOL_PACKAGE ) ;}
-        // |	STR_CONST NS_GET_INT SYMBOL	{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-        // |	STR_CONST NS_GET_INT STR_CONST	{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-        case tt::num_const:
-        case tt::str_const:
-        case tt::null_const:
-        case tt::symbol: {
-          result = value();
-          next();
-          if (tok() == tt::ns_get || tok() == tt::ns_get_int) {
+    // operators and keywords are only spelled one or two ways, so the symbol last made for
+    // each kind of token is kept rather than hashing the name again.
+    obj *current_symbol() {
+      obj *&sym = symbols_[(unsigned)tok()];
+      if (!sym || strncmp(sym->chr_data(), text(), length()) != 0 || sym->chr_data()[length()] != 0) {
+        sym = obj::make_symbol(text(), length());
+      }
+      return sym;
+    }
+
+    // R_MissingArg: the empty symbol.
+    static obj *missing_arg() {
+      static obj *const sym = obj::make_symbol("", 0);
+      return sym;
+    }
+
+    // precedence climbing without recursion. an expression that contains another, like the
+    // right hand side of an operator or the arguments of a call, leaves a frame on stack_
+    // and starts the inner one at "operand". when the inner one is done the frame is
+    // finished off, so nesting is only limited by memory. the state of the current level
+    // is kept in locals and the parts of the grammar are joined by gotos.
+    obj *expr(int min_precedence=0, bool allow_assign=true) {
+      size_t base = num_frames_;
+      bool in_brackets = in_brackets_;
+      unsigned open = 0;
+      obj *result = nullptr;
+      level lv = { min_precedence, allow_assign, 0 };
+      try {
+      operand:
+        trace_.enter("expr", lv.min_precedence, offset());
+        ++open;
+
+        // skip newlines
+        skip_newlines();
+
+        switch (tok()) {
+          //expr	: 	NUM_CONST			{ $$ = $1;	setId( $$, @$); }
+          // |	STR_CONST			{ $$ = $1;	setId( $$, @$); }
+          // |	NULL_CONST			{ $$ = $1;	setId( $$, @$); }
+          // |	SYMBOL				{ $$ = $1;	setId( $$, @$); }
+          // |	SYMBOL NS_GET SYMBOL		{ $$ = xxbinary($2,$1,$3);      setId( $$, @$); modif_token( &@1, SYMBOL_PACKAGE ) ; }
+          // |	SYMBOL NS_GET STR_CONST		{ $$ = xxbinary($2,$1,$3);      setId( $$, @$); modif_token( &@1, SYMBOL_PACKAGE ) ; }
+          // |	STR_CONST NS_GET SYMBOL		{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+          // |	STR_CONST NS_GET STR_CONST	{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+          // |	SYMBOL NS_GET_INT SYMBOL	{ $$ = xxbinary($2,$1,$3);      setId( $$, @$); modif_token( &@1, SYMBOL_PACKAGE ) ;}
+          // |	SYMBOL NS_GET_INT STR_CONST	{ $$ = xxbinary($2,$1,$3);      setId( $$, @$); modif_token( &@1, SYMBOL_PACKAGE ) ;}
+          // |	STR_CONST NS_GET_INT SYMBOL	{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+          // |	STR_CONST NS_GET_INT STR_CONST	{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+          case tt::num_const:
+          case tt::str_const:
+          case tt::null_const:
+          case tt::symbol: {
+            result = value();
+            bool is_name = tok() == tt::symbol || tok() == tt::str_const;
             next();
-            if (tok() == tt::symbol || tok() == tt::str_const) {
+            if (is_name && (tok() == tt::ns_get || tok() == tt::ns_get_int)) {
+              obj *sym = current_symbol();
+              next();
+              if (tok() != tt::symbol && tok() != tt::str_const) {
+                error("expected name after ::");
+              }
+              result = obj::make_list(ot::lang, sym, result, value());
               next();
             }
+            goto operators;
           }
-          break;
-        }
 
-        // |	'{' exprlist '}'		{ $$ = xxexprlist($1,&@1,$2); setId( $$, @$); }
-        case tt::lbrace: {
-          obj *sym = obj::make_symbol(id());
-          next();
-          result = new obj(ot::lang, sym, expr());
-          expect(tt::rbrace);
-          break;
-        }
+          case tt::dotdotdot: {
+            result = current_symbol();
+            next();
+            goto operators;
+          }
 
-        // |	'(' expr_or_assign ')'		{ $$ = xxparen($1,$2);	setId( $$, @$); }
-        case tt::lparen: {
-          obj *sym = obj::make_symbol(id());
-          next();
-          result = new obj(ot::lang, sym, expr());
-          expect(tt::rparen);
-          break;
-        }
+          // |	'{' exprlist '}'		{ $$ = xxexprlist($1,&@1,$2); setId( $$, @$); }
+          case tt::lbrace: {
+            frame &f = push(step::statement, lv);
+            f.list = list_builder(ot::lang);
+            f.list.push_back(current_symbol());
+            in_brackets_ = false;
+            ++brace_depth_;
+            next();
+            goto statements;
+          }
 
-        // |	'-' expr %prec UMINUS		{ $$ = xxunary($1,$2);	setId( $$, @$); }
-        case tt::minus: {
-          next();
-          result = expr(0);
-          //result = new expr(tt::minus, expr(0));
-          break;
-        }
+          // |	'(' expr_or_assign ')'		{ $$ = xxparen($1,$2);	setId( $$, @$); }
+          case tt::lparen: {
+            push(step::paren, lv).sym = current_symbol();
+            in_brackets_ = true;
+            next();
+            lv = { 0, true, 0 };
+            goto operand;
+          }
 
-        // |	'+' expr %prec UMINUS		{ $$ = xxunary($1,$2);	setId( $$, @$); }
-        case tt::plus: {
-          next();
-          //result = new expr(tt::minus, expr(0));
-          result = expr(0);
-          break;
-        }
+          // |	'-' expr %prec UMINUS		{ $$ = xxunary($1,$2);	setId( $$, @$); }
+          // |	'+' expr %prec UMINUS		{ $$ = xxunary($1,$2);	setId( $$, @$); }
+          // |	'!' expr %prec UNOT		{ $$ = xxunary($1,$2);	setId( $$, @$); }
+          // |	'~' expr %prec TILDE		{ $$ = xxunary($1,$2);	setId( $$, @$); }
+          // |	'?' expr			{ $$ = xxunary($1,$2);	setId( $$, @$); }
+          case tt::minus:
+          case tt::plus:
+          case tt::not_:
+          case tt::tilde:
+          case tt::question: {
+            int prec = get_precedence(tok() == tt::minus || tok() == tt::plus ? tt::uminus : tok());
+            push(step::unary, lv).sym = current_symbol();
+            next();
+            lv = { prec, true, 0 };
+            goto operand;
+          }
 
-        // |	'!' expr %prec UNOT		{ $$ = xxunary($1,$2);	setId( $$, @$); }
-        case tt::not_: {
-          next();
-          //result = new expr(tt::minus, expr(0));
-          result = expr(0);
-          break;
-        }
+          // |	FUNCTION '(' formlist ')' cr expr_or_assign %prec LOW
+          case tt::function: {
+            frame &f = push(step::formal, lv);
+            f.sym = current_symbol();
+            next();
+            in_brackets_ = true;
+            expect(tt::lparen);
+            f.list = list_builder();
+            skip_newlines();
+            goto formals;
+          }
 
-        // |	'~' expr %prec TILDE		{ $$ = xxunary($1,$2);	setId( $$, @$); }
-        case tt::tilde: {
-          next();
-          //result = new expr(tt::minus, expr(0));
-          result = expr(0);
-          break;
+          // |	IF ifcond expr_or_assign 	{ $$ = xxif($1,$2,$3);	setId( $$, @$); }
+          // |	IF ifcond expr_or_assign ELSE expr_or_assign	{ $$ = xxifelse($1,$2,$3,$5);	setId( $$, @$); }
+          // |	WHILE cond expr_or_assign	{ $$ = xxwhile($1,$2,$3);	setId( $$, @$); }
+          // cond	:	'(' expr_or_help ')'
+          // ifcond	:	'(' expr_or_help ')'
+          case tt::if_:
+          case tt::while_: {
+            push(tok() == tt::if_ ? step::if_cond : step::while_cond, lv).sym = current_symbol();
+            next();
+            in_brackets_ = true;
+            expect(tt::lparen);
+            lv = { 0, true, 0 };
+            goto operand;
+          }
+          // |	FOR forcond expr_or_assign %prec FOR 	{ $$ = xxfor($1,$2,$3);	setId( $$, @$); }
+          case tt::for_: {
+            frame &f = push(step::for_seq, lv);
+            f.sym = current_symbol();
+            next();
+            in_brackets_ = true;
+            expect(tt::lparen);
+            if (tok() != tt::symbol) error("expected symbol in for");
+            f.a = value();
+            next();
+            expect(tt::in);
+            lv = { 0, true, 0 };
+            goto operand;
+          }
+          // |	REPEAT expr_or_assign			{ $$ = xxrepeat($1,$2);	setId( $$, @$); }
+          case tt::repeat: {
+            push(step::repeat_body, lv).sym = current_symbol();
+            next();
+            lv = { 0, true, 0 };
+            goto operand;
+          }
+          // |	NEXT				{ $$ = xxnxtbrk($1);	setId( $$, @$); }
+          // |	BREAK				{ $$ = xxnxtbrk($1);	setId( $$, @$); }
+          case tt::next:
+          case tt::break_: {
+            result = obj::make_list(ot::lang, current_symbol());
+            next();
+            goto operators;
+          }
+          // ;
+
+          default: {
+            error("expected expression");
+          }
         }
 
-        // |	'?' expr			{ $$ = xxunary($1,$2);	setId( $$, @$); }
-        case tt::question: {
+      operators:
+        for(;;) {
+          if (in_brackets_) skip_newlines();
+
+          tt op = tok();
+          int prec = get_precedence(op);
+          if (prec == 0 || prec <= lv.min_precedence || is_keyword(op)) break;
+          if (op == tt::eq_assign && !lv.allow_assign) break;
+
+          grouping gr = get_grouping(op);
+          if (gr == grouping::noassoc && prec == lv.prev_precedence) break;
+          lv.prev_precedence = prec;
+
+          obj *sym = binary_symbol(op);
+
+          switch (op) {
+            // |	expr '(' sublist ')'		{ $$ = xxfuncall($1,$3);  setId( $$, @$); modif_token( &@1, SYMBOL_FUNCTION_CALL ) ; }
+            // |	expr LBB sublist ']' ']'	{ $$ = xxsubscript($1,$2,$3);	setId( $$, @$); }
+            // |	expr '[' sublist ']'		{ $$ = xxsubscript($1,$2,$3);	setId( $$, @$); }
+            case tt::lparen:
+            case tt::lbracket:
+            case tt::lbb: {
+              frame &f = push(step::argument, lv);
+              f.op = op;
+              f.sym = sym;
+              f.a = result;
+              f.list = list_builder();
+              in_brackets_ = true;
+              next();
+              skip_newlines();
+              if (tok() == close_of(f)) {
+                result = obj::null_const();
+                goto end_arguments;
+              }
+              goto arguments;
+            }
+            // |	expr '$' SYMBOL			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+            // |	expr '$' STR_CONST		{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+            // |	expr '@' SYMBOL			{ $$ = xxbinary($2,$1,$3);      setId( $$, @$); modif_token( &@3, SLOT ) ; }
+            // |	expr '@' STR_CONST		{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+            case tt::dollar:
+            case tt::at: {
+              next();
+              skip_newlines();
+              if (tok() != tt::symbol && tok() != tt::str_const && tok() != tt::dotdotdot) {
+                error("expected name after $ or @");
+              }
+              result = obj::make_list(ot::lang, sym, result, tok() == tt::dotdotdot ? current_symbol() : value());
+              next();
+              continue;
+            }
+          }
+
           next();
-          //result = new expr(tt::minus, expr(0));
-          result = expr(0);
-          break;
+
+          // left grouping operators will parse like ( ( a + b ) + c ) + d    so rhs will accept fewer tokens
+          // right grouping operators will parse like a = ( b = ( c = d ) )   so rhs will accept more tokens
+          frame &f = push(step::binary, lv);
+          f.op = op;
+          f.sym = sym;
+          f.a = result;
+          lv = { prec - (gr == grouping::right ? 1 : 0), true, 0 };
+          goto operand;
         }
 
-        // |	FUNCTION '(' formlist ')' cr expr_or_assign %prec LOW
-        case tt::function: {
-          next();
-          expect(tt::lparen);
-          while (tok() != tt::rparen) {
-            next();
-          }
-          expect(tt::rparen);
-          while (tok() == tt::newline) {
-            next();
+        // the expression is complete: give it to the frame that was waiting for it.
+        trace_.leave("expr", offset());
+        --open;
+        if (num_frames_ == base) return result;
+        {
+          frame &f = top();
+          switch (f.kind) {
+            case step::paren: {
+              result = obj::make_list(ot::lang, f.sym, result);
+              skip_newlines();
+              expect(tt::rparen);
+              pop(lv);
+              goto operators;
+            }
+
+            case step::unary: {
+              result = obj::make_list(ot::lang, f.sym, result);
+              pop(lv);
+              goto operators;
+            }
+
+            case step::binary: {
+              switch (f.op) {
+                // |	expr ':'  expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr '+'  expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr '-' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr '*' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr '/' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr '^' expr 			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr SPECIAL expr		{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr '%' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr '~' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr '?' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr LT expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr LE expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr EQ expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr NE expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr GE expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr GT expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr AND expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr OR expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr AND2 expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr OR2 expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                // |	expr LEFT_ASSIGN expr 		{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
+                case tt::colon:
+                case tt::plus:
+                case tt::minus:
+                case tt::star:
+                case tt::divide:
+                case tt::caret:
+                case tt::star2:
+                case tt::special:
+                case tt::modulus:
+                case tt::tilde:
+                case tt::question:
+                case tt::lt: case tt::le: case tt::eq:
+                case tt::ne: case tt::ge: case tt::gt:
+                case tt::and_:
+                case tt::or_:
+                case tt::and2:
+                case tt::or2:
+                case tt::left_assign:
+                case tt::eq_assign:
+                {
+                  result = obj::make_list(ot::lang, f.sym, f.a, result);
+                  break;
+                }
+
+                // |	expr RIGHT_ASSIGN expr 		{ $$ = xxbinary($2,$3,$1);	setId( $$, @$); }
+                case tt::right_assign: {
+                  result = obj::make_list(ot::lang, f.sym, result, f.a);
+                  break;
+                }
+
+                default: {
+                  error("expected operator");
+                }
+              }
+              pop(lv);
+              goto operators;
+            }
+
+            case step::argument: {
+              goto argument;
+            }
+
+            case step::argument_value: {
+              f.list.push_back(result, f.b);
+              f.kind = step::argument;
+              goto after_argument;
+            }
+
+            case step::formal: {
+              f.list.push_back(result, f.b);
+              goto after_formal;
+            }
+
+            case step::body: {
+              result = obj::make_list(ot::lang, f.sym, f.a, result, obj::null_const());
+              pop(lv);
+              goto operators;
+            }
+
+            case step::statement: {
+              f.list.push_back(result);
+              if (tok() != tt::newline && tok() != tt::semicolon && tok() != tt::rbrace) {
+                error("expected newline, ';' or '}'");
+              }
+              goto statements;
+            }
+
+            case step::if_cond:
+            case step::while_cond: {
+              f.a = result;
+              skip_newlines();
+              expect(tt::rparen);
+              in_brackets_ = f.in_brackets;
+              f.kind = f.kind == step::if_cond ? step::if_stmt : step::while_body;
+              lv = { 0, true, 0 };
+              goto operand;
+            }
+
+            case step::if_stmt: {
+              f.b = result;
+
+              // inside braces or brackets, else may be on the next line.
+              if (tok() == tt::newline && in_braces_or_brackets()) {
+                state s = save();
+                skip_newlines();
+                if (tok() != tt::else_) restore(s);
+              }
+
+              if (tok() == tt::else_) {
+                next();
+                f.kind = step::if_else;
+                lv = { 0, true, 0 };
+                goto operand;
+              }
+              result = obj::make_list(ot::lang, f.sym, f.a, f.b);
+              pop(lv);
+              goto operators;
+            }
+
+            case step::if_else: {
+              result = obj::make_list(ot::lang, f.sym, f.a, f.b, result);
+              pop(lv);
+              goto operators;
+            }
+
+            case step::for_seq: {
+              f.b = result;
+              skip_newlines();
+              expect(tt::rparen);
+              in_brackets_ = f.in_brackets;
+              f.kind = step::for_body;
+              lv = { 0, true, 0 };
+              goto operand;
+            }
+
+            case step::for_body: {
+              result = obj::make_list(ot::lang, f.sym, f.a, f.b, result);
+              pop(lv);
+              goto operators;
+            }
+
+            case step::while_body: {
+              result = obj::make_list(ot::lang, f.sym, f.a, result);
+              pop(lv);
+              goto operators;
+            }
+
+            case step::repeat_body: {
+              result = obj::make_list(ot::lang, f.sym, result);
+              pop(lv);
+              goto operators;
+            }
           }
-          obj *body = expr(0);
-          break;
         }
 
-        // |	IF ifcond expr_or_assign 	{ $$ = xxif($1,$2,$3);	setId( $$, @$); }
-        // |	IF ifcond expr_or_assign ELSE expr_or_assign	{ $$ = xxifelse($1,$2,$3,$5);	setId( $$, @$); }
-        case tt::if_: {
+      // exprlist:					{ $$ = xxexprlist0(); 	setId( $$, @$); }
+      //	|	expr_or_assign			{ $$ = xxexprlist1($1, &@1); }
+      //	|	exprlist ';' expr_or_assign	{ $$ = xxexprlist2($1, $3, &@3); }
+      //	|	exprlist ';'			{ $$ = $1;		setId( $$, @$); }
+      //	|	exprlist '\n' expr_or_assign	{ $$ = xxexprlist2($1, $3, &@3); }
+      //	|	exprlist '\n'			{ $$ = $1;}
+      //	;
+      statements:
+        while (tok() == tt::newline || tok() == tt::semicolon) {
           next();
-          expect(tt::lparen);
-          obj *cond = expr(0);
-          expect(tt::rparen);
-          obj *stmt = expr(0);
-          if (tok() == tt::else_) {
-            next();
-            obj *stmt2 = expr(0);
-          }
-          break;
         }
-        // |	FOR forcond expr_or_assign %prec FOR 	{ $$ = xxfor($1,$2,$3);	setId( $$, @$); }
-        case tt::for_: {
+        if (tok() != tt::rbrace) {
+          lv = { 0, true, 0 };
+          goto operand;
+        }
+        --brace_depth_;
+        expect(tt::rbrace);
+        result = top().list.result();
+        pop(lv);
+        goto operators;
+
+      // formlist:					{ $$ = xxnullformal(); }
+      //	|	SYMBOL				{ $$ = xxfirstformal0($1); 	modif_token( &@1, SYMBOL_FORMALS ) ; }
+      //	|	SYMBOL EQ_ASSIGN expr_or_help	{ $$ = xxfirstformal1($1,$3); 	modif_token( &@1, SYMBOL_FORMALS ) ; modif_token( &@2, EQ_FORMALS ) ; }
+      //	|	formlist ',' SYMBOL		{ $$ = xxaddformal0($1,$3, &@3);   modif_token( &@3, SYMBOL_FORMALS ) ; }
+      //	|	formlist ',' SYMBOL EQ_ASSIGN expr_or_help
+      //	;
+      formals:
+        if (tok() == tt::rparen) goto end_formals;
+        skip_newlines();
+        if (tok() != tt::symbol && tok() != tt::dotdotdot) {
+          error("expected formal argument");
+        }
+        {
+          obj *tag = tok() == tt::symbol ? value() : current_symbol();
           next();
-          expect(tt::lparen);
-          while (tok() != tt::rparen) {
+          if (tok() == tt::eq_assign) {
             next();
+            top().b = tag;
+            lv = { 0, true, 0 };
+            goto operand;
           }
-          expect(tt::rparen);
-          obj *stmt = expr(0);
-          break;
+          top().list.push_back(missing_arg(), tag);
         }
-        // |	WHILE cond expr_or_assign	{ $$ = xxwhile($1,$2,$3);	setId( $$, @$); }
-        case tt::while_: {
+
+      after_formal:
+        if (tok() == tt::comma) {
           next();
-          expect(tt::lparen);
-          obj *cond = expr(0);
+          goto formals;
+        }
+
+      // the body follows, outside the brackets.
+      end_formals:
+        {
+          frame &f = top();
           expect(tt::rparen);
-          obj *stmt = expr(0);
-          break;
+          in_brackets_ = f.in_brackets;
+          f.a = f.list.result();
+          skip_newlines();
+          f.kind = step::body;
+          lv = { 0, true, 0 };
+          goto operand;
         }
-        // |	REPEAT expr_or_assign			{ $$ = xxrepeat($1,$2);	setId( $$, @$); }
-        case tt::repeat: {
-          next();
-          obj *stmt = expr(0);
-          break;
+
+      // eg. 1, 3, var = 4
+      // sub	:					{ $$ = xxsub0();	 }
+      //	|	expr				{ $$ = xxsub1($1, &@1);  }
+      //	|	SYMBOL EQ_ASSIGN 		{ $$ = xxsymsub0($1, &@1); 	modif_token( &@2, EQ_SUB ) ; modif_token( &@1, SYMBOL_SUB ) ; }
+      //	|	SYMBOL EQ_ASSIGN expr		{ $$ = xxsymsub1($1,$3, &@1); 	modif_token( &@2, EQ_SUB ) ; modif_token( &@1, SYMBOL_SUB ) ; }
+      //	|	STR_CONST EQ_ASSIGN 		{ $$ = xxsymsub0($1, &@1); 	modif_token( &@2, EQ_SUB ) ; }
+      //	|	STR_CONST EQ_ASSIGN expr	{ $$ = xxsymsub1($1,$3, &@1); 	modif_token( &@2, EQ_SUB ) ; }
+      //	|	NULL_CONST EQ_ASSIGN 		{ $$ = xxnullsub0(&@1); 	modif_token( &@2, EQ_SUB ) ; }
+      //	|	NULL_CONST EQ_ASSIGN expr	{ $$ = xxnullsub1($3, &@1); 	modif_token( &@2, EQ_SUB ) ; }
+      //	;
+      arguments:
+        skip_newlines();
+        if (tok() != tt::comma && tok() != close_of(top())) {
+          top().lhs_tok = tok();
+          lv = { 0, false, 0 };
+          goto operand;
         }
-        // |	NEXT				{ $$ = xxnxtbrk($1);	setId( $$, @$); }
-        case tt::next: {
+        top().list.push_back(missing_arg());
+        goto after_argument;
+
+      // an argument, or the name before '='.
+      argument:
+        if (tok() != tt::eq_assign) {
+          top().list.push_back(result);
+        } else {
+          frame &f = top();
+          obj *tag = obj::null_const();
+          if (result->isSymbol() && (f.lhs_tok == tt::symbol || f.lhs_tok == tt::dotdotdot)) {
+            tag = result;
+          } else if (f.lhs_tok == tt::str_const && result->type() == ot::chr) {
+            tag = obj::make_symbol(result->chr_data());
+          } else if (f.lhs_tok == tt::null_const) {
+            tag = obj::make_symbol("NULL");
+          } else {
+            error("expected symbol, string or null before '='");
+          }
           next();
-          break;
+          skip_newlines();
+          if (tok() != tt::comma && tok() != close_of(f)) {
+            f.b = tag;
+            f.kind = step::argument_value;
+            lv = { 0, true, 0 };
+            goto operand;
+          }
+          f.list.push_back(missing_arg(), tag);
         }
-        // |	BREAK				{ $$ = xxnxtbrk($1);	setId( $$, @$); }
-        case tt::break_: {
+
+      after_argument:
+        if (tok() == tt::comma) {
           next();
-          break;
+          goto arguments;
         }
-        // ;
-
-        default: {
-          error("expected expression");
-          return result;
+        result = top().list.result();
+
+      end_arguments:
+        {
+          frame &f = top();
+          expect(close_of(f));
+          if (f.op == tt::lbb) expect(tt::rbracket);
+          if (f.op == tt::lparen) {
+            result = new obj(ot::lang, f.a, result);
+          } else {
+            result = new obj(ot::lang, f.sym, new obj(ot::list, f.a, result));
+          }
+          pop(lv);
+          goto operators;
         }
+      } catch (...) {
+        for (; open != 0; --open) trace_.leave("expr", offset());
+        num_frames_ = base;
+        in_brackets_ = in_brackets;
+        throw;
       }
+    }
 
-      int prev_prec = 0;
-      for(;;) {
-        tt op = tok();
-        int prec = get_precedence(op);
-        if (prec == 0 || prec <= min_precedence) break;
-        if (op == tt::eq_assign && !allow_assign) break;
-
-        grouping gr = get_grouping(op);
-        if (gr == grouping::noassoc && prec == prev_prec) break;
-        prev_prec = prec;
+    // frames are kept for the next expression, so only the fields a step uses are set.
+    frame &push(step kind, const level &lv) {
+      if (num_frames_ == stack_.size()) stack_.emplace_back();
+      frame &f = stack_[num_frames_++];
+      f.kind = kind;
+      f.in_brackets = in_brackets_;
+      f.outer = lv;
+      return f;
+    }
 
-        obj *sym = obj::make_symbol(id());
+    // the frame's construct is complete and the level it was in carries on.
+    void pop(level &lv) {
+      frame &f = top();
+      in_brackets_ = f.in_brackets;
+      lv = f.outer;
+      --num_frames_;
+    }
 
-        next();
+    frame &top() { return stack_[num_frames_ - 1]; }
 
-        switch (op) {
-          // |	expr '(' sublist ')'		{ $$ = xxfuncall($1,$3);  setId( $$, @$); modif_token( &@1, SYMBOL_FUNCTION_CALL ) ; }
-          // |	expr LBB sublist ']' ']'	{ $$ = xxsubscript($1,$2,$3);	setId( $$, @$); }
-          // |	expr '[' sublist ']'		{ $$ = xxsubscript($1,$2,$3);	setId( $$, @$); }
-          case tt::lbracket:
-          case tt::lbb:
-          case tt::lparen: {
-            obj *actuals = sublist();
-            expect(tt::rparen);
-            result = new obj(ot::lang, result, actuals);
-            result->set_tag(sym);
-            continue;
-          }
-          case tt::newline: {
-            return result;
-          }
-        }
-
-        // left grouping operators will parse like ( ( a + b ) + c ) + d    so rhs will accept fewer tokens
-        // right grouping operators will parse like a = ( b = ( c = d ) )   so rhs will accept more tokens
-        obj *rhs = expr(prec - (gr == grouping::right ? 1 : 0));
-
-        switch (op) {
-          // |	expr '$' SYMBOL			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr '$' STR_CONST		{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr '@' SYMBOL			{ $$ = xxbinary($2,$1,$3);      setId( $$, @$); modif_token( &@3, SLOT ) ; }
-          // |	expr '@' STR_CONST		{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr ':'  expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr '+'  expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr '-' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr '*' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr '/' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr '^' expr 			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr SPECIAL expr		{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr '%' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr '~' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr '?' expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr LT expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr LE expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr EQ expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr NE expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr GE expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr GT expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr AND expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr OR expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr AND2 expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr OR2 expr			{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr LEFT_ASSIGN expr 		{ $$ = xxbinary($2,$1,$3);	setId( $$, @$); }
-          // |	expr RIGHT_ASSIGN expr 		{ $$ = xxbinary($2,$3,$1);	setId( $$, @$); }
-          case tt::colon:
-          case tt::plus:
-          case tt::minus:
-          case tt::star:
-          case tt::divide:
-          case tt::caret:
-          case tt::special:
-          case tt::modulus:
-          case tt::tilde:
-          case tt::question:
-          case tt::lt: case tt::le: case tt::eq:
-          case tt::ne: case tt::ge: case tt::gt:
-          case tt::and_:
-          case tt::or_:
-          case tt::and2:
-          case tt::or2:
-          case tt::left_assign:
-          case tt::right_assign:
-          case tt::dollar:
-          case tt::at:
-          {
-            result = new obj(ot::lang, sym, result, rhs);
-            break;
-          }
+    static tt close_of(const frame &f) {
+      return f.op == tt::lparen ? tt::rparen : tt::rbracket;
+    }
 
-          default: {
-            error("expected operator");
-          }
-        }
+    // the function for an operator. -> and ->> assign the other way and ** is ^.
+    obj *binary_symbol(tt op) {
+      switch (op) {
+        case tt::right_assign: return length() == 3 ? obj::make_symbol("<<-") : obj::make_symbol("<-");
+        case tt::star2: return obj::make_symbol("^");
+        case tt::lbb: return obj::make_symbol("[[");
+        default: return current_symbol();
       }
-      indent(); std::cout << "prec fail " << *result << "\n";
-      pop_debug();
-      return result;
     }
 
-    // eg. 1, 3, var = 4
-    // sub	:					{ $$ = xxsub0();	 }
-    //	|	expr				{ $$ = xxsub1($1, &@1);  }
-    //	|	SYMBOL EQ_ASSIGN 		{ $$ = xxsymsub0($1, &@1); 	modif_token( &@2, EQ_SUB ) ; modif_token( &@1, SYMBOL_SUB ) ; }
-    //	|	SYMBOL EQ_ASSIGN expr		{ $$ = xxsymsub1($1,$3, &@1); 	modif_token( &@2, EQ_SUB ) ; modif_token( &@1, SYMBOL_SUB ) ; }
-    //	|	STR_CONST EQ_ASSIGN 		{ $$ = xxsymsub0($1, &@1); 	modif_token( &@2, EQ_SUB ) ; }
-    //	|	STR_CONST EQ_ASSIGN expr	{ $$ = xxsymsub1($1,$3, &@1); 	modif_token( &@2, EQ_SUB ) ; }
-    //	|	NULL_CONST EQ_ASSIGN 		{ $$ = xxnullsub0(&@1); 	modif_token( &@2, EQ_SUB ) ; }
-    //	|	NULL_CONST EQ_ASSIGN expr	{ $$ = xxnullsub1($3, &@1); 	modif_token( &@2, EQ_SUB ) ; }
-    //	;
-    obj *sublist() {
-      obj *result = obj::null_const();
-      obj *prev = result;
-      for (;;) {
-        obj *lhs = expr(0);
-        if (tok() == tt::eq_assign) {
-          next();
-          if (!lhs->isNull() && !lhs->isSymbol() && !lhs->isString()) {
-            error("expected symbol, string or null before '='");
-            return obj::null_const();
-          }
-          if (tok() != tt::rparen && tok() != tt::comma) {
-            obj *rhs = expr(0);
-            lhs = new obj(ot::lang, lhs, rhs);
-          }
-          if (result == obj::null_const()) {
-            prev = result = new obj();
-          }
-          prev = prev->append(lhs);
-          if (tok() != tt::comma) {
-            break;
-          }
-          next();
-        }
-      }
-      return result;
+    bool in_braces_or_brackets() const {
+      return in_brackets_ || brace_depth_ != 0;
     }
 
     void expect(tt token) {
       if (tok() != token) {
-        throw std::runtime_error(std::string("expected") + tok_to_str[(unsigned)token]);
+        error((std::string("expected ") + tok_to_str[(unsigned)token]).c_str());
       }
       next();
     }
 
-    void expect(tt token1, tt token2) {
-      if (tok() != token1 || tok() != token2) {
-        throw std::runtime_error(std::string("expected") + tok_to_str[(unsigned)token1] + " or " + tok_to_str[(unsigned)token2]);
+    void error(const char *str) {
+      throw std::runtime_error(std::string(str) + " at offset " + std::to_string(offset()));
+    }
+
+    list_builder exprs_;
+    std::vector<frame> stack_;
+    size_t num_frames_ = 0;
+    obj *symbols_[(unsigned)tt::uminus + 1] = {};
+    bool in_brackets_;
+    int brace_depth_ = 0;
+    size_t num_errors_;
+    std::string first_error_;
+    bool incomplete_;
+    size_t incomplete_offset_;
+  };
+
+  // A parser for input that arrives in chunks, eg. from a pipe or a socket.
+  //
+  // Bytes are scanned once as they arrive to follow strings, comments and brackets. A newline
+  // outside all of them may end a top level expression, so the text up to the last one is
+  // parsed and its expressions queued. An expression cut short by the end of that text, like
+  // "x <-", is kept and parsed again with the next chunk. Only the unfinished tail is buffered.
+  class stream_parser {
+  public:
+    stream_parser() : heap_(heap::current()) {
+      head_ = last_ = obj::null_const();
+      heap_.add_root(&head_);
+    }
+
+    ~stream_parser() {
+      heap_.remove_root(&head_);
+    }
+
+    stream_parser(const stream_parser &) = delete;
+    stream_parser &operator=(const stream_parser &) = delete;
+
+    // a chunk may end anywhere, even in the middle of a token or a UTF-8 character.
+    void feed(const char *data, size_t size) {
+      buf_.append(data, size);
+      size_t ready = 0;
+      for (; scanned_ != buf_.size(); ++scanned_) {
+        if (ends_line(buf_[scanned_])) ready = scanned_ + 1;
       }
-      next();
+      if (ready != 0) parse(ready, false);
     }
 
-    void error(const char *str) {
-      std::cout << "error " << str << "\n";
+    // the end of the input: whatever is left is parsed as it is.
+    void finish() {
+      if (!buf_.empty()) parse(buf_.size(), true);
+      buf_.clear();
+      scanned_ = 0;
+      depth_ = 0;
+      quote_ = 0;
+      escape_ = comment_ = false;
+    }
+
+    // the next complete top level expression or nullptr if there isn't one yet.
+    obj *pop() {
+      if (head_ == obj::null_const()) return nullptr;
+      obj *e = head_->head();
+      head_ = head_->tail();
+      if (head_ == obj::null_const()) last_ = head_;
+      return e;
+    }
+
+    // top level expressions that were skipped because of a syntax error.
+    size_t num_errors() const { return num_errors_; }
+    const std::string &first_error() const { return first_error_; }
+
+    // bytes waiting for the rest of an expression.
+    size_t buffered() const { return buf_.size(); }
+
+  private:
+    // true for a newline that is not in a string, a comment or brackets.
+    bool ends_line(char c) {
+      if (quote_) {
+        if (escape_) {
+          escape_ = false;
+        } else if (c == '\\') {
+          escape_ = true;
+        } else if (c == quote_) {
+          quote_ = 0;
+        }
+        return false;
+      }
+      if (comment_) {
+        if (c != '\n') return false;
+        comment_ = false;
+      }
+      switch (c) {
+        case '#': comment_ = true; break;
+        case '\'': case '"': case '`': quote_ = c; break;
+        case '(': case '[': case '{': ++depth_; break;
+        case ')': case ']': case '}': if (depth_ != 0) --depth_; break;
+        case '\n': return depth_ == 0;
+      }
+      return false;
+    }
+
+    void parse(size_t size, bool final) {
+      parser p(buf_.data(), size);
+      bool wait = p.incomplete() && !final;
+      size_t errors = p.num_errors() - (wait ? 1 : 0);
+      if (errors != 0 && num_errors_ == 0) first_error_ = p.first_error();
+      num_errors_ += errors;
+
+      obj *exprs = p.exprs();
+      if (exprs != obj::null_const()) {
+        if (last_ == obj::null_const()) {
+          head_ = exprs;
+        } else {
+          last_->set_tail(exprs);
+        }
+        for (last_ = exprs; last_->tail() != obj::null_const(); last_ = last_->tail()) {
+        }
+      }
+
+      size_t used = wait ? p.incomplete_offset() : size;
+      buf_.erase(0, used);
+      scanned_ -= used;
     }
+
+    heap &heap_;
+    obj *head_;
+    obj *last_;
+    std::string buf_;
+    size_t scanned_ = 0;
+    int depth_ = 0;
+    char quote_ = 0;
+    bool escape_ = false;
+    bool comment_ = false;
+    size_t num_errors_ = 0;
+    std::string first_error_;
   };
 }
 
@@ -0,0 +1,157 @@
+#ifndef SCAN_HPP
+#define SCAN_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simd.hpp"
+
+#ifdef _MSC_VER
+  #include <intrin.h>
+#endif
+
+namespace little_r {
+  // Scanning kernels for the lexer's hot loops.
+  //
+  // Each function returns the first position in [p, end) that stops the run, or end.
+  // Blocks of 32 (AVX2) or 16 (SSE2) bytes are tested at once and the tail is done
+  // a byte at a time. Bytes >= 0x80 always stop a run so that the lexer can deal with them.
+  namespace scan {
+    inline unsigned first_bit(unsigned mask) {
+      #ifdef _MSC_VER
+        unsigned long res;
+        _BitScanForward(&res, mask);
+        return (unsigned)res;
+      #else
+        return (unsigned)__builtin_ctz(mask);
+      #endif
+    }
+
+    inline bool is_ident(unsigned char c) {
+      return ((c | 32) >= 'a' && (c | 32) <= 'z') || (c >= '0' && c <= '9') || c == '.' || c == '_';
+    }
+
+    inline bool is_space(unsigned char c) {
+      return c == ' ' || c == '\t' || c == '\f';
+    }
+
+    #ifdef LITTLE_R_AVX2
+      // bytes in [lo, hi] for values below 0x80.
+      inline __m256i in_range(__m256i v, char lo, char hi) {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+      }
+
+      inline unsigned ident_mask(__m256i v) {
+        __m256i alpha = in_range(_mm256_or_si256(v, _mm256_set1_epi8(32)), 'a', 'z');
+        __m256i digit = in_range(v, '0', '9');
+        __m256i punct = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('.')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        return (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), punct));
+      }
+    #endif
+
+    #ifdef LITTLE_R_SSE2
+      inline __m128i in_range(__m128i v, char lo, char hi) {
+        return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+      }
+
+      inline unsigned ident_mask(__m128i v) {
+        __m128i alpha = in_range(_mm_or_si128(v, _mm_set1_epi8(32)), 'a', 'z');
+        __m128i digit = in_range(v, '0', '9');
+        __m128i punct = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('.')), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+        return (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), punct));
+      }
+    #endif
+
+    // end of a run of ASCII identifier characters.
+    // most names are short so the first few bytes are tested one at a time.
+    inline const char *ident_end(const char *p, const char *end) {
+      for (int i = 0; i != 8 && p != end; ++i, ++p) {
+        if (!is_ident((unsigned char)*p)) return p;
+      }
+      #ifdef LITTLE_R_AVX2
+        for (; end - p >= 32; p += 32) {
+          unsigned stop = ~ident_mask(_mm256_loadu_si256((const __m256i*)p));
+          if (stop) return p + first_bit(stop);
+        }
+      #endif
+      #ifdef LITTLE_R_SSE2
+        for (; end - p >= 16; p += 16) {
+          unsigned stop = ~ident_mask(_mm_loadu_si128((const __m128i*)p)) & 0xffff;
+          if (stop) return p + first_bit(stop);
+        }
+      #endif
+      while (p != end && is_ident((unsigned char)*p)) ++p;
+      return p;
+    }
+
+    // end of a run of blanks. usually there is only one.
+    inline const char *space_end(const char *p, const char *end) {
+      for (int i = 0; i != 4 && p != end; ++i, ++p) {
+        if (!is_space((unsigned char)*p)) return p;
+      }
+      #ifdef LITTLE_R_SSE2
+        for (; end - p >= 16; p += 16) {
+          __m128i v = _mm_loadu_si128((const __m128i*)p);
+          __m128i space = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8('\f'))
+          );
+          unsigned stop = ~_mm_movemask_epi8(space) & 0xffff;
+          if (stop) return p + first_bit(stop);
+        }
+      #endif
+      while (p != end && is_space((unsigned char)*p)) ++p;
+      return p;
+    }
+
+    // the next newline, for skipping comments.
+    inline const char *line_end(const char *p, const char *end) {
+      #ifdef LITTLE_R_AVX2
+        for (; end - p >= 32; p += 32) {
+          unsigned stop = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)p), _mm256_set1_epi8('\n')));
+          if (stop) return p + first_bit(stop);
+        }
+      #endif
+      #ifdef LITTLE_R_SSE2
+        for (; end - p >= 16; p += 16) {
+          unsigned stop = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), _mm_set1_epi8('\n')));
+          if (stop) return p + first_bit(stop);
+        }
+      #endif
+      while (p != end && *p != '\n') ++p;
+      return p;
+    }
+
+    // the next quote or backslash in the body of a string.
+    inline const char *string_stop(const char *p, const char *end, char quote) {
+      #ifdef LITTLE_R_AVX2
+        for (; end - p >= 32; p += 32) {
+          __m256i v = _mm256_loadu_si256((const __m256i*)p);
+          unsigned stop = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(quote)), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))));
+          if (stop) return p + first_bit(stop);
+        }
+      #endif
+      #ifdef LITTLE_R_SSE2
+        for (; end - p >= 16; p += 16) {
+          __m128i v = _mm_loadu_si128((const __m128i*)p);
+          unsigned stop = (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(quote)), _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))));
+          if (stop) return p + first_bit(stop);
+        }
+      #endif
+      while (p != end && *p != quote && *p != '\\') ++p;
+      return p;
+    }
+
+    inline const char *kernel_name() {
+      #if defined(LITTLE_R_AVX2)
+        return "avx2";
+      #elif defined(LITTLE_R_SSE2)
+        return "sse2";
+      #else
+        return "scalar";
+      #endif
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+// Instruction sets the kernels may use, picked at compile time.
+// LITTLE_R_NO_SIMD builds the scalar versions only.
+#if !defined(LITTLE_R_NO_SIMD)
+  #if defined(__AVX2__)
+    #include <immintrin.h>
+    #define LITTLE_R_AVX2 1
+  #endif
+  #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define LITTLE_R_SSE2 1
+  #endif
+#endif
+
+#endif
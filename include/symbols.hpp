@@ -0,0 +1,172 @@
+#ifndef SYMBOLS_HPP
+#define SYMBOLS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "objects.hpp"
+
+namespace little_r {
+  // Interned symbols, equivalent to R_SymbolTable.
+  //
+  // There is exactly one ot::symbol per name so symbols compare by pointer.
+  // Symbols live in the table's own heap and are never collected.
+  //
+  // The table is open addressed. Lookups of existing names take no lock:
+  // a slot's hash is written before its symbol is published with a release store,
+  // and a table that has been outgrown is kept until the symbol table dies
+  // so a reader can finish probing it. Inserts are serialised by a mutex.
+  class symbol_table {
+  public:
+    symbol_table() {
+      num_symbols_.store(0, std::memory_order_relaxed);
+      table_.store(new_table(1024), std::memory_order_release);
+    }
+
+    ~symbol_table() {
+      tables_.push_back(table_.load());
+      for (size_t i = 0; i != tables_.size(); ++i) {
+        delete[] (char*)tables_[i];
+      }
+    }
+
+    symbol_table(const symbol_table &) = delete;
+    symbol_table &operator=(const symbol_table &) = delete;
+
+    static symbol_table &global() {
+      static symbol_table table;
+      return table;
+    }
+
+    static uint64_t hash(const char *str, size_t len) {
+      uint64_t h = 0x9e3779b97f4a7c15ull ^ len;
+      for (; len >= 8; str += 8, len -= 8) {
+        uint64_t w;
+        memcpy(&w, str, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+      }
+      uint64_t w = 0;
+      memcpy(&w, str, len);
+      h = (h ^ w) * 0xc4ceb9fe1a85ec53ull;
+      return h ^ (h >> 29);
+    }
+
+    // the canonical symbol for a name, or nullptr if it has not been seen.
+    objref find(const char *str, size_t len) const {
+      return probe(table_.load(std::memory_order_acquire), hash(str, len), str, len);
+    }
+
+    // the canonical symbol for a name, creating it if need be.
+    objref intern(const char *str, size_t len) {
+      uint64_t h = hash(str, len);
+      objref res = probe(table_.load(std::memory_order_acquire), h, str, len);
+      if (res) return res;
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      table *t = table_.load(std::memory_order_relaxed);
+      res = probe(t, h, str, len);
+      if (res) return res;
+
+      if ((num_symbols_ + 1) * 2 > t->mask + 1) {
+        t = grow(t);
+      }
+
+      {
+        heap::scope scope(heap_);
+        res = new (len + 1) obj(ot::symbol);
+      }
+      memcpy(res->chr_data(), str, len);
+      res->chr_data()[len] = 0;
+      res->make_permanent();
+      insert(t, h, res);
+      num_symbols_.fetch_add(1, std::memory_order_relaxed);
+      return res;
+    }
+
+    size_t num_symbols() const { return num_symbols_.load(std::memory_order_relaxed); }
+
+    // a string that lives as long as the symbols, such as NA_character_.
+    objref permanent_string(const char *str, size_t len) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      heap::scope scope(heap_);
+      objref res = obj::make_string(str, len);
+      res->make_permanent();
+      return res;
+    }
+
+  private:
+    struct slot {
+      std::atomic<uint64_t> hash;
+      std::atomic<obj *> sym;
+    };
+
+    struct table {
+      size_t mask;
+      slot slots[1];
+    };
+
+    static table *new_table(size_t size) {
+      char *mem = new char[sizeof(table) + sizeof(slot) * (size - 1)];
+      table *t = (table*)mem;
+      t->mask = size - 1;
+      for (size_t i = 0; i != size; ++i) {
+        new (&t->slots[i]) slot();
+        t->slots[i].hash.store(0, std::memory_order_relaxed);
+        t->slots[i].sym.store(nullptr, std::memory_order_relaxed);
+      }
+      return t;
+    }
+
+    static objref probe(const table *t, uint64_t h, const char *str, size_t len) {
+      for (size_t i = h & t->mask; ; i = (i + 1) & t->mask) {
+        objref sym = t->slots[i].sym.load(std::memory_order_acquire);
+        if (!sym) return nullptr;
+        if (t->slots[i].hash.load(std::memory_order_relaxed) == h) {
+          const char *name = sym->chr_data();
+          if (!memcmp(name, str, len) && name[len] == 0) return sym;
+        }
+      }
+    }
+
+    static void insert(table *t, uint64_t h, objref sym) {
+      size_t i = h & t->mask;
+      while (t->slots[i].sym.load(std::memory_order_relaxed)) {
+        i = (i + 1) & t->mask;
+      }
+      t->slots[i].hash.store(h, std::memory_order_relaxed);
+      t->slots[i].sym.store(sym, std::memory_order_release);
+    }
+
+    table *grow(table *old) {
+      table *t = new_table((old->mask + 1) * 2);
+      for (size_t i = 0; i != old->mask + 1; ++i) {
+        objref sym = old->slots[i].sym.load(std::memory_order_relaxed);
+        if (sym) insert(t, old->slots[i].hash.load(std::memory_order_relaxed), sym);
+      }
+      tables_.push_back(old);
+      table_.store(t, std::memory_order_release);
+      return t;
+    }
+
+    std::atomic<table *> table_;
+    std::vector<table *> tables_;
+    std::mutex mutex_;
+    heap heap_;
+    std::atomic<size_t> num_symbols_;
+  };
+
+  inline objref obj::make_symbol(const char *str, size_t len) {
+    return symbol_table::global().intern(str, len);
+  }
+
+  inline objref obj::na_string() {
+    static const objref value = symbol_table::global().permanent_string("NA", 2);
+    return value;
+  }
+}
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef TOKEN_BUFFER_HPP
+#define TOKEN_BUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "lexer.hpp"
+
+namespace little_r {
+  // A bounded queue from one thread to one other, without locks.
+  //
+  // The indices only grow. Each side writes one of them and reads the other with acquire,
+  // so a slot is filled before the consumer can see it and emptied before the producer can reuse it.
+  template <class T, size_t N>
+  class spsc_ring {
+  public:
+    spsc_ring() : head_(0), tail_(0) {
+    }
+
+    bool try_push(const T &value) {
+      size_t head = head_.load(std::memory_order_relaxed);
+      if (head - tail_.load(std::memory_order_acquire) == N) return false;
+      items_[head % N] = value;
+      head_.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool try_pop(T &value) {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail == head_.load(std::memory_order_acquire)) return false;
+      value = items_[tail % N];
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+  private:
+    // on separate cache lines so the two threads don't fight over one.
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+    T items_[N];
+  };
+
+  // The tokens of a whole source, lexed before the parser reads them.
+  //
+  // The parser reads the chunks back with lexer(src, size, tokens), so a token is lexed once
+  // however far the parser looks ahead. A source of thread_size bytes or more is lexed on
+  // a second thread, which hands over each chunk through an spsc_ring as soon as it is full.
+  // Chunks are kept until the buffer dies because the parser may back up.
+  class token_buffer : public token_source {
+  public:
+    static const size_t thread_size = 256 * 1024;
+
+    token_buffer(const char *src, size_t size) : token_buffer(src, size, size >= thread_size) {
+    }
+
+    token_buffer(const char *src, size_t size, bool threaded) : src_(src), size_(size), stop_(false) {
+      if (size > UINT32_MAX) throw std::runtime_error("source is too big for a token buffer");
+      if (threaded) {
+        producer_ = std::thread([this]() { produce(); });
+      } else {
+        lexer lex(src, size);
+        for (bool more = true; more; ) {
+          chunks_.emplace_back(new token_chunk());
+          more = lex.lex_chunk(*chunks_.back());
+        }
+      }
+    }
+
+    ~token_buffer() {
+      if (producer_.joinable()) {
+        stop_.store(true, std::memory_order_relaxed);
+        producer_.join();
+        for (token_chunk *c; ring_.try_pop(c); ) delete c;
+      }
+    }
+
+    token_buffer(const token_buffer &) = delete;
+    token_buffer &operator=(const token_buffer &) = delete;
+
+    // waits for the lexing thread if it has not got that far.
+    const token_chunk *chunk(size_t i) override {
+      while (i >= chunks_.size()) {
+        token_chunk *c;
+        if (!ring_.try_pop(c)) {
+          std::this_thread::yield();
+        } else if (!c) {
+          std::rethrow_exception(error_);
+        } else {
+          chunks_.emplace_back(c);
+        }
+      }
+      return chunks_[i].get();
+    }
+
+    bool threaded() const { return producer_.joinable(); }
+
+  private:
+    // runs on the lexing thread. a nullptr chunk passes on an exception.
+    void produce() {
+      try {
+        lexer lex(src_, size_);
+        for (bool more = true; more; ) {
+          std::unique_ptr<token_chunk> c(new token_chunk());
+          more = lex.lex_chunk(*c);
+          if (!push(c.get())) return;
+          c.release();
+        }
+      } catch (...) {
+        error_ = std::current_exception();
+        push(nullptr);
+      }
+    }
+
+    // false if the buffer is being destroyed.
+    bool push(token_chunk *c) {
+      while (!ring_.try_push(c)) {
+        if (stop_.load(std::memory_order_relaxed)) return false;
+        std::this_thread::yield();
+      }
+      return true;
+    }
+
+    const char *src_;
+    size_t size_;
+    std::vector<std::unique_ptr<token_chunk> > chunks_;
+    spsc_ring<token_chunk*, 16> ring_;
+    std::atomic<bool> stop_;
+    std::exception_ptr error_;
+    std::thread producer_;
+  };
+}
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// LITTLE_R_TRACE=0 compiles every trace call away.
+#ifndef LITTLE_R_TRACE
+  #define LITTLE_R_TRACE 1
+#endif
+
+namespace little_r {
+  enum class te {
+    token,  // the lexer produced a token
+    enter,  // the parser entered a rule
+    leave,  // the parser left a rule
+  };
+
+  struct trace_event {
+    te kind;
+    int tok;        // token type for te::token
+    const char *label;  // rule name for te::enter and te::leave
+    int arg;        // eg. min_precedence
+    unsigned depth;
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  // where trace events go when tracing is switched on at runtime.
+  class trace_sink {
+  public:
+    virtual ~trace_sink() {}
+    virtual void event(const trace_event &ev) = 0;
+  };
+
+  // Lock-free single producer, single consumer ring of events.
+  // The parser pushes, anyone may pop while it runs or dump once it has finished.
+  // When the ring is full new events are dropped and counted.
+  class trace_ring : public trace_sink {
+  public:
+    trace_ring(size_t capacity = 1 << 16) : events_(round_up(capacity)), mask_(events_.size() - 1), dropped_(0) {
+      head_.store(0, std::memory_order_relaxed);
+      tail_.store(0, std::memory_order_relaxed);
+    }
+
+    void event(const trace_event &ev) override {
+      size_t head = head_.load(std::memory_order_relaxed);
+      if (head - tail_.load(std::memory_order_acquire) == events_.size()) {
+        ++dropped_;
+        return;
+      }
+      events_[head & mask_] = ev;
+      head_.store(head + 1, std::memory_order_release);
+    }
+
+    bool pop(trace_event &ev) {
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      if (tail == head_.load(std::memory_order_acquire)) return false;
+      ev = events_[tail & mask_];
+      tail_.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    size_t size() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+    size_t dropped() const { return dropped_; }
+
+    // print and remove the events. "src" is the buffer that was lexed and
+    // "tok_names" maps token types to names.
+    void dump(std::ostream &os, const char *src, const char *const *tok_names) {
+      trace_event ev;
+      while (pop(ev)) {
+        for (unsigned i = 0; i != ev.depth; ++i) os << "  ";
+        switch (ev.kind) {
+          case te::token: os << tok_names[ev.tok] << " [" << std::string(src + ev.offset, ev.length) << "]\n"; break;
+          case te::enter: os << ev.label << " " << ev.arg << " {\n"; break;
+          case te::leave: os << "}\n"; break;
+        }
+      }
+      if (dropped_) os << dropped_ << " events dropped\n";
+    }
+
+  private:
+    static size_t round_up(size_t n) {
+      size_t res = 1;
+      while (res < n) res *= 2;
+      return res;
+    }
+
+    std::vector<trace_event> events_;
+    size_t mask_;
+    size_t dropped_;
+    std::atomic<size_t> head_;
+    std::atomic<size_t> tail_;
+  };
+
+  // Per-instance trace state for the lexer and parser.
+  // Nothing is recorded until a sink is attached, and nothing is compiled
+  // when LITTLE_R_TRACE is 0.
+  class tracer {
+  public:
+    tracer() : sink_(nullptr), depth_(0) {}
+
+    void set_sink(trace_sink *sink) { sink_ = sink; }
+    trace_sink *sink() const { return sink_; }
+
+    bool enabled() const { return LITTLE_R_TRACE && sink_ != nullptr; }
+
+    void token(int tok, size_t offset, size_t length) {
+      if (enabled()) emit(te::token, tok, nullptr, 0, offset, length);
+    }
+
+    void enter(const char *label, int arg, size_t offset) {
+      if (enabled()) {
+        emit(te::enter, 0, label, arg, offset, 0);
+        ++depth_;
+      }
+    }
+
+    void leave(const char *label, size_t offset) {
+      if (enabled()) {
+        --depth_;
+        emit(te::leave, 0, label, 0, offset, 0);
+      }
+    }
+
+  private:
+    void emit(te kind, int tok, const char *label, int arg, size_t offset, size_t length) {
+      trace_event ev = { kind, tok, label, arg, depth_, (uint32_t)offset, (uint32_t)length };
+      sink_->event(ev);
+    }
+
+    trace_sink *sink_;
+    unsigned depth_;
+  };
+}
+
+#endif
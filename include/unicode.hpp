@@ -0,0 +1,290 @@
+#ifndef UNICODE_HPP
+#define UNICODE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace little_r {
+  // UTF-8 for the lexer.
+  //
+  // Source text is lexed as bytes. ASCII never gets here; a byte >= 0x80 starts a
+  // sequence that is decoded to a code point and looked up in a table of the
+  // characters that can start (letters) or continue (letters, digits and combining
+  // marks) a name. The table is the Unicode 14.0.0 character database, as ranges.
+  namespace unicode {
+    enum ident_class : unsigned char {
+      none,
+      alpha,
+      alnum,
+    };
+
+    struct range {
+      uint32_t first;
+      uint32_t last;
+      ident_class cls;
+    };
+
+    // the non-ASCII ranges, in order.
+    static const range ident_ranges[] = {
+      { 0x000aa, 0x000aa, alpha }, { 0x000b5, 0x000b5, alpha }, { 0x000ba, 0x000ba, alpha }, { 0x000c0, 0x000d6, alpha }, { 0x000d8, 0x000f6, alpha },
+      { 0x000f8, 0x002c1, alpha }, { 0x002c6, 0x002d1, alpha }, { 0x002e0, 0x002e4, alpha }, { 0x002ec, 0x002ec, alpha }, { 0x002ee, 0x002ee, alpha },
+      { 0x00300, 0x0036f, alnum }, { 0x00370, 0x00374, alpha }, { 0x00376, 0x00377, alpha }, { 0x0037a, 0x0037d, alpha }, { 0x0037f, 0x0037f, alpha },
+      { 0x00386, 0x00386, alpha }, { 0x00388, 0x0038a, alpha }, { 0x0038c, 0x0038c, alpha }, { 0x0038e, 0x003a1, alpha }, { 0x003a3, 0x003f5, alpha },
+      { 0x003f7, 0x00481, alpha }, { 0x00483, 0x00487, alnum }, { 0x0048a, 0x0052f, alpha }, { 0x00531, 0x00556, alpha }, { 0x00559, 0x00559, alpha },
+      { 0x00560, 0x00588, alpha }, { 0x00591, 0x005bd, alnum }, { 0x005bf, 0x005bf, alnum }, { 0x005c1, 0x005c2, alnum }, { 0x005c4, 0x005c5, alnum },
+      { 0x005c7, 0x005c7, alnum }, { 0x005d0, 0x005ea, alpha }, { 0x005ef, 0x005f2, alpha }, { 0x00610, 0x0061a, alnum }, { 0x00620, 0x0064a, alpha },
+      { 0x0064b, 0x00669, alnum }, { 0x0066e, 0x0066f, alpha }, { 0x00670, 0x00670, alnum }, { 0x00671, 0x006d3, alpha }, { 0x006d5, 0x006d5, alpha },
+      { 0x006d6, 0x006dc, alnum }, { 0x006df, 0x006e4, alnum }, { 0x006e5, 0x006e6, alpha }, { 0x006e7, 0x006e8, alnum }, { 0x006ea, 0x006ed, alnum },
+      { 0x006ee, 0x006ef, alpha }, { 0x006f0, 0x006f9, alnum }, { 0x006fa, 0x006fc, alpha }, { 0x006ff, 0x006ff, alpha }, { 0x00710, 0x00710, alpha },
+      { 0x00711, 0x00711, alnum }, { 0x00712, 0x0072f, alpha }, { 0x00730, 0x0074a, alnum }, { 0x0074d, 0x007a5, alpha }, { 0x007a6, 0x007b0, alnum },
+      { 0x007b1, 0x007b1, alpha }, { 0x007c0, 0x007c9, alnum }, { 0x007ca, 0x007ea, alpha }, { 0x007eb, 0x007f3, alnum }, { 0x007f4, 0x007f5, alpha },
+      { 0x007fa, 0x007fa, alpha }, { 0x007fd, 0x007fd, alnum }, { 0x00800, 0x00815, alpha }, { 0x00816, 0x00819, alnum }, { 0x0081a, 0x0081a, alpha },
+      { 0x0081b, 0x00823, alnum }, { 0x00824, 0x00824, alpha }, { 0x00825, 0x00827, alnum }, { 0x00828, 0x00828, alpha }, { 0x00829, 0x0082d, alnum },
+      { 0x00840, 0x00858, alpha }, { 0x00859, 0x0085b, alnum }, { 0x00860, 0x0086a, alpha }, { 0x00870, 0x00887, alpha }, { 0x00889, 0x0088e, alpha },
+      { 0x00898, 0x0089f, alnum }, { 0x008a0, 0x008c9, alpha }, { 0x008ca, 0x008e1, alnum }, { 0x008e3, 0x00903, alnum }, { 0x00904, 0x00939, alpha },
+      { 0x0093a, 0x0093c, alnum }, { 0x0093d, 0x0093d, alpha }, { 0x0093e, 0x0094f, alnum }, { 0x00950, 0x00950, alpha }, { 0x00951, 0x00957, alnum },
+      { 0x00958, 0x00961, alpha }, { 0x00962, 0x00963, alnum }, { 0x00966, 0x0096f, alnum }, { 0x00971, 0x00980, alpha }, { 0x00981, 0x00983, alnum },
+      { 0x00985, 0x0098c, alpha }, { 0x0098f, 0x00990, alpha }, { 0x00993, 0x009a8, alpha }, { 0x009aa, 0x009b0, alpha }, { 0x009b2, 0x009b2, alpha },
+      { 0x009b6, 0x009b9, alpha }, { 0x009bc, 0x009bc, alnum }, { 0x009bd, 0x009bd, alpha }, { 0x009be, 0x009c4, alnum }, { 0x009c7, 0x009c8, alnum },
+      { 0x009cb, 0x009cd, alnum }, { 0x009ce, 0x009ce, alpha }, { 0x009d7, 0x009d7, alnum }, { 0x009dc, 0x009dd, alpha }, { 0x009df, 0x009e1, alpha },
+      { 0x009e2, 0x009e3, alnum }, { 0x009e6, 0x009ef, alnum }, { 0x009f0, 0x009f1, alpha }, { 0x009fc, 0x009fc, alpha }, { 0x009fe, 0x009fe, alnum },
+      { 0x00a01, 0x00a03, alnum }, { 0x00a05, 0x00a0a, alpha }, { 0x00a0f, 0x00a10, alpha }, { 0x00a13, 0x00a28, alpha }, { 0x00a2a, 0x00a30, alpha },
+      { 0x00a32, 0x00a33, alpha }, { 0x00a35, 0x00a36, alpha }, { 0x00a38, 0x00a39, alpha }, { 0x00a3c, 0x00a3c, alnum }, { 0x00a3e, 0x00a42, alnum },
+      { 0x00a47, 0x00a48, alnum }, { 0x00a4b, 0x00a4d, alnum }, { 0x00a51, 0x00a51, alnum }, { 0x00a59, 0x00a5c, alpha }, { 0x00a5e, 0x00a5e, alpha },
+      { 0x00a66, 0x00a71, alnum }, { 0x00a72, 0x00a74, alpha }, { 0x00a75, 0x00a75, alnum }, { 0x00a81, 0x00a83, alnum }, { 0x00a85, 0x00a8d, alpha },
+      { 0x00a8f, 0x00a91, alpha }, { 0x00a93, 0x00aa8, alpha }, { 0x00aaa, 0x00ab0, alpha }, { 0x00ab2, 0x00ab3, alpha }, { 0x00ab5, 0x00ab9, alpha },
+      { 0x00abc, 0x00abc, alnum }, { 0x00abd, 0x00abd, alpha }, { 0x00abe, 0x00ac5, alnum }, { 0x00ac7, 0x00ac9, alnum }, { 0x00acb, 0x00acd, alnum },
+      { 0x00ad0, 0x00ad0, alpha }, { 0x00ae0, 0x00ae1, alpha }, { 0x00ae2, 0x00ae3, alnum }, { 0x00ae6, 0x00aef, alnum }, { 0x00af9, 0x00af9, alpha },
+      { 0x00afa, 0x00aff, alnum }, { 0x00b01, 0x00b03, alnum }, { 0x00b05, 0x00b0c, alpha }, { 0x00b0f, 0x00b10, alpha }, { 0x00b13, 0x00b28, alpha },
+      { 0x00b2a, 0x00b30, alpha }, { 0x00b32, 0x00b33, alpha }, { 0x00b35, 0x00b39, alpha }, { 0x00b3c, 0x00b3c, alnum }, { 0x00b3d, 0x00b3d, alpha },
+      { 0x00b3e, 0x00b44, alnum }, { 0x00b47, 0x00b48, alnum }, { 0x00b4b, 0x00b4d, alnum }, { 0x00b55, 0x00b57, alnum }, { 0x00b5c, 0x00b5d, alpha },
+      { 0x00b5f, 0x00b61, alpha }, { 0x00b62, 0x00b63, alnum }, { 0x00b66, 0x00b6f, alnum }, { 0x00b71, 0x00b71, alpha }, { 0x00b82, 0x00b82, alnum },
+      { 0x00b83, 0x00b83, alpha }, { 0x00b85, 0x00b8a, alpha }, { 0x00b8e, 0x00b90, alpha }, { 0x00b92, 0x00b95, alpha }, { 0x00b99, 0x00b9a, alpha },
+      { 0x00b9c, 0x00b9c, alpha }, { 0x00b9e, 0x00b9f, alpha }, { 0x00ba3, 0x00ba4, alpha }, { 0x00ba8, 0x00baa, alpha }, { 0x00bae, 0x00bb9, alpha },
+      { 0x00bbe, 0x00bc2, alnum }, { 0x00bc6, 0x00bc8, alnum }, { 0x00bca, 0x00bcd, alnum }, { 0x00bd0, 0x00bd0, alpha }, { 0x00bd7, 0x00bd7, alnum },
+      { 0x00be6, 0x00bef, alnum }, { 0x00c00, 0x00c04, alnum }, { 0x00c05, 0x00c0c, alpha }, { 0x00c0e, 0x00c10, alpha }, { 0x00c12, 0x00c28, alpha },
+      { 0x00c2a, 0x00c39, alpha }, { 0x00c3c, 0x00c3c, alnum }, { 0x00c3d, 0x00c3d, alpha }, { 0x00c3e, 0x00c44, alnum }, { 0x00c46, 0x00c48, alnum },
+      { 0x00c4a, 0x00c4d, alnum }, { 0x00c55, 0x00c56, alnum }, { 0x00c58, 0x00c5a, alpha }, { 0x00c5d, 0x00c5d, alpha }, { 0x00c60, 0x00c61, alpha },
+      { 0x00c62, 0x00c63, alnum }, { 0x00c66, 0x00c6f, alnum }, { 0x00c80, 0x00c80, alpha }, { 0x00c81, 0x00c83, alnum }, { 0x00c85, 0x00c8c, alpha },
+      { 0x00c8e, 0x00c90, alpha }, { 0x00c92, 0x00ca8, alpha }, { 0x00caa, 0x00cb3, alpha }, { 0x00cb5, 0x00cb9, alpha }, { 0x00cbc, 0x00cbc, alnum },
+      { 0x00cbd, 0x00cbd, alpha }, { 0x00cbe, 0x00cc4, alnum }, { 0x00cc6, 0x00cc8, alnum }, { 0x00cca, 0x00ccd, alnum }, { 0x00cd5, 0x00cd6, alnum },
+      { 0x00cdd, 0x00cde, alpha }, { 0x00ce0, 0x00ce1, alpha }, { 0x00ce2, 0x00ce3, alnum }, { 0x00ce6, 0x00cef, alnum }, { 0x00cf1, 0x00cf2, alpha },
+      { 0x00d00, 0x00d03, alnum }, { 0x00d04, 0x00d0c, alpha }, { 0x00d0e, 0x00d10, alpha }, { 0x00d12, 0x00d3a, alpha }, { 0x00d3b, 0x00d3c, alnum },
+      { 0x00d3d, 0x00d3d, alpha }, { 0x00d3e, 0x00d44, alnum }, { 0x00d46, 0x00d48, alnum }, { 0x00d4a, 0x00d4d, alnum }, { 0x00d4e, 0x00d4e, alpha },
+      { 0x00d54, 0x00d56, alpha }, { 0x00d57, 0x00d57, alnum }, { 0x00d5f, 0x00d61, alpha }, { 0x00d62, 0x00d63, alnum }, { 0x00d66, 0x00d6f, alnum },
+      { 0x00d7a, 0x00d7f, alpha }, { 0x00d81, 0x00d83, alnum }, { 0x00d85, 0x00d96, alpha }, { 0x00d9a, 0x00db1, alpha }, { 0x00db3, 0x00dbb, alpha },
+      { 0x00dbd, 0x00dbd, alpha }, { 0x00dc0, 0x00dc6, alpha }, { 0x00dca, 0x00dca, alnum }, { 0x00dcf, 0x00dd4, alnum }, { 0x00dd6, 0x00dd6, alnum },
+      { 0x00dd8, 0x00ddf, alnum }, { 0x00de6, 0x00def, alnum }, { 0x00df2, 0x00df3, alnum }, { 0x00e01, 0x00e30, alpha }, { 0x00e31, 0x00e31, alnum },
+      { 0x00e32, 0x00e33, alpha }, { 0x00e34, 0x00e3a, alnum }, { 0x00e40, 0x00e46, alpha }, { 0x00e47, 0x00e4e, alnum }, { 0x00e50, 0x00e59, alnum },
+      { 0x00e81, 0x00e82, alpha }, { 0x00e84, 0x00e84, alpha }, { 0x00e86, 0x00e8a, alpha }, { 0x00e8c, 0x00ea3, alpha }, { 0x00ea5, 0x00ea5, alpha },
+      { 0x00ea7, 0x00eb0, alpha }, { 0x00eb1, 0x00eb1, alnum }, { 0x00eb2, 0x00eb3, alpha }, { 0x00eb4, 0x00ebc, alnum }, { 0x00ebd, 0x00ebd, alpha },
+      { 0x00ec0, 0x00ec4, alpha }, { 0x00ec6, 0x00ec6, alpha }, { 0x00ec8, 0x00ecd, alnum }, { 0x00ed0, 0x00ed9, alnum }, { 0x00edc, 0x00edf, alpha },
+      { 0x00f00, 0x00f00, alpha }, { 0x00f18, 0x00f19, alnum }, { 0x00f20, 0x00f29, alnum }, { 0x00f35, 0x00f35, alnum }, { 0x00f37, 0x00f37, alnum },
+      { 0x00f39, 0x00f39, alnum }, { 0x00f3e, 0x00f3f, alnum }, { 0x00f40, 0x00f47, alpha }, { 0x00f49, 0x00f6c, alpha }, { 0x00f71, 0x00f84, alnum },
+      { 0x00f86, 0x00f87, alnum }, { 0x00f88, 0x00f8c, alpha }, { 0x00f8d, 0x00f97, alnum }, { 0x00f99, 0x00fbc, alnum }, { 0x00fc6, 0x00fc6, alnum },
+      { 0x01000, 0x0102a, alpha }, { 0x0102b, 0x0103e, alnum }, { 0x0103f, 0x0103f, alpha }, { 0x01040, 0x01049, alnum }, { 0x01050, 0x01055, alpha },
+      { 0x01056, 0x01059, alnum }, { 0x0105a, 0x0105d, alpha }, { 0x0105e, 0x01060, alnum }, { 0x01061, 0x01061, alpha }, { 0x01062, 0x01064, alnum },
+      { 0x01065, 0x01066, alpha }, { 0x01067, 0x0106d, alnum }, { 0x0106e, 0x01070, alpha }, { 0x01071, 0x01074, alnum }, { 0x01075, 0x01081, alpha },
+      { 0x01082, 0x0108d, alnum }, { 0x0108e, 0x0108e, alpha }, { 0x0108f, 0x0109d, alnum }, { 0x010a0, 0x010c5, alpha }, { 0x010c7, 0x010c7, alpha },
+      { 0x010cd, 0x010cd, alpha }, { 0x010d0, 0x010fa, alpha }, { 0x010fc, 0x01248, alpha }, { 0x0124a, 0x0124d, alpha }, { 0x01250, 0x01256, alpha },
+      { 0x01258, 0x01258, alpha }, { 0x0125a, 0x0125d, alpha }, { 0x01260, 0x01288, alpha }, { 0x0128a, 0x0128d, alpha }, { 0x01290, 0x012b0, alpha },
+      { 0x012b2, 0x012b5, alpha }, { 0x012b8, 0x012be, alpha }, { 0x012c0, 0x012c0, alpha }, { 0x012c2, 0x012c5, alpha }, { 0x012c8, 0x012d6, alpha },
+      { 0x012d8, 0x01310, alpha }, { 0x01312, 0x01315, alpha }, { 0x01318, 0x0135a, alpha }, { 0x0135d, 0x0135f, alnum }, { 0x01380, 0x0138f, alpha },
+      { 0x013a0, 0x013f5, alpha }, { 0x013f8, 0x013fd, alpha }, { 0x01401, 0x0166c, alpha }, { 0x0166f, 0x0167f, alpha }, { 0x01681, 0x0169a, alpha },
+      { 0x016a0, 0x016ea, alpha }, { 0x016ee, 0x016f8, alpha }, { 0x01700, 0x01711, alpha }, { 0x01712, 0x01715, alnum }, { 0x0171f, 0x01731, alpha },
+      { 0x01732, 0x01734, alnum }, { 0x01740, 0x01751, alpha }, { 0x01752, 0x01753, alnum }, { 0x01760, 0x0176c, alpha }, { 0x0176e, 0x01770, alpha },
+      { 0x01772, 0x01773, alnum }, { 0x01780, 0x017b3, alpha }, { 0x017b4, 0x017d3, alnum }, { 0x017d7, 0x017d7, alpha }, { 0x017dc, 0x017dc, alpha },
+      { 0x017dd, 0x017dd, alnum }, { 0x017e0, 0x017e9, alnum }, { 0x0180b, 0x0180d, alnum }, { 0x0180f, 0x01819, alnum }, { 0x01820, 0x01878, alpha },
+      { 0x01880, 0x01884, alpha }, { 0x01885, 0x01886, alnum }, { 0x01887, 0x018a8, alpha }, { 0x018a9, 0x018a9, alnum }, { 0x018aa, 0x018aa, alpha },
+      { 0x018b0, 0x018f5, alpha }, { 0x01900, 0x0191e, alpha }, { 0x01920, 0x0192b, alnum }, { 0x01930, 0x0193b, alnum }, { 0x01946, 0x0194f, alnum },
+      { 0x01950, 0x0196d, alpha }, { 0x01970, 0x01974, alpha }, { 0x01980, 0x019ab, alpha }, { 0x019b0, 0x019c9, alpha }, { 0x019d0, 0x019d9, alnum },
+      { 0x01a00, 0x01a16, alpha }, { 0x01a17, 0x01a1b, alnum }, { 0x01a20, 0x01a54, alpha }, { 0x01a55, 0x01a5e, alnum }, { 0x01a60, 0x01a7c, alnum },
+      { 0x01a7f, 0x01a89, alnum }, { 0x01a90, 0x01a99, alnum }, { 0x01aa7, 0x01aa7, alpha }, { 0x01ab0, 0x01abd, alnum }, { 0x01abf, 0x01ace, alnum },
+      { 0x01b00, 0x01b04, alnum }, { 0x01b05, 0x01b33, alpha }, { 0x01b34, 0x01b44, alnum }, { 0x01b45, 0x01b4c, alpha }, { 0x01b50, 0x01b59, alnum },
+      { 0x01b6b, 0x01b73, alnum }, { 0x01b80, 0x01b82, alnum }, { 0x01b83, 0x01ba0, alpha }, { 0x01ba1, 0x01bad, alnum }, { 0x01bae, 0x01baf, alpha },
+      { 0x01bb0, 0x01bb9, alnum }, { 0x01bba, 0x01be5, alpha }, { 0x01be6, 0x01bf3, alnum }, { 0x01c00, 0x01c23, alpha }, { 0x01c24, 0x01c37, alnum },
+      { 0x01c40, 0x01c49, alnum }, { 0x01c4d, 0x01c4f, alpha }, { 0x01c50, 0x01c59, alnum }, { 0x01c5a, 0x01c7d, alpha }, { 0x01c80, 0x01c88, alpha },
+      { 0x01c90, 0x01cba, alpha }, { 0x01cbd, 0x01cbf, alpha }, { 0x01cd0, 0x01cd2, alnum }, { 0x01cd4, 0x01ce8, alnum }, { 0x01ce9, 0x01cec, alpha },
+      { 0x01ced, 0x01ced, alnum }, { 0x01cee, 0x01cf3, alpha }, { 0x01cf4, 0x01cf4, alnum }, { 0x01cf5, 0x01cf6, alpha }, { 0x01cf7, 0x01cf9, alnum },
+      { 0x01cfa, 0x01cfa, alpha }, { 0x01d00, 0x01dbf, alpha }, { 0x01dc0, 0x01dff, alnum }, { 0x01e00, 0x01f15, alpha }, { 0x01f18, 0x01f1d, alpha },
+      { 0x01f20, 0x01f45, alpha }, { 0x01f48, 0x01f4d, alpha }, { 0x01f50, 0x01f57, alpha }, { 0x01f59, 0x01f59, alpha }, { 0x01f5b, 0x01f5b, alpha },
+      { 0x01f5d, 0x01f5d, alpha }, { 0x01f5f, 0x01f7d, alpha }, { 0x01f80, 0x01fb4, alpha }, { 0x01fb6, 0x01fbc, alpha }, { 0x01fbe, 0x01fbe, alpha },
+      { 0x01fc2, 0x01fc4, alpha }, { 0x01fc6, 0x01fcc, alpha }, { 0x01fd0, 0x01fd3, alpha }, { 0x01fd6, 0x01fdb, alpha }, { 0x01fe0, 0x01fec, alpha },
+      { 0x01ff2, 0x01ff4, alpha }, { 0x01ff6, 0x01ffc, alpha }, { 0x02071, 0x02071, alpha }, { 0x0207f, 0x0207f, alpha }, { 0x02090, 0x0209c, alpha },
+      { 0x020d0, 0x020dc, alnum }, { 0x020e1, 0x020e1, alnum }, { 0x020e5, 0x020f0, alnum }, { 0x02102, 0x02102, alpha }, { 0x02107, 0x02107, alpha },
+      { 0x0210a, 0x02113, alpha }, { 0x02115, 0x02115, alpha }, { 0x02119, 0x0211d, alpha }, { 0x02124, 0x02124, alpha }, { 0x02126, 0x02126, alpha },
+      { 0x02128, 0x02128, alpha }, { 0x0212a, 0x0212d, alpha }, { 0x0212f, 0x02139, alpha }, { 0x0213c, 0x0213f, alpha }, { 0x02145, 0x02149, alpha },
+      { 0x0214e, 0x0214e, alpha }, { 0x02160, 0x02188, alpha }, { 0x02c00, 0x02ce4, alpha }, { 0x02ceb, 0x02cee, alpha }, { 0x02cef, 0x02cf1, alnum },
+      { 0x02cf2, 0x02cf3, alpha }, { 0x02d00, 0x02d25, alpha }, { 0x02d27, 0x02d27, alpha }, { 0x02d2d, 0x02d2d, alpha }, { 0x02d30, 0x02d67, alpha },
+      { 0x02d6f, 0x02d6f, alpha }, { 0x02d7f, 0x02d7f, alnum }, { 0x02d80, 0x02d96, alpha }, { 0x02da0, 0x02da6, alpha }, { 0x02da8, 0x02dae, alpha },
+      { 0x02db0, 0x02db6, alpha }, { 0x02db8, 0x02dbe, alpha }, { 0x02dc0, 0x02dc6, alpha }, { 0x02dc8, 0x02dce, alpha }, { 0x02dd0, 0x02dd6, alpha },
+      { 0x02dd8, 0x02dde, alpha }, { 0x02de0, 0x02dff, alnum }, { 0x02e2f, 0x02e2f, alpha }, { 0x03005, 0x03007, alpha }, { 0x03021, 0x03029, alpha },
+      { 0x0302a, 0x0302f, alnum }, { 0x03031, 0x03035, alpha }, { 0x03038, 0x0303c, alpha }, { 0x03041, 0x03096, alpha }, { 0x03099, 0x0309a, alnum },
+      { 0x0309d, 0x0309f, alpha }, { 0x030a1, 0x030fa, alpha }, { 0x030fc, 0x030ff, alpha }, { 0x03105, 0x0312f, alpha }, { 0x03131, 0x0318e, alpha },
+      { 0x031a0, 0x031bf, alpha }, { 0x031f0, 0x031ff, alpha }, { 0x03400, 0x04dbf, alpha }, { 0x04e00, 0x0a48c, alpha }, { 0x0a4d0, 0x0a4fd, alpha },
+      { 0x0a500, 0x0a60c, alpha }, { 0x0a610, 0x0a61f, alpha }, { 0x0a620, 0x0a629, alnum }, { 0x0a62a, 0x0a62b, alpha }, { 0x0a640, 0x0a66e, alpha },
+      { 0x0a66f, 0x0a66f, alnum }, { 0x0a674, 0x0a67d, alnum }, { 0x0a67f, 0x0a69d, alpha }, { 0x0a69e, 0x0a69f, alnum }, { 0x0a6a0, 0x0a6ef, alpha },
+      { 0x0a6f0, 0x0a6f1, alnum }, { 0x0a717, 0x0a71f, alpha }, { 0x0a722, 0x0a788, alpha }, { 0x0a78b, 0x0a7ca, alpha }, { 0x0a7d0, 0x0a7d1, alpha },
+      { 0x0a7d3, 0x0a7d3, alpha }, { 0x0a7d5, 0x0a7d9, alpha }, { 0x0a7f2, 0x0a801, alpha }, { 0x0a802, 0x0a802, alnum }, { 0x0a803, 0x0a805, alpha },
+      { 0x0a806, 0x0a806, alnum }, { 0x0a807, 0x0a80a, alpha }, { 0x0a80b, 0x0a80b, alnum }, { 0x0a80c, 0x0a822, alpha }, { 0x0a823, 0x0a827, alnum },
+      { 0x0a82c, 0x0a82c, alnum }, { 0x0a840, 0x0a873, alpha }, { 0x0a880, 0x0a881, alnum }, { 0x0a882, 0x0a8b3, alpha }, { 0x0a8b4, 0x0a8c5, alnum },
+      { 0x0a8d0, 0x0a8d9, alnum }, { 0x0a8e0, 0x0a8f1, alnum }, { 0x0a8f2, 0x0a8f7, alpha }, { 0x0a8fb, 0x0a8fb, alpha }, { 0x0a8fd, 0x0a8fe, alpha },
+      { 0x0a8ff, 0x0a909, alnum }, { 0x0a90a, 0x0a925, alpha }, { 0x0a926, 0x0a92d, alnum }, { 0x0a930, 0x0a946, alpha }, { 0x0a947, 0x0a953, alnum },
+      { 0x0a960, 0x0a97c, alpha }, { 0x0a980, 0x0a983, alnum }, { 0x0a984, 0x0a9b2, alpha }, { 0x0a9b3, 0x0a9c0, alnum }, { 0x0a9cf, 0x0a9cf, alpha },
+      { 0x0a9d0, 0x0a9d9, alnum }, { 0x0a9e0, 0x0a9e4, alpha }, { 0x0a9e5, 0x0a9e5, alnum }, { 0x0a9e6, 0x0a9ef, alpha }, { 0x0a9f0, 0x0a9f9, alnum },
+      { 0x0a9fa, 0x0a9fe, alpha }, { 0x0aa00, 0x0aa28, alpha }, { 0x0aa29, 0x0aa36, alnum }, { 0x0aa40, 0x0aa42, alpha }, { 0x0aa43, 0x0aa43, alnum },
+      { 0x0aa44, 0x0aa4b, alpha }, { 0x0aa4c, 0x0aa4d, alnum }, { 0x0aa50, 0x0aa59, alnum }, { 0x0aa60, 0x0aa76, alpha }, { 0x0aa7a, 0x0aa7a, alpha },
+      { 0x0aa7b, 0x0aa7d, alnum }, { 0x0aa7e, 0x0aaaf, alpha }, { 0x0aab0, 0x0aab0, alnum }, { 0x0aab1, 0x0aab1, alpha }, { 0x0aab2, 0x0aab4, alnum },
+      { 0x0aab5, 0x0aab6, alpha }, { 0x0aab7, 0x0aab8, alnum }, { 0x0aab9, 0x0aabd, alpha }, { 0x0aabe, 0x0aabf, alnum }, { 0x0aac0, 0x0aac0, alpha },
+      { 0x0aac1, 0x0aac1, alnum }, { 0x0aac2, 0x0aac2, alpha }, { 0x0aadb, 0x0aadd, alpha }, { 0x0aae0, 0x0aaea, alpha }, { 0x0aaeb, 0x0aaef, alnum },
+      { 0x0aaf2, 0x0aaf4, alpha }, { 0x0aaf5, 0x0aaf6, alnum }, { 0x0ab01, 0x0ab06, alpha }, { 0x0ab09, 0x0ab0e, alpha }, { 0x0ab11, 0x0ab16, alpha },
+      { 0x0ab20, 0x0ab26, alpha }, { 0x0ab28, 0x0ab2e, alpha }, { 0x0ab30, 0x0ab5a, alpha }, { 0x0ab5c, 0x0ab69, alpha }, { 0x0ab70, 0x0abe2, alpha },
+      { 0x0abe3, 0x0abea, alnum }, { 0x0abec, 0x0abed, alnum }, { 0x0abf0, 0x0abf9, alnum }, { 0x0ac00, 0x0d7a3, alpha }, { 0x0d7b0, 0x0d7c6, alpha },
+      { 0x0d7cb, 0x0d7fb, alpha }, { 0x0f900, 0x0fa6d, alpha }, { 0x0fa70, 0x0fad9, alpha }, { 0x0fb00, 0x0fb06, alpha }, { 0x0fb13, 0x0fb17, alpha },
+      { 0x0fb1d, 0x0fb1d, alpha }, { 0x0fb1e, 0x0fb1e, alnum }, { 0x0fb1f, 0x0fb28, alpha }, { 0x0fb2a, 0x0fb36, alpha }, { 0x0fb38, 0x0fb3c, alpha },
+      { 0x0fb3e, 0x0fb3e, alpha }, { 0x0fb40, 0x0fb41, alpha }, { 0x0fb43, 0x0fb44, alpha }, { 0x0fb46, 0x0fbb1, alpha }, { 0x0fbd3, 0x0fd3d, alpha },
+      { 0x0fd50, 0x0fd8f, alpha }, { 0x0fd92, 0x0fdc7, alpha }, { 0x0fdf0, 0x0fdfb, alpha }, { 0x0fe00, 0x0fe0f, alnum }, { 0x0fe20, 0x0fe2f, alnum },
+      { 0x0fe70, 0x0fe74, alpha }, { 0x0fe76, 0x0fefc, alpha }, { 0x0ff10, 0x0ff19, alnum }, { 0x0ff21, 0x0ff3a, alpha }, { 0x0ff41, 0x0ff5a, alpha },
+      { 0x0ff66, 0x0ffbe, alpha }, { 0x0ffc2, 0x0ffc7, alpha }, { 0x0ffca, 0x0ffcf, alpha }, { 0x0ffd2, 0x0ffd7, alpha }, { 0x0ffda, 0x0ffdc, alpha },
+      { 0x10000, 0x1000b, alpha }, { 0x1000d, 0x10026, alpha }, { 0x10028, 0x1003a, alpha }, { 0x1003c, 0x1003d, alpha }, { 0x1003f, 0x1004d, alpha },
+      { 0x10050, 0x1005d, alpha }, { 0x10080, 0x100fa, alpha }, { 0x10140, 0x10174, alpha }, { 0x101fd, 0x101fd, alnum }, { 0x10280, 0x1029c, alpha },
+      { 0x102a0, 0x102d0, alpha }, { 0x102e0, 0x102e0, alnum }, { 0x10300, 0x1031f, alpha }, { 0x1032d, 0x1034a, alpha }, { 0x10350, 0x10375, alpha },
+      { 0x10376, 0x1037a, alnum }, { 0x10380, 0x1039d, alpha }, { 0x103a0, 0x103c3, alpha }, { 0x103c8, 0x103cf, alpha }, { 0x103d1, 0x103d5, alpha },
+      { 0x10400, 0x1049d, alpha }, { 0x104a0, 0x104a9, alnum }, { 0x104b0, 0x104d3, alpha }, { 0x104d8, 0x104fb, alpha }, { 0x10500, 0x10527, alpha },
+      { 0x10530, 0x10563, alpha }, { 0x10570, 0x1057a, alpha }, { 0x1057c, 0x1058a, alpha }, { 0x1058c, 0x10592, alpha }, { 0x10594, 0x10595, alpha },
+      { 0x10597, 0x105a1, alpha }, { 0x105a3, 0x105b1, alpha }, { 0x105b3, 0x105b9, alpha }, { 0x105bb, 0x105bc, alpha }, { 0x10600, 0x10736, alpha },
+      { 0x10740, 0x10755, alpha }, { 0x10760, 0x10767, alpha }, { 0x10780, 0x10785, alpha }, { 0x10787, 0x107b0, alpha }, { 0x107b2, 0x107ba, alpha },
+      { 0x10800, 0x10805, alpha }, { 0x10808, 0x10808, alpha }, { 0x1080a, 0x10835, alpha }, { 0x10837, 0x10838, alpha }, { 0x1083c, 0x1083c, alpha },
+      { 0x1083f, 0x10855, alpha }, { 0x10860, 0x10876, alpha }, { 0x10880, 0x1089e, alpha }, { 0x108e0, 0x108f2, alpha }, { 0x108f4, 0x108f5, alpha },
+      { 0x10900, 0x10915, alpha }, { 0x10920, 0x10939, alpha }, { 0x10980, 0x109b7, alpha }, { 0x109be, 0x109bf, alpha }, { 0x10a00, 0x10a00, alpha },
+      { 0x10a01, 0x10a03, alnum }, { 0x10a05, 0x10a06, alnum }, { 0x10a0c, 0x10a0f, alnum }, { 0x10a10, 0x10a13, alpha }, { 0x10a15, 0x10a17, alpha },
+      { 0x10a19, 0x10a35, alpha }, { 0x10a38, 0x10a3a, alnum }, { 0x10a3f, 0x10a3f, alnum }, { 0x10a60, 0x10a7c, alpha }, { 0x10a80, 0x10a9c, alpha },
+      { 0x10ac0, 0x10ac7, alpha }, { 0x10ac9, 0x10ae4, alpha }, { 0x10ae5, 0x10ae6, alnum }, { 0x10b00, 0x10b35, alpha }, { 0x10b40, 0x10b55, alpha },
+      { 0x10b60, 0x10b72, alpha }, { 0x10b80, 0x10b91, alpha }, { 0x10c00, 0x10c48, alpha }, { 0x10c80, 0x10cb2, alpha }, { 0x10cc0, 0x10cf2, alpha },
+      { 0x10d00, 0x10d23, alpha }, { 0x10d24, 0x10d27, alnum }, { 0x10d30, 0x10d39, alnum }, { 0x10e80, 0x10ea9, alpha }, { 0x10eab, 0x10eac, alnum },
+      { 0x10eb0, 0x10eb1, alpha }, { 0x10f00, 0x10f1c, alpha }, { 0x10f27, 0x10f27, alpha }, { 0x10f30, 0x10f45, alpha }, { 0x10f46, 0x10f50, alnum },
+      { 0x10f70, 0x10f81, alpha }, { 0x10f82, 0x10f85, alnum }, { 0x10fb0, 0x10fc4, alpha }, { 0x10fe0, 0x10ff6, alpha }, { 0x11000, 0x11002, alnum },
+      { 0x11003, 0x11037, alpha }, { 0x11038, 0x11046, alnum }, { 0x11066, 0x11070, alnum }, { 0x11071, 0x11072, alpha }, { 0x11073, 0x11074, alnum },
+      { 0x11075, 0x11075, alpha }, { 0x1107f, 0x11082, alnum }, { 0x11083, 0x110af, alpha }, { 0x110b0, 0x110ba, alnum }, { 0x110c2, 0x110c2, alnum },
+      { 0x110d0, 0x110e8, alpha }, { 0x110f0, 0x110f9, alnum }, { 0x11100, 0x11102, alnum }, { 0x11103, 0x11126, alpha }, { 0x11127, 0x11134, alnum },
+      { 0x11136, 0x1113f, alnum }, { 0x11144, 0x11144, alpha }, { 0x11145, 0x11146, alnum }, { 0x11147, 0x11147, alpha }, { 0x11150, 0x11172, alpha },
+      { 0x11173, 0x11173, alnum }, { 0x11176, 0x11176, alpha }, { 0x11180, 0x11182, alnum }, { 0x11183, 0x111b2, alpha }, { 0x111b3, 0x111c0, alnum },
+      { 0x111c1, 0x111c4, alpha }, { 0x111c9, 0x111cc, alnum }, { 0x111ce, 0x111d9, alnum }, { 0x111da, 0x111da, alpha }, { 0x111dc, 0x111dc, alpha },
+      { 0x11200, 0x11211, alpha }, { 0x11213, 0x1122b, alpha }, { 0x1122c, 0x11237, alnum }, { 0x1123e, 0x1123e, alnum }, { 0x11280, 0x11286, alpha },
+      { 0x11288, 0x11288, alpha }, { 0x1128a, 0x1128d, alpha }, { 0x1128f, 0x1129d, alpha }, { 0x1129f, 0x112a8, alpha }, { 0x112b0, 0x112de, alpha },
+      { 0x112df, 0x112ea, alnum }, { 0x112f0, 0x112f9, alnum }, { 0x11300, 0x11303, alnum }, { 0x11305, 0x1130c, alpha }, { 0x1130f, 0x11310, alpha },
+      { 0x11313, 0x11328, alpha }, { 0x1132a, 0x11330, alpha }, { 0x11332, 0x11333, alpha }, { 0x11335, 0x11339, alpha }, { 0x1133b, 0x1133c, alnum },
+      { 0x1133d, 0x1133d, alpha }, { 0x1133e, 0x11344, alnum }, { 0x11347, 0x11348, alnum }, { 0x1134b, 0x1134d, alnum }, { 0x11350, 0x11350, alpha },
+      { 0x11357, 0x11357, alnum }, { 0x1135d, 0x11361, alpha }, { 0x11362, 0x11363, alnum }, { 0x11366, 0x1136c, alnum }, { 0x11370, 0x11374, alnum },
+      { 0x11400, 0x11434, alpha }, { 0x11435, 0x11446, alnum }, { 0x11447, 0x1144a, alpha }, { 0x11450, 0x11459, alnum }, { 0x1145e, 0x1145e, alnum },
+      { 0x1145f, 0x11461, alpha }, { 0x11480, 0x114af, alpha }, { 0x114b0, 0x114c3, alnum }, { 0x114c4, 0x114c5, alpha }, { 0x114c7, 0x114c7, alpha },
+      { 0x114d0, 0x114d9, alnum }, { 0x11580, 0x115ae, alpha }, { 0x115af, 0x115b5, alnum }, { 0x115b8, 0x115c0, alnum }, { 0x115d8, 0x115db, alpha },
+      { 0x115dc, 0x115dd, alnum }, { 0x11600, 0x1162f, alpha }, { 0x11630, 0x11640, alnum }, { 0x11644, 0x11644, alpha }, { 0x11650, 0x11659, alnum },
+      { 0x11680, 0x116aa, alpha }, { 0x116ab, 0x116b7, alnum }, { 0x116b8, 0x116b8, alpha }, { 0x116c0, 0x116c9, alnum }, { 0x11700, 0x1171a, alpha },
+      { 0x1171d, 0x1172b, alnum }, { 0x11730, 0x11739, alnum }, { 0x11740, 0x11746, alpha }, { 0x11800, 0x1182b, alpha }, { 0x1182c, 0x1183a, alnum },
+      { 0x118a0, 0x118df, alpha }, { 0x118e0, 0x118e9, alnum }, { 0x118ff, 0x11906, alpha }, { 0x11909, 0x11909, alpha }, { 0x1190c, 0x11913, alpha },
+      { 0x11915, 0x11916, alpha }, { 0x11918, 0x1192f, alpha }, { 0x11930, 0x11935, alnum }, { 0x11937, 0x11938, alnum }, { 0x1193b, 0x1193e, alnum },
+      { 0x1193f, 0x1193f, alpha }, { 0x11940, 0x11940, alnum }, { 0x11941, 0x11941, alpha }, { 0x11942, 0x11943, alnum }, { 0x11950, 0x11959, alnum },
+      { 0x119a0, 0x119a7, alpha }, { 0x119aa, 0x119d0, alpha }, { 0x119d1, 0x119d7, alnum }, { 0x119da, 0x119e0, alnum }, { 0x119e1, 0x119e1, alpha },
+      { 0x119e3, 0x119e3, alpha }, { 0x119e4, 0x119e4, alnum }, { 0x11a00, 0x11a00, alpha }, { 0x11a01, 0x11a0a, alnum }, { 0x11a0b, 0x11a32, alpha },
+      { 0x11a33, 0x11a39, alnum }, { 0x11a3a, 0x11a3a, alpha }, { 0x11a3b, 0x11a3e, alnum }, { 0x11a47, 0x11a47, alnum }, { 0x11a50, 0x11a50, alpha },
+      { 0x11a51, 0x11a5b, alnum }, { 0x11a5c, 0x11a89, alpha }, { 0x11a8a, 0x11a99, alnum }, { 0x11a9d, 0x11a9d, alpha }, { 0x11ab0, 0x11af8, alpha },
+      { 0x11c00, 0x11c08, alpha }, { 0x11c0a, 0x11c2e, alpha }, { 0x11c2f, 0x11c36, alnum }, { 0x11c38, 0x11c3f, alnum }, { 0x11c40, 0x11c40, alpha },
+      { 0x11c50, 0x11c59, alnum }, { 0x11c72, 0x11c8f, alpha }, { 0x11c92, 0x11ca7, alnum }, { 0x11ca9, 0x11cb6, alnum }, { 0x11d00, 0x11d06, alpha },
+      { 0x11d08, 0x11d09, alpha }, { 0x11d0b, 0x11d30, alpha }, { 0x11d31, 0x11d36, alnum }, { 0x11d3a, 0x11d3a, alnum }, { 0x11d3c, 0x11d3d, alnum },
+      { 0x11d3f, 0x11d45, alnum }, { 0x11d46, 0x11d46, alpha }, { 0x11d47, 0x11d47, alnum }, { 0x11d50, 0x11d59, alnum }, { 0x11d60, 0x11d65, alpha },
+      { 0x11d67, 0x11d68, alpha }, { 0x11d6a, 0x11d89, alpha }, { 0x11d8a, 0x11d8e, alnum }, { 0x11d90, 0x11d91, alnum }, { 0x11d93, 0x11d97, alnum },
+      { 0x11d98, 0x11d98, alpha }, { 0x11da0, 0x11da9, alnum }, { 0x11ee0, 0x11ef2, alpha }, { 0x11ef3, 0x11ef6, alnum }, { 0x11fb0, 0x11fb0, alpha },
+      { 0x12000, 0x12399, alpha }, { 0x12400, 0x1246e, alpha }, { 0x12480, 0x12543, alpha }, { 0x12f90, 0x12ff0, alpha }, { 0x13000, 0x1342e, alpha },
+      { 0x14400, 0x14646, alpha }, { 0x16800, 0x16a38, alpha }, { 0x16a40, 0x16a5e, alpha }, { 0x16a60, 0x16a69, alnum }, { 0x16a70, 0x16abe, alpha },
+      { 0x16ac0, 0x16ac9, alnum }, { 0x16ad0, 0x16aed, alpha }, { 0x16af0, 0x16af4, alnum }, { 0x16b00, 0x16b2f, alpha }, { 0x16b30, 0x16b36, alnum },
+      { 0x16b40, 0x16b43, alpha }, { 0x16b50, 0x16b59, alnum }, { 0x16b63, 0x16b77, alpha }, { 0x16b7d, 0x16b8f, alpha }, { 0x16e40, 0x16e7f, alpha },
+      { 0x16f00, 0x16f4a, alpha }, { 0x16f4f, 0x16f4f, alnum }, { 0x16f50, 0x16f50, alpha }, { 0x16f51, 0x16f87, alnum }, { 0x16f8f, 0x16f92, alnum },
+      { 0x16f93, 0x16f9f, alpha }, { 0x16fe0, 0x16fe1, alpha }, { 0x16fe3, 0x16fe3, alpha }, { 0x16fe4, 0x16fe4, alnum }, { 0x16ff0, 0x16ff1, alnum },
+      { 0x17000, 0x187f7, alpha }, { 0x18800, 0x18cd5, alpha }, { 0x18d00, 0x18d08, alpha }, { 0x1aff0, 0x1aff3, alpha }, { 0x1aff5, 0x1affb, alpha },
+      { 0x1affd, 0x1affe, alpha }, { 0x1b000, 0x1b122, alpha }, { 0x1b150, 0x1b152, alpha }, { 0x1b164, 0x1b167, alpha }, { 0x1b170, 0x1b2fb, alpha },
+      { 0x1bc00, 0x1bc6a, alpha }, { 0x1bc70, 0x1bc7c, alpha }, { 0x1bc80, 0x1bc88, alpha }, { 0x1bc90, 0x1bc99, alpha }, { 0x1bc9d, 0x1bc9e, alnum },
+      { 0x1cf00, 0x1cf2d, alnum }, { 0x1cf30, 0x1cf46, alnum }, { 0x1d165, 0x1d169, alnum }, { 0x1d16d, 0x1d172, alnum }, { 0x1d17b, 0x1d182, alnum },
+      { 0x1d185, 0x1d18b, alnum }, { 0x1d1aa, 0x1d1ad, alnum }, { 0x1d242, 0x1d244, alnum }, { 0x1d400, 0x1d454, alpha }, { 0x1d456, 0x1d49c, alpha },
+      { 0x1d49e, 0x1d49f, alpha }, { 0x1d4a2, 0x1d4a2, alpha }, { 0x1d4a5, 0x1d4a6, alpha }, { 0x1d4a9, 0x1d4ac, alpha }, { 0x1d4ae, 0x1d4b9, alpha },
+      { 0x1d4bb, 0x1d4bb, alpha }, { 0x1d4bd, 0x1d4c3, alpha }, { 0x1d4c5, 0x1d505, alpha }, { 0x1d507, 0x1d50a, alpha }, { 0x1d50d, 0x1d514, alpha },
+      { 0x1d516, 0x1d51c, alpha }, { 0x1d51e, 0x1d539, alpha }, { 0x1d53b, 0x1d53e, alpha }, { 0x1d540, 0x1d544, alpha }, { 0x1d546, 0x1d546, alpha },
+      { 0x1d54a, 0x1d550, alpha }, { 0x1d552, 0x1d6a5, alpha }, { 0x1d6a8, 0x1d6c0, alpha }, { 0x1d6c2, 0x1d6da, alpha }, { 0x1d6dc, 0x1d6fa, alpha },
+      { 0x1d6fc, 0x1d714, alpha }, { 0x1d716, 0x1d734, alpha }, { 0x1d736, 0x1d74e, alpha }, { 0x1d750, 0x1d76e, alpha }, { 0x1d770, 0x1d788, alpha },
+      { 0x1d78a, 0x1d7a8, alpha }, { 0x1d7aa, 0x1d7c2, alpha }, { 0x1d7c4, 0x1d7cb, alpha }, { 0x1d7ce, 0x1d7ff, alnum }, { 0x1da00, 0x1da36, alnum },
+      { 0x1da3b, 0x1da6c, alnum }, { 0x1da75, 0x1da75, alnum }, { 0x1da84, 0x1da84, alnum }, { 0x1da9b, 0x1da9f, alnum }, { 0x1daa1, 0x1daaf, alnum },
+      { 0x1df00, 0x1df1e, alpha }, { 0x1e000, 0x1e006, alnum }, { 0x1e008, 0x1e018, alnum }, { 0x1e01b, 0x1e021, alnum }, { 0x1e023, 0x1e024, alnum },
+      { 0x1e026, 0x1e02a, alnum }, { 0x1e100, 0x1e12c, alpha }, { 0x1e130, 0x1e136, alnum }, { 0x1e137, 0x1e13d, alpha }, { 0x1e140, 0x1e149, alnum },
+      { 0x1e14e, 0x1e14e, alpha }, { 0x1e290, 0x1e2ad, alpha }, { 0x1e2ae, 0x1e2ae, alnum }, { 0x1e2c0, 0x1e2eb, alpha }, { 0x1e2ec, 0x1e2f9, alnum },
+      { 0x1e7e0, 0x1e7e6, alpha }, { 0x1e7e8, 0x1e7eb, alpha }, { 0x1e7ed, 0x1e7ee, alpha }, { 0x1e7f0, 0x1e7fe, alpha }, { 0x1e800, 0x1e8c4, alpha },
+      { 0x1e8d0, 0x1e8d6, alnum }, { 0x1e900, 0x1e943, alpha }, { 0x1e944, 0x1e94a, alnum }, { 0x1e94b, 0x1e94b, alpha }, { 0x1e950, 0x1e959, alnum },
+      { 0x1ee00, 0x1ee03, alpha }, { 0x1ee05, 0x1ee1f, alpha }, { 0x1ee21, 0x1ee22, alpha }, { 0x1ee24, 0x1ee24, alpha }, { 0x1ee27, 0x1ee27, alpha },
+      { 0x1ee29, 0x1ee32, alpha }, { 0x1ee34, 0x1ee37, alpha }, { 0x1ee39, 0x1ee39, alpha }, { 0x1ee3b, 0x1ee3b, alpha }, { 0x1ee42, 0x1ee42, alpha },
+      { 0x1ee47, 0x1ee47, alpha }, { 0x1ee49, 0x1ee49, alpha }, { 0x1ee4b, 0x1ee4b, alpha }, { 0x1ee4d, 0x1ee4f, alpha }, { 0x1ee51, 0x1ee52, alpha },
+      { 0x1ee54, 0x1ee54, alpha }, { 0x1ee57, 0x1ee57, alpha }, { 0x1ee59, 0x1ee59, alpha }, { 0x1ee5b, 0x1ee5b, alpha }, { 0x1ee5d, 0x1ee5d, alpha },
+      { 0x1ee5f, 0x1ee5f, alpha }, { 0x1ee61, 0x1ee62, alpha }, { 0x1ee64, 0x1ee64, alpha }, { 0x1ee67, 0x1ee6a, alpha }, { 0x1ee6c, 0x1ee72, alpha },
+      { 0x1ee74, 0x1ee77, alpha }, { 0x1ee79, 0x1ee7c, alpha }, { 0x1ee7e, 0x1ee7e, alpha }, { 0x1ee80, 0x1ee89, alpha }, { 0x1ee8b, 0x1ee9b, alpha },
+      { 0x1eea1, 0x1eea3, alpha }, { 0x1eea5, 0x1eea9, alpha }, { 0x1eeab, 0x1eebb, alpha }, { 0x1fbf0, 0x1fbf9, alnum }, { 0x20000, 0x2a6df, alpha },
+      { 0x2a700, 0x2b738, alpha }, { 0x2b740, 0x2b81d, alpha }, { 0x2b820, 0x2cea1, alpha }, { 0x2ceb0, 0x2ebe0, alpha }, { 0x2f800, 0x2fa1d, alpha },
+      { 0x30000, 0x3134a, alpha }, { 0xe0100, 0xe01ef, alnum },
+    };
+
+    // the class of a code point >= 0x80.
+    inline ident_class classify(unsigned cp) {
+      size_t lo = 0, hi = sizeof(ident_ranges) / sizeof(ident_ranges[0]);
+      while (lo != hi) {
+        size_t mid = (lo + hi) / 2;
+        if (cp > ident_ranges[mid].last) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      return lo != sizeof(ident_ranges) / sizeof(ident_ranges[0]) && cp >= ident_ranges[lo].first ? ident_ranges[lo].cls : none;
+    }
+
+    // decode the sequence at p. returns its length or 0 if it is not well formed:
+    // truncated, overlong, a surrogate or above 0x10ffff.
+    inline unsigned decode(const char *p, const char *end, unsigned &cp) {
+      const unsigned char *s = (const unsigned char *)p;
+      size_t avail = size_t(end - p);
+      if (avail == 0) return 0;
+      unsigned c = s[0];
+      unsigned len = c < 0x80 ? 1 : c < 0xc2 ? 0 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : c < 0xf5 ? 4 : 0;
+      if (len == 0 || len > avail) return 0;
+      if (len == 1) {
+        cp = c;
+        return 1;
+      }
+      cp = c & (0x7f >> len);
+      for (unsigned i = 1; i != len; ++i) {
+        if ((s[i] & 0xc0) != 0x80) return 0;
+        cp = cp << 6 | (s[i] & 0x3f);
+      }
+      static const unsigned min_cp[] = { 0, 0, 0x80, 0x800, 0x10000 };
+      if (cp < min_cp[len] || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) return 0;
+      return len;
+    }
+
+    inline void append_utf8(std::string &str, unsigned c) {
+      if (c < 0x80) {
+        str.push_back((char)c);
+      } else if (c < 0x800) {
+        str.push_back((char)(0xc0 | (c >> 6)));
+        str.push_back((char)(0x80 | (c & 0x3f)));
+      } else if (c < 0x10000) {
+        str.push_back((char)(0xe0 | (c >> 12)));
+        str.push_back((char)(0x80 | ((c >> 6) & 0x3f)));
+        str.push_back((char)(0x80 | (c & 0x3f)));
+      } else {
+        str.push_back((char)(0xf0 | (c >> 18)));
+        str.push_back((char)(0x80 | ((c >> 12) & 0x3f)));
+        str.push_back((char)(0x80 | ((c >> 6) & 0x3f)));
+        str.push_back((char)(0x80 | (c & 0x3f)));
+      }
+    }
+  }
+}
+
+#endif
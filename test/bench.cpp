@@ -0,0 +1,296 @@
+
+#include "little_r.hpp"
+#include "ast_cache.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <algorithm>
+
+// Lexing and parsing throughput over the R-tests corpus, printed as JSON.
+//
+//   bench [corpus dir] [repeats]
+//
+// "lex" is the token loop on its own. "parse" has one entry per file and a total.
+// nodes are heap allocations made by the parser and peak_rss_kb is the process high water mark.
+// "cache" is a cold parse of reg-tests-1a.R against loading a mapped ast cache of it,
+// hash check included.
+// "pipeline" parses the whole corpus as one source: from the lexer, from a token_buffer
+// filled first and from a token_buffer filled by a second thread.
+// "parallel" lexes eight copies of the corpus into a token_buffer and into parallel_lexers
+// of 1 to 16 threads, with the segments cut and the ones that had to be lexed again.
+// "pool" parses every file with one parser after another and with parse_pools of 1 to 16
+// threads, with the files stolen by one worker from another.
+//
+// build with -DLITTLE_R_NO_SIMD (bench_scalar) for the byte at a time scanners
+// and with -DLITTLE_R_COMPRESSED=1 (bench_compressed) for 32 bit node references.
+
+namespace {
+  std::vector<std::string> r_files(const std::string &dir) {
+    std::vector<std::string> res;
+    if (DIR *d = opendir(dir.c_str())) {
+      while (dirent *e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name.size() > 2 && name.compare(name.size() - 2, 2, ".R") == 0) {
+          res.push_back(dir + "/" + name);
+        }
+      }
+      closedir(d);
+    }
+    std::sort(res.begin(), res.end());
+    return res;
+  }
+
+  double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  long peak_rss_kb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    #ifdef __APPLE__
+      return usage.ru_maxrss / 1024;
+    #else
+      return usage.ru_maxrss;
+    #endif
+  }
+
+  struct stats {
+    size_t bytes = 0;
+    size_t tokens = 0;
+    size_t nodes = 0;
+    size_t heap_bytes = 0;
+    size_t blocks = 0;
+    size_t collections = 0;
+    size_t errors = 0;
+    double seconds = 0;
+
+    void add(const stats &rhs) {
+      bytes += rhs.bytes;
+      tokens += rhs.tokens;
+      nodes += rhs.nodes;
+      heap_bytes += rhs.heap_bytes;
+      blocks = std::max(blocks, rhs.blocks);
+      collections += rhs.collections;
+      errors += rhs.errors;
+      seconds += rhs.seconds;
+    }
+
+    // counts are per pass, rates are over all the passes.
+    void print(int repeats) const {
+      std::printf(
+        "\"bytes\": %zu, \"tokens\": %zu, \"nodes\": %zu, \"heap_bytes\": %zu, \"blocks\": %zu, \"collections\": %zu, \"errors\": %zu, "
+        "\"seconds\": %.6f, \"tokens_per_s\": %.0f, \"nodes_per_s\": %.0f, \"bytes_per_s\": %.0f",
+        bytes / repeats, tokens / repeats, nodes / repeats, heap_bytes / repeats, blocks, collections / repeats, errors / repeats,
+        seconds / repeats, tokens / seconds, nodes / seconds, bytes / seconds
+      );
+    }
+  };
+
+  std::string json_string(const std::string &str) {
+    std::string res = "\"";
+    for (char c : str) {
+      if (c == '"' || c == '\\') res.push_back('\\');
+      res.push_back(c);
+    }
+    return res + "\"";
+  }
+}
+
+int main(int argc, char **argv) {
+  using namespace little_r;
+  std::string dir = argc > 1 ? argv[1] : "R-tests";
+  int repeats = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+
+  std::vector<std::string> files = r_files(dir);
+  if (files.empty()) {
+    std::fprintf(stderr, "no .R files in %s\n", dir.c_str());
+    return 1;
+  }
+
+  heap h;
+  heap::scope scope(h);
+
+  stats lex;
+  for (int r = 0; r != repeats; ++r) {
+    for (size_t i = 0; i != files.size(); ++i) {
+      mapped_file file(files[i]);
+      auto start = std::chrono::steady_clock::now();
+      lexer lx(file);
+      try {
+        while (lx.next() != tt::end_of_input && lx.tok() != tt::error) {
+          ++lex.tokens;
+        }
+        if (lx.tok() == tt::error) ++lex.errors;
+      } catch (std::runtime_error &) {
+        ++lex.errors;
+      }
+      lex.seconds += seconds_since(start);
+      lex.bytes += file.size();
+      h.release();
+    }
+  }
+
+  std::vector<stats> parse(files.size());
+  for (int r = 0; r != repeats; ++r) {
+    for (size_t i = 0; i != files.size(); ++i) {
+      mapped_file file(files[i]);
+      stats &s = parse[i];
+      auto start = std::chrono::steady_clock::now();
+      try {
+        parser p(file);
+        s.seconds += seconds_since(start);
+        s.tokens += p.num_tokens();
+        s.errors += p.num_errors();
+      } catch (std::runtime_error &) {
+        s.seconds += seconds_since(start);
+        ++s.errors;
+      }
+      s.bytes += file.size();
+      s.nodes += h.num_allocs();
+      s.heap_bytes += h.num_bytes();
+      s.blocks = std::max(s.blocks, h.num_blocks());
+      s.collections += h.num_young_collections() + h.num_full_collections();
+      h.release();
+    }
+  }
+
+  std::string cache_src = dir + "/reg-tests-1a.R", cache_path = "bench-cache.ast";
+  double cold_seconds = 0, load_seconds = 0;
+  size_t image_bytes = 0, cache_errors = 0;
+  if (std::find(files.begin(), files.end(), cache_src) != files.end()) {
+    {
+      mapped_file file(cache_src);
+      parser p(file);
+      std::string image = ast_cache::save(p, file.data(), file.size());
+      std::ofstream(cache_path, std::ios::binary).write(image.data(), image.size());
+      image_bytes = image.size();
+      h.release();
+    }
+    for (int r = 0; r != repeats; ++r) {
+      mapped_file file(cache_src);
+      auto start = std::chrono::steady_clock::now();
+      parser p(file);
+      cold_seconds += seconds_since(start);
+      h.release();
+    }
+    for (int r = 0; r != repeats; ++r) {
+      mapped_file file(cache_src);
+      auto start = std::chrono::steady_clock::now();
+      mapped_file image(cache_path);
+      ast_cache::reader reader(image.data(), image.size());
+      if (!reader.matches(file.data(), file.size())) ++cache_errors;
+      reader.exprs();
+      load_seconds += seconds_since(start);
+      h.release();
+    }
+    std::remove(cache_path.c_str());
+  }
+
+  std::string corpus;
+  for (size_t i = 0; i != files.size(); ++i) {
+    mapped_file file(files[i]);
+    corpus.append(file.data(), file.size());
+    corpus += "\n";
+  }
+  double pipeline_seconds[3] = { 0, 0, 0 };
+  for (int r = 0; r != repeats; ++r) {
+    for (int mode = 0; mode != 3; ++mode) {
+      auto start = std::chrono::steady_clock::now();
+      if (mode == 0) {
+        parser p(corpus.data(), corpus.size());
+      } else {
+        token_buffer tokens(corpus.data(), corpus.size(), mode == 2);
+        parser p(corpus.data(), corpus.size(), tokens);
+      }
+      pipeline_seconds[mode] += seconds_since(start);
+      h.release();
+    }
+  }
+
+  std::string big;
+  for (int i = 0; i != 8; ++i) big += corpus;
+  const unsigned thread_counts[] = { 1, 2, 4, 8, 16 };
+  const size_t num_counts = sizeof(thread_counts) / sizeof(thread_counts[0]);
+  double serial_seconds = 0;
+  double parallel_seconds[num_counts] = {};
+  size_t segments[num_counts] = {}, fallbacks[num_counts] = {};
+  for (int r = 0; r != repeats; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    {
+      token_buffer tokens(big.data(), big.size(), false);
+    }
+    serial_seconds += seconds_since(start);
+    for (size_t i = 0; i != num_counts; ++i) {
+      start = std::chrono::steady_clock::now();
+      parallel_lexer tokens(big.data(), big.size(), thread_counts[i]);
+      parallel_seconds[i] += seconds_since(start);
+      segments[i] = tokens.num_segments();
+      fallbacks[i] = tokens.num_fallbacks();
+    }
+    h.release();
+  }
+
+  double one_by_one_seconds = 0;
+  double pool_seconds[num_counts] = {};
+  size_t steals[num_counts] = {};
+  for (int r = 0; r != repeats; ++r) {
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string &path : files) {
+      mapped_file file(path);
+      parser p(file);
+    }
+    one_by_one_seconds += seconds_since(start);
+    h.release();
+    for (size_t i = 0; i != num_counts; ++i) {
+      start = std::chrono::steady_clock::now();
+      parse_pool pool(files, thread_counts[i]);
+      pool_seconds[i] += seconds_since(start);
+      steals[i] = pool.num_steals();
+    }
+  }
+
+  stats total;
+  std::printf("{\n  \"kernels\": \"%s\",\n  \"compressed\": %d,\n  \"node_bytes\": %zu,\n  \"repeats\": %d,\n",
+    scan::kernel_name(), LITTLE_R_COMPRESSED, sizeof(obj), repeats);
+  std::printf("  \"lex\": { \"files\": %zu, ", files.size());
+  lex.print(repeats);
+  std::printf(" },\n  \"parse\": {\n    \"files\": [\n");
+  for (size_t i = 0; i != files.size(); ++i) {
+    std::printf("      { \"file\": %s, ", json_string(files[i]).c_str());
+    parse[i].print(repeats);
+    std::printf(" }%s\n", i + 1 == files.size() ? "" : ",");
+    total.add(parse[i]);
+  }
+  std::printf("    ],\n    \"total\": { \"files\": %zu, ", files.size());
+  total.print(repeats);
+  std::printf(", \"peak_rss_kb\": %ld }\n  },\n", peak_rss_kb());
+  std::printf(
+    "  \"cache\": { \"file\": %s, \"image_bytes\": %zu, \"errors\": %zu, \"parse_seconds\": %.6f, \"load_seconds\": %.6f, \"speedup\": %.2f },\n",
+    json_string(cache_src).c_str(), image_bytes, cache_errors, cold_seconds / repeats, load_seconds / repeats,
+    load_seconds > 0 ? cold_seconds / load_seconds : 0.0
+  );
+  std::printf(
+    "  \"pipeline\": { \"bytes\": %zu, \"threads\": %u, \"lexer_seconds\": %.6f, \"buffered_seconds\": %.6f, \"threaded_seconds\": %.6f },\n",
+    corpus.size(), std::thread::hardware_concurrency(), pipeline_seconds[0] / repeats, pipeline_seconds[1] / repeats, pipeline_seconds[2] / repeats
+  );
+  std::printf("  \"parallel\": { \"bytes\": %zu, \"serial_seconds\": %.6f, \"runs\": [\n", big.size(), serial_seconds / repeats);
+  for (size_t i = 0; i != num_counts; ++i) {
+    double seconds = parallel_seconds[i] / repeats;
+    std::printf("    { \"threads\": %u, \"segments\": %zu, \"fallbacks\": %zu, \"seconds\": %.6f, \"speedup\": %.2f }%s\n",
+      thread_counts[i], segments[i], fallbacks[i], seconds, seconds > 0 ? serial_seconds / repeats / seconds : 0.0,
+      i + 1 == num_counts ? "" : ",");
+  }
+  std::printf("  ] },\n");
+  std::printf("  \"pool\": { \"files\": %zu, \"serial_seconds\": %.6f, \"runs\": [\n", files.size(), one_by_one_seconds / repeats);
+  for (size_t i = 0; i != num_counts; ++i) {
+    double seconds = pool_seconds[i] / repeats;
+    std::printf("    { \"threads\": %u, \"steals\": %zu, \"seconds\": %.6f, \"speedup\": %.2f }%s\n",
+      thread_counts[i], steals[i], seconds, seconds > 0 ? one_by_one_seconds / repeats / seconds : 0.0,
+      i + 1 == num_counts ? "" : ",");
+  }
+  std::printf("  ] }\n}\n");
+  return 0;
+}